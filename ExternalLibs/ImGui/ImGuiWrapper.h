@@ -1,7 +1,7 @@
 #pragma once
 #include "imgui.h"
+#include <Memory/PoolAllocator.h>
 #include <functional>
-#include <vector>
 
 /**
  * CUSTOM WRAPPER FOR ASYNC ENGINE
@@ -71,5 +71,5 @@ public:
 
 private:
 	/** List of ImGui function calls in order */
-	std::vector<std::function<void()>> m_calls;
+	PoolVector<std::function<void()>> m_calls;
 };
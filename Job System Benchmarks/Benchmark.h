@@ -0,0 +1,103 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/** Samples collected for one benchmark at one thread count */
+struct BenchmarkResult
+{
+	std::string m_name;
+	int m_numThreads = 0;
+	/** Number of operations (jobs, items, etc) measured in each sample, so results can be converted to throughput */
+	int m_numOps = 1;
+	/** One duration per repeat, in nanoseconds */
+	std::vector<double> m_samplesNS;
+};
+
+/** Collects benchmark results and writes them as JSON, so runs can be compared across commits */
+class BenchmarkReport
+{
+public:
+	BenchmarkReport(int hardwareThreads, int numRepeats) : m_hardwareThreads(hardwareThreads), m_numRepeats(numRepeats) { }
+
+	/** Returns a new result to add samples to */
+	BenchmarkResult& AddResult(const std::string& name, int numThreads, int numOps)
+	{
+		m_results.push_back({ name, numThreads, numOps, {} });
+		m_results.back().m_samplesNS.reserve(m_numRepeats);
+		return m_results.back();
+	}
+
+	int GetNumRepeats() const { return m_numRepeats; }
+
+	/** Writes every result with its median and percentiles */
+	void WriteJson(std::ostream& out) const
+	{
+		out << "{\n";
+		out << "\t\"hardwareThreads\": " << m_hardwareThreads << ",\n";
+		out << "\t\"repeats\": " << m_numRepeats << ",\n";
+		out << "\t\"results\": [\n";
+		for (size_t i = 0; i < m_results.size(); i++)
+		{
+			const BenchmarkResult& result = m_results[i];
+			std::vector<double> sorted = result.m_samplesNS;
+			std::sort(sorted.begin(), sorted.end());
+			double total = 0.0;
+			for (double sample : sorted)
+			{
+				total += sample;
+			}
+
+			out << "\t\t{ \"benchmark\": \"" << result.m_name << "\"";
+			out << ", \"threads\": " << result.m_numThreads;
+			out << ", \"ops\": " << result.m_numOps;
+			out << ", \"samples\": " << sorted.size();
+			if (!sorted.empty())
+			{
+				out << ", \"minNS\": " << sorted.front();
+				out << ", \"p10NS\": " << Percentile(sorted, 0.10);
+				out << ", \"medianNS\": " << Percentile(sorted, 0.50);
+				out << ", \"p90NS\": " << Percentile(sorted, 0.90);
+				out << ", \"p99NS\": " << Percentile(sorted, 0.99);
+				out << ", \"maxNS\": " << sorted.back();
+				out << ", \"meanNS\": " << total / sorted.size();
+				out << ", \"medianNSPerOp\": " << Percentile(sorted, 0.50) / result.m_numOps;
+			}
+			out << " }" << (i + 1 < m_results.size() ? "," : "") << "\n";
+		}
+		out << "\t]\n";
+		out << "}\n";
+	}
+
+private:
+	/** Returns the given percentile of sorted samples, interpolating between the nearest two */
+	static double Percentile(const std::vector<double>& sorted, double percentile)
+	{
+		double position = percentile * (sorted.size() - 1);
+		size_t lower = (size_t)position;
+		size_t upper = std::min(lower + 1, sorted.size() - 1);
+		double fraction = position - lower;
+		return sorted[lower] + (sorted[upper] - sorted[lower]) * fraction;
+	}
+
+	int m_hardwareThreads;
+	int m_numRepeats;
+	std::vector<BenchmarkResult> m_results;
+};
+
+/** Measures the time between construction and Stop() */
+class BenchmarkTimer
+{
+public:
+	BenchmarkTimer() : m_start(std::chrono::high_resolution_clock::now()) { }
+
+	double Stop() const
+	{
+		return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - m_start).count();
+	}
+
+private:
+	std::chrono::time_point<std::chrono::high_resolution_clock> m_start;
+};
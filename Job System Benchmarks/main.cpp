@@ -0,0 +1,653 @@
+#include <Concurrency/MPMCQueue.h>
+#include <Concurrency/MPSCQueue.h>
+#include <Concurrency/SPSCQueue.h>
+#include <FramePipeline/FramePipeline.h>
+#include <Jobs/Jobs.h>
+#include <Memory/MemoryPool.h>
+#include "Benchmark.h"
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+
+/**
+ * Job system benchmarks
+ * Runs each scenario at thread counts from 1 up to every hardware thread, and writes the median and percentiles of
+ * repeated runs to a JSON file, so scheduler changes can be compared across commits.
+ * Usage: "Job System Benchmarks" [output path, default benchmark_results.json] [max threads, default all hardware threads]
+ */
+
+constexpr int NUM_REPEATS = 15;
+constexpr int NUM_WARMUP_RUNS = 2;
+
+constexpr int SPAWN_JOBS = 2048;
+constexpr int FAN_OUT = 32;
+constexpr int CHAIN_LENGTH = 100;
+constexpr size_t PARALLEL_FOR_COUNT = 1 << 20;
+constexpr size_t PARALLEL_FOR_GRAINS[] = { 1024, 8192, 65536 };
+constexpr size_t NESTED_OUTER_COUNT = 16;
+constexpr size_t NESTED_INNER_COUNT = 1 << 16;
+constexpr size_t NESTED_INNER_GRAIN = 4096;
+constexpr int IMBALANCE_JOBS = 256;
+constexpr double IMBALANCE_MEAN_JOB_NS = 20000.0;
+constexpr int LATENCY_SAMPLES = 200;
+constexpr size_t ALLOC_COUNT = 1 << 16;
+constexpr size_t ALLOC_GRAIN = 1024;
+constexpr size_t FREE_GRAIN = 1536;
+constexpr size_t ALLOC_MAX_SIZE = 1024;
+constexpr size_t QUEUE_ITEMS = 1 << 16;
+constexpr size_t QUEUE_CHUNK = 1024;
+constexpr size_t QUEUE_BATCH = 16;
+constexpr size_t QUEUE_SPSC_SIZE = 1024;
+constexpr int QUEUE_ROUND_TRIPS = 1000;
+constexpr int PIPELINE_STAGES = 4;
+constexpr int PIPELINE_FRAMES = 1000;
+constexpr int PIPELINE_FRAMES_IN_FLIGHT = 4;
+constexpr size_t PIPELINE_ARENA_SIZE = 4096;
+
+static std::vector<float> parallelForData(PARALLEL_FOR_COUNT, 1.0f);
+static std::vector<float> nestedData(NESTED_OUTER_COUNT * NESTED_INNER_COUNT, 1.0f);
+
+struct PipelineBenchmark;
+
+struct BenchmarkContext
+{
+	BenchmarkReport* m_report = nullptr;
+	int m_numThreads = 0;
+	/** Pipelines are kept until the job system has stopped, as the last frame's jobs may still be running after a benchmark returns */
+	std::vector<std::unique_ptr<PipelineBenchmark>> m_pipelines;
+
+	// Main-thread latency benchmark state
+	BenchmarkResult* m_latencyResult = nullptr;
+	int m_latencyRunsLeft = 0;
+	std::chrono::time_point<std::chrono::high_resolution_clock> m_latencyCreateTime;
+};
+
+/** Busy-waits, so a job takes a known time without giving its thread back to the OS */
+static void Spin(long long durationNS)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	while (std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count() < durationNS)
+	{
+		_YIELD_PROCESSOR();
+	}
+}
+
+/** Runs a scenario NUM_WARMUP_RUNS times untimed, then NUM_REPEATS times, recording the time of each run */
+template<typename Func>
+static void Measure(BenchmarkContext& context, const std::string& name, int numOps, Func run)
+{
+	for (int i = 0; i < NUM_WARMUP_RUNS; i++)
+	{
+		run();
+	}
+	BenchmarkResult& result = context.m_report->AddResult(name, context.m_numThreads, numOps);
+	for (int i = 0; i < context.m_report->GetNumRepeats(); i++)
+	{
+		BenchmarkTimer timer;
+		run();
+		result.m_samplesNS.push_back(timer.Stop());
+	}
+	std::cout << "  " << name << " done" << std::endl;
+}
+
+void EmptyJob(void* data)
+{
+}
+
+void SpinJob(void* data)
+{
+	Spin((long long)(intptr_t)data);
+}
+
+// Spawn/execute throughput: many empty jobs created by one thread
+void SpawnBenchmark(BenchmarkContext& context)
+{
+	Measure(context, "spawn_empty", SPAWN_JOBS, []()
+		{
+			JobCounterPtr counter = Jobs::GetNewJobCounter();
+			for (int i = 0; i < SPAWN_JOBS; i++)
+			{
+				Jobs::CreateJobAndCount(EmptyJob, nullptr, JOBFLAG_NONE, counter);
+			}
+			Jobs::JoinUntilCompleted(counter);
+		});
+}
+
+// Creates FAN_OUT empty jobs counted on the given counter
+void FanOutJob(void* data)
+{
+	JobCounterPtr* counter = static_cast<JobCounterPtr*>(data);
+	for (int i = 0; i < FAN_OUT; i++)
+	{
+		Jobs::CreateJobAndCount(EmptyJob, nullptr, JOBFLAG_NONE, *counter);
+	}
+}
+
+// Fan-out/fan-in: a two-level tree of jobs, followed by one job that depends on all of them
+void FanOutFanInBenchmark(BenchmarkContext& context)
+{
+	Measure(context, "fan_out_fan_in", FAN_OUT + FAN_OUT * FAN_OUT + 1, []()
+		{
+			JobCounterPtr treeCounter = Jobs::GetNewJobCounter(true);
+			JobCounterPtr joinCounter = Jobs::GetNewJobCounter();
+			for (int i = 0; i < FAN_OUT; i++)
+			{
+				Jobs::CreateJobAndCount(FanOutJob, &treeCounter, JOBFLAG_NONE, treeCounter);
+			}
+			Jobs::CreateJobWithDependencyAndCount(EmptyJob, nullptr, JOBFLAG_NONE, treeCounter, joinCounter);
+			Jobs::JoinUntilCompleted(joinCounter);
+		});
+}
+
+// Deep dependency chain: each job waits on the counter of the one before it
+void DependencyChainBenchmark(BenchmarkContext& context)
+{
+	Measure(context, "dependency_chain", CHAIN_LENGTH, []()
+		{
+			JobCounterPtr previous = Jobs::GetNewJobCounter();
+			Jobs::CreateJobAndCount(EmptyJob, nullptr, JOBFLAG_NONE, previous);
+			for (int i = 1; i < CHAIN_LENGTH; i++)
+			{
+				JobCounterPtr next = Jobs::GetNewJobCounter();
+				Jobs::CreateJobWithDependencyAndCount(EmptyJob, nullptr, JOBFLAG_NONE, previous, next);
+				previous = next;
+			}
+			Jobs::JoinUntilCompleted(previous);
+		});
+}
+
+// ParallelFor over the same data with different chunk sizes
+void ParallelForGrainBenchmark(BenchmarkContext& context)
+{
+	for (size_t grain : PARALLEL_FOR_GRAINS)
+	{
+		Measure(context, "parallel_for_grain_" + std::to_string(grain), (int)PARALLEL_FOR_COUNT, [grain]()
+			{
+				Jobs::ParallelFor<float>(parallelForData.data(), PARALLEL_FOR_COUNT, grain, [](float* chunk, size_t chunkCount, size_t startIndex)
+					{
+						for (size_t i = 0; i < chunkCount; i++)
+						{
+							chunk[i] = chunk[i] * 1.0001f + 0.5f;
+						}
+					});
+			});
+	}
+}
+
+// Nested parallelism: a ParallelFor whose chunks each run their own ParallelFor
+void NestedParallelBenchmark(BenchmarkContext& context)
+{
+	Measure(context, "nested_parallel_for", (int)nestedData.size(), []()
+		{
+			Jobs::ParallelFor<float>(nestedData.data(), nestedData.size(), NESTED_INNER_COUNT, [](float* outerChunk, size_t outerCount, size_t outerStart)
+				{
+					Jobs::ParallelFor<float>(outerChunk, outerCount, NESTED_INNER_GRAIN, [](float* chunk, size_t chunkCount, size_t startIndex)
+						{
+							for (size_t i = 0; i < chunkCount; i++)
+							{
+								chunk[i] = chunk[i] * 1.0001f + 0.5f;
+							}
+						});
+				});
+		});
+}
+
+// Steal-heavy imbalance: jobs of very different lengths all created on one thread, so other threads must steal them
+void ImbalanceBenchmark(BenchmarkContext& context)
+{
+	// Same durations every run and every thread count
+	std::vector<long long> durations(IMBALANCE_JOBS);
+	std::mt19937 random(1234);
+	std::exponential_distribution<double> distribution(1.0 / IMBALANCE_MEAN_JOB_NS);
+	for (long long& duration : durations)
+	{
+		duration = (long long)distribution(random);
+	}
+
+	Measure(context, "steal_imbalance", IMBALANCE_JOBS, [&durations]()
+		{
+			JobCounterPtr counter = Jobs::GetNewJobCounter();
+			for (long long duration : durations)
+			{
+				Jobs::CreateJobAndCount(SpinJob, (void*)(intptr_t)duration, JOBFLAG_NONE, counter);
+			}
+			Jobs::JoinUntilCompleted(counter);
+		});
+}
+
+// Allocates blocks of mixed sizes in one ParallelFor and frees them in another with different chunks, so most blocks are
+// freed by a different thread than allocated them, as when frames pass data between pipeline stages
+template<typename AllocFunc, typename FreeFunc>
+void AllocationBenchmark(BenchmarkContext& context, const std::string& name, AllocFunc allocFunc, FreeFunc freeFunc)
+{
+	// Same sizes every run, weighted towards small objects
+	std::vector<size_t> sizes(ALLOC_COUNT);
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<double> distribution(0.0, 1.0);
+	for (size_t& size : sizes)
+	{
+		double r = distribution(random);
+		size = 16 + (size_t)(r * r * r * (ALLOC_MAX_SIZE - 16));
+	}
+	std::vector<void*> blocks(ALLOC_COUNT);
+
+	Measure(context, name, (int)ALLOC_COUNT, [&]()
+		{
+			Jobs::ParallelFor<void*>(blocks.data(), ALLOC_COUNT, ALLOC_GRAIN, [&](void** chunk, size_t chunkCount, size_t startIndex)
+				{
+					for (size_t i = 0; i < chunkCount; i++)
+					{
+						chunk[i] = allocFunc(sizes[startIndex + i]);
+						// Touch the memory, as a real object would
+						*static_cast<char*>(chunk[i]) = 1;
+					}
+				});
+			Jobs::ParallelFor<void*>(blocks.data(), ALLOC_COUNT, FREE_GRAIN, [&](void** chunk, size_t chunkCount, size_t startIndex)
+				{
+					for (size_t i = 0; i < chunkCount; i++)
+					{
+						freeFunc(chunk[i]);
+					}
+				});
+		});
+}
+
+void MallocBenchmark(BenchmarkContext& context)
+{
+	AllocationBenchmark(context, "alloc_free_malloc", [](size_t size) { return std::malloc(size); }, [](void* ptr) { std::free(ptr); });
+}
+
+void MemoryPoolBenchmark(BenchmarkContext& context)
+{
+	AllocationBenchmark(context, "alloc_free_pool", [](size_t size) { return MemoryPool::Allocate(size); }, [](void* ptr) { MemoryPool::Free(ptr); });
+}
+
+/** A queue guarded by a mutex, as a baseline for the lock-free queues */
+template<typename T>
+class MutexQueue
+{
+public:
+	bool TryPush(const T& item)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_items.push_back(item);
+		return true;
+	}
+	bool TryPop(T& itemOut)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_items.empty())
+		{
+			return false;
+		}
+		itemOut = m_items.front();
+		m_items.pop_front();
+		return true;
+	}
+
+private:
+	std::deque<T> m_items;
+	std::mutex m_mutex;
+};
+
+// Every chunk of a ParallelFor pushes its items to a shared queue, then pops as many items as it pushed, so every thread is
+// pushing and popping at once
+template<typename Queue>
+void SharedQueueBenchmark(BenchmarkContext& context, const std::string& name)
+{
+	std::vector<uint32_t> items(QUEUE_ITEMS, 1);
+	Queue queue(QUEUE_ITEMS);
+	Measure(context, name, (int)QUEUE_ITEMS, [&]()
+		{
+			Jobs::ParallelFor<uint32_t>(items.data(), items.size(), QUEUE_CHUNK, [&](uint32_t* chunk, size_t chunkCount, size_t startIndex)
+				{
+					for (size_t i = 0; i < chunkCount; i++)
+					{
+						queue.TryPush(chunk[i]);
+					}
+					for (size_t numPopped = 0; numPopped < chunkCount; )
+					{
+						uint32_t item;
+						numPopped += queue.TryPop(item) ? 1 : 0;
+					}
+				});
+		});
+}
+
+void MPMCQueueBenchmark(BenchmarkContext& context)
+{
+	SharedQueueBenchmark<MPMCQueue<uint32_t>>(context, "queue_mpmc_throughput");
+}
+
+// As above, but pushing and popping QUEUE_BATCH items at a time
+void MPMCQueueBatchBenchmark(BenchmarkContext& context)
+{
+	std::vector<uint32_t> items(QUEUE_ITEMS, 1);
+	MPMCQueue<uint32_t> queue(QUEUE_ITEMS);
+	Measure(context, "queue_mpmc_batch_throughput", (int)QUEUE_ITEMS, [&]()
+		{
+			Jobs::ParallelFor<uint32_t>(items.data(), items.size(), QUEUE_CHUNK, [&](uint32_t* chunk, size_t chunkCount, size_t startIndex)
+				{
+					for (size_t numPushed = 0; numPushed < chunkCount; )
+					{
+						numPushed += queue.TryPushBatch(chunk + numPushed, std::min(QUEUE_BATCH, chunkCount - numPushed));
+					}
+					uint32_t popped[QUEUE_BATCH];
+					for (size_t numPopped = 0; numPopped < chunkCount; )
+					{
+						numPopped += queue.TryPopBatch(popped, std::min(QUEUE_BATCH, chunkCount - numPopped));
+					}
+				});
+		});
+}
+
+void MutexQueueBenchmark(BenchmarkContext& context)
+{
+	struct SizedMutexQueue : MutexQueue<uint32_t>
+	{
+		SizedMutexQueue(size_t) { }
+	};
+	SharedQueueBenchmark<SizedMutexQueue>(context, "queue_mutex_throughput");
+}
+
+// One thread streams items through a small SPSCQueue to this one
+void SPSCQueueBenchmark(BenchmarkContext& context)
+{
+	SPSCQueue<uint32_t> queue(QUEUE_SPSC_SIZE);
+	Measure(context, "queue_spsc_throughput", (int)QUEUE_ITEMS, [&]()
+		{
+			std::thread producer([&]()
+				{
+					for (uint32_t i = 0; i < QUEUE_ITEMS; )
+					{
+						if (queue.TryPush(i))
+						{
+							i++;
+						}
+						else
+						{
+							std::this_thread::yield();
+						}
+					}
+				});
+			for (size_t numPopped = 0; numPopped < QUEUE_ITEMS; )
+			{
+				uint32_t popped[QUEUE_BATCH];
+				size_t count = queue.TryPopBatch(popped, QUEUE_BATCH);
+				if (count == 0)
+				{
+					std::this_thread::yield();
+				}
+				numPopped += count;
+			}
+			producer.join();
+		});
+}
+
+struct QueueBenchmarkNode : MPSCQueueNode
+{
+};
+
+// Every chunk of a ParallelFor pushes nodes to an MPSCQueue, while another thread pops them
+void MPSCQueueBenchmark(BenchmarkContext& context)
+{
+	std::vector<QueueBenchmarkNode> nodes(QUEUE_ITEMS);
+	MPSCQueue<QueueBenchmarkNode> queue;
+	Measure(context, "queue_mpsc_throughput", (int)QUEUE_ITEMS, [&]()
+		{
+			std::thread consumer([&]()
+				{
+					for (size_t numPopped = 0; numPopped < QUEUE_ITEMS; )
+					{
+						QueueBenchmarkNode* popped[QUEUE_BATCH];
+						size_t count = queue.TryPopBatch(popped, QUEUE_BATCH);
+						if (count == 0)
+						{
+							std::this_thread::yield();
+						}
+						numPopped += count;
+					}
+				});
+			Jobs::ParallelFor<QueueBenchmarkNode>(nodes.data(), nodes.size(), QUEUE_CHUNK, [&](QueueBenchmarkNode* chunk, size_t chunkCount, size_t startIndex)
+				{
+					for (size_t i = 0; i < chunkCount; i++)
+					{
+						queue.Push(&chunk[i]);
+					}
+				});
+			consumer.join();
+		});
+}
+
+// Round trip latency: this thread sends an item to another thread through one SPSCQueue, and waits for it to come back through another
+void SPSCQueueLatencyBenchmark(BenchmarkContext& context)
+{
+	SPSCQueue<uint32_t> requests(QUEUE_SPSC_SIZE);
+	SPSCQueue<uint32_t> responses(QUEUE_SPSC_SIZE);
+	Measure(context, "queue_spsc_round_trip", QUEUE_ROUND_TRIPS, [&]()
+		{
+			std::thread echo([&]()
+				{
+					for (int i = 0; i < QUEUE_ROUND_TRIPS; )
+					{
+						uint32_t item;
+						if (requests.TryPop(item))
+						{
+							responses.TryPush(item);
+							i++;
+						}
+						else
+						{
+							std::this_thread::yield();
+						}
+					}
+				});
+			for (uint32_t i = 0; i < QUEUE_ROUND_TRIPS; i++)
+			{
+				requests.TryPush(i);
+				uint32_t item;
+				while (!responses.TryPop(item))
+				{
+					std::this_thread::yield();
+				}
+			}
+			echo.join();
+		});
+}
+
+/** Frame data for the pipeline benchmarks. Nothing is stored in it. */
+struct PipelineBenchmarkData
+{
+};
+
+/** Stage that does no work, so only passing frames between stages is measured */
+class EmptyFrameStage : public FrameStageRunner<PipelineBenchmarkData>
+{
+public:
+	EmptyFrameStage() : FrameStageRunner("Empty") { }
+
+protected:
+	void RunJobInner(FrameData<PipelineBenchmarkData>& frame) override { }
+};
+
+/**
+ * Stages linked in a loop, like a FramePipeline, but sending frames round only until PIPELINE_FRAMES have been through.
+ * Frame timings aren't recorded, to keep them out of the measurement.
+ */
+struct PipelineBenchmark
+{
+	PipelineBenchmark(int numFramesInFlight)
+		: m_numFramesInFlight(numFramesInFlight)
+	{
+		for (int i = 0; i < PIPELINE_STAGES; i++)
+		{
+			m_stages.push_back(std::make_unique<EmptyFrameStage>());
+		}
+		for (int i = 0; i < PIPELINE_STAGES; i++)
+		{
+			m_stages[i]->AddNextStage(m_stages[(i + 1) % PIPELINE_STAGES].get());
+			m_stages[i]->SetFrameReclaimer(&m_reclaimer, i == 0, i == PIPELINE_STAGES - 1);
+			m_stages[i]->InitFrameQueue(numFramesInFlight);
+		}
+		m_stages.back()->SetFrameEndedCallback([this](FrameData<PipelineBenchmarkData>& frame) { FrameEnded(frame); });
+		m_frames.reserve(numFramesInFlight);
+		for (int i = 0; i < numFramesInFlight; i++)
+		{
+			m_frames.emplace_back(i, PipelineBenchmarkData(), PIPELINE_ARENA_SIZE);
+		}
+	}
+
+	/** Sends PIPELINE_FRAMES frames through every stage, and waits for the last one to leave */
+	void Run()
+	{
+		m_framesToStart = PIPELINE_FRAMES - m_numFramesInFlight;
+		m_framesEnded = 0;
+		JobCounterPtr counter = Jobs::GetNewJobCounter();
+		m_doneJob = Jobs::CreateUnqueuedJobAndCount(EmptyJob, nullptr, JOBFLAG_NONE, counter);
+		m_threadIndex = Jobs::GetThisThreadIndex();
+		for (FrameData<PipelineBenchmarkData>& frame : m_frames)
+		{
+			m_stages[0]->QueueFrame(frame);
+		}
+		Jobs::JoinUntilCompleted(counter);
+	}
+
+private:
+	/** Sends a frame round again, or releases Run() once the last frame has ended */
+	void FrameEnded(FrameData<PipelineBenchmarkData>& frame)
+	{
+		if (m_framesEnded.fetch_add(1) + 1 == PIPELINE_FRAMES)
+		{
+			Jobs::PostJob(std::move(m_doneJob), m_threadIndex);
+		}
+		else if (m_framesToStart.fetch_sub(1) > 0)
+		{
+			m_stages[0]->QueueFrame(frame);
+		}
+	}
+
+	FrameReclaimer m_reclaimer;
+	std::vector<std::unique_ptr<EmptyFrameStage>> m_stages;
+	std::vector<FrameData<PipelineBenchmarkData>> m_frames;
+	const int m_numFramesInFlight;
+	std::atomic<int> m_framesToStart = 0;
+	std::atomic<int> m_framesEnded = 0;
+	/** Posted when the last frame ends, to the thread waiting in Run() */
+	JobPtr m_doneJob;
+	uint8_t m_threadIndex = 0;
+};
+
+// Frame handoff: empty stages pass frames round a loop. With one frame in flight, each op is the latency of one handoff from a stage
+// finishing to the next one starting. With several, stages hand frames to each other at the same time, so it measures their contention.
+void PipelineHandoffBenchmark(BenchmarkContext& context)
+{
+	for (int numFramesInFlight : { 1, PIPELINE_FRAMES_IN_FLIGHT })
+	{
+		context.m_pipelines.push_back(std::make_unique<PipelineBenchmark>(numFramesInFlight));
+		PipelineBenchmark& pipeline = *context.m_pipelines.back();
+		std::string name = "pipeline_handoff_" + std::to_string(numFramesInFlight) + "_frames";
+		Measure(context, name, PIPELINE_FRAMES * PIPELINE_STAGES, [&]()
+			{
+				pipeline.Run();
+			});
+	}
+}
+
+void LatencyMainThreadJob(void* data);
+
+// Creates a main-thread job and records when it was created
+void LatencyProducerJob(void* data)
+{
+	BenchmarkContext& context = *static_cast<BenchmarkContext*>(data);
+	context.m_latencyCreateTime = std::chrono::high_resolution_clock::now();
+	Jobs::CreateJob(LatencyMainThreadJob, data, JOBFLAG_MAINTHREAD);
+}
+
+// Records how long it took the main thread to start this job, then starts the next run or finishes the benchmarks
+void LatencyMainThreadJob(void* data)
+{
+	BenchmarkContext& context = *static_cast<BenchmarkContext*>(data);
+	double latencyNS = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - context.m_latencyCreateTime).count();
+	// The first runs are warm-up
+	if (context.m_latencyRunsLeft <= LATENCY_SAMPLES)
+	{
+		context.m_latencyResult->m_samplesNS.push_back(latencyNS);
+	}
+
+	if (--context.m_latencyRunsLeft > 0)
+	{
+		Jobs::CreateJob(LatencyProducerJob, data, JOBFLAG_NONE);
+	}
+	else
+	{
+		std::cout << "  main_thread_latency done" << std::endl;
+		Jobs::Stop();
+	}
+}
+
+// Main-thread job latency: time from a job creating a main-thread job to the main thread starting it.
+// This can't be measured from within a job that the main thread is running, so it runs as a chain of jobs after the main job has returned.
+void StartMainThreadLatencyBenchmark(BenchmarkContext& context)
+{
+	context.m_latencyResult = &context.m_report->AddResult("main_thread_latency", context.m_numThreads, 1);
+	context.m_latencyRunsLeft = LATENCY_SAMPLES + NUM_WARMUP_RUNS;
+	Jobs::CreateJob(LatencyProducerJob, &context, JOBFLAG_NONE);
+}
+
+// Runs every benchmark at the current thread count
+void BenchmarkMain(void* data)
+{
+	BenchmarkContext& context = *static_cast<BenchmarkContext*>(data);
+	SpawnBenchmark(context);
+	FanOutFanInBenchmark(context);
+	DependencyChainBenchmark(context);
+	ParallelForGrainBenchmark(context);
+	NestedParallelBenchmark(context);
+	ImbalanceBenchmark(context);
+	MallocBenchmark(context);
+	MemoryPoolBenchmark(context);
+	MutexQueueBenchmark(context);
+	MPMCQueueBenchmark(context);
+	MPMCQueueBatchBenchmark(context);
+	SPSCQueueBenchmark(context);
+	MPSCQueueBenchmark(context);
+	SPSCQueueLatencyBenchmark(context);
+	PipelineHandoffBenchmark(context);
+	// Finishes by stopping the job system
+	StartMainThreadLatencyBenchmark(context);
+}
+
+int main(int argc, char** argv)
+{
+	const char* outputPath = argc > 1 ? argv[1] : "benchmark_results.json";
+	int hardwareThreads = std::max(1, (int)std::thread::hardware_concurrency());
+	int maxThreads = argc > 2 ? std::max(1, std::atoi(argv[2])) : hardwareThreads;
+
+	// Powers of two up to the maximum
+	std::vector<int> threadCounts;
+	for (int numThreads = 1; numThreads < maxThreads; numThreads *= 2)
+	{
+		threadCounts.push_back(numThreads);
+	}
+	threadCounts.push_back(maxThreads);
+
+	BenchmarkReport report(hardwareThreads, NUM_REPEATS);
+	for (int numThreads : threadCounts)
+	{
+		std::cout << "Running benchmarks with " << numThreads << " threads" << std::endl;
+		BenchmarkContext context;
+		context.m_report = &report;
+		context.m_numThreads = numThreads;
+		Jobs jobs(numThreads, BenchmarkMain, &context);
+	}
+
+	std::ofstream file(outputPath);
+	report.WriteJson(file);
+	std::cout << "Results written to " << outputPath << std::endl;
+	return 0;
+}
@@ -1,4 +1,5 @@
 #pragma once
+#include <FramePipeline/FrameArena.h>
 #include <Graphics/Camera/CameraData.h>
 #include <Graphics/Model/ModelToRender.h>
 #include <ImGuiWrapper.h>
@@ -21,11 +22,12 @@ public:
 	{
 	}
 
-	void Reset(int64_t frameNumber)
+	/** Clears this frame's data, and sets containers up to allocate from the frame's arena. Call before resetting the arena. */
+	void Reset(int64_t frameNumber, FrameArena& arena)
 	{
 		m_stage = FrameStage::FRAME_START;
 		m_frameNumber = frameNumber;
-		m_modelsToRender.clear();
+		m_modelsToRender = FrameVector<ModelToRender>(FrameArenaAllocator<ModelToRender>(arena));
 		m_imgui.Clear();
 	}
 
@@ -44,8 +46,8 @@ public:
 	InputState m_input;
 	/** Matrices and other data about the camera. Valid after GAME_LOGIC. */
 	CameraData m_camera;
-	/** List of models to render. Valid after GAME_LOGIC. */
-	std::vector<ModelToRender> m_modelsToRender;
+	/** List of models to render, allocated from the frame's arena. Valid after GAME_LOGIC. */
+	FrameVector<ModelToRender> m_modelsToRender;
 
 	/** Wrapper for ImGui calls */
 	ImGuiFrameWrapper m_imgui;
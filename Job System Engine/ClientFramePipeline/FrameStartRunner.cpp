@@ -1,14 +1,15 @@
 #include "FrameStartRunner.h"
+#include "../GameApp.h"
 #include <Input/Input.h>
 #include <GLFW/glfw3.h>
 #include <iostream>
 
-void FrameStartRunner::RunJobInner()
+void FrameStartRunner::RunJobInner(FrameData<ClientFrameData>& frame)
 {
-	// Reset this frameData
-	ClientFrameData& frameData = *m_frameData->GetData();
-	frameData.Reset(m_frameCount);
-	m_frameCount++;
+	// Reset this frameData, then free everything it allocated last time round the pipeline
+	ClientFrameData& frameData = *frame.GetData();
+	frameData.Reset(frame.m_frameNumber, frame.m_arena);
+	frame.m_arena.Reset();
 
 	// glfw events must be run on the main thread, so do that here
 	Jobs::CreateJob(FrameStartRunner::MainThreadTasks, this, JOBFLAG_MAINTHREAD | JOBFLAG_ISCHILD);
@@ -25,7 +26,7 @@ DEFINE_CLASS_JOB(FrameStartRunner, MainThreadTasks)
 		std::cout << "Closing window" << std::endl;
 		glfwDestroyWindow(frameData.m_window);
 		glfwTerminate();
-		Jobs::Stop();
+		GameApp::Stop();
 		return;
 	}
 
@@ -34,16 +35,71 @@ DEFINE_CLASS_JOB(FrameStartRunner, MainThreadTasks)
 	frameData.m_deltaTime = currentTime - m_lastFrameStartTime;
 	m_lastFrameStartTime = currentTime;
 
-#if JOBS_COLLECT_METRICS
+	// Record one frame's worth of jobs, for the job simulator
+	if (Jobs::IsRecording())
+	{
+		const char* recordingPath = "job_recording.txt";
+		if (Jobs::EndRecording(recordingPath))
+		{
+			std::cout << "Saved job recording to " << recordingPath << std::endl;
+		}
+	}
+	else if (m_recordJobsRequested.exchange(false))
+	{
+		Jobs::BeginRecording();
+	}
+
 	frameData.m_imgui.Queue(ImGui::Begin, "Job metrics", nullptr, 0);
 	frameData.m_imgui.QueueComplex([]()
 		{
 			ImGui::Text("FPS: %f", ImGui::GetIO().Framerate);
 		});
+#if JOBS_COLLECT_METRICS
 	frameData.m_imgui.QueueButton("Reset", []()
 		{
 			Jobs::ResetMetrics();
 		});
+#endif
+	frameData.m_imgui.QueueButton("Record frame jobs", [this]()
+		{
+			m_recordJobsRequested = true;
+		});
+	frameData.m_imgui.Queue(ImGui::Text, "Active threads: %d / %d", Jobs::GetNumActiveThreads(), (int)Jobs::GetNumThreads());
+	// This frame's arena was just reset, so show its high-water mark from previous frames
+	FrameArenaStats arenaStats = m_frameData->m_arena.GetStats();
+	frameData.m_imgui.Queue(ImGui::Text, "Frame arena: %.1f MB peak / %.1f MB", (double)arenaStats.m_highWaterBytes / (1024.0 * 1024.0), (double)arenaStats.m_capacity / (1024.0 * 1024.0));
+	frameData.m_imgui.Queue(ImGui::Text, "Frames in flight: %d / %d", m_pipeline.GetNumFramesInFlight(), m_pipeline.GetMaxFramesInFlight());
+	for (const FramesInFlightChange& change : m_pipeline.GetFramesInFlightChanges())
+	{
+		frameData.m_imgui.Queue(ImGui::Text, " - Frame %lld: %d -> %d (slowest stage %.2f ms, slowest path %.2f ms, latency %.2f ms)", (long long)change.m_frameNumber,
+			change.m_oldFrames, change.m_newFrames, change.m_slowestStageMS, change.m_totalStageMS, change.m_latencyMS);
+	}
+
+	// Where recent frames spent their time in each stage
+	FrameTelemetryStats telemetryStats = m_pipeline.GetTelemetry().GetStats();
+	frameData.m_imgui.Queue(ImGui::Text, "Last %d frames: %.2f ms average latency", (int)telemetryStats.m_numFrames, telemetryStats.m_averageLatencyMS);
+	int backPressureStage = m_pipeline.GetBackPressureStage();
+	frameData.m_imgui.Queue(ImGui::Text, "Dropped frames: %lld, back-pressure: %s", (long long)m_pipeline.GetNumDroppedFrames(),
+		backPressureStage >= 0 ? m_pipeline.m_stages[backPressureStage]->GetName() : "none");
+	for (int stage = 0; stage < (int)telemetryStats.m_stages.size(); stage++)
+	{
+		const FrameStageStats& stageStats = telemetryStats.m_stages[stage];
+		frameData.m_imgui.Queue(ImGui::Text, " - %s%s: %.2f ms processing, %.2f ms queued, %.2f ms waiting for a thread, %.0f%% busy, %d bubbles (%.2f ms)",
+			stageStats.m_name, stage == telemetryStats.m_bottleneckStage ? " (bottleneck)" : "", stageStats.m_averageProcessingMS, stageStats.m_averageWaitMS,
+			stageStats.m_averageThreadWaitMS, stageStats.m_utilisation * 100.0, stageStats.m_numBubbles, stageStats.m_bubbleMS);
+	}
+	frameData.m_imgui.QueueButton("Dump frame timings", [this]()
+		{
+			const char* csvPath = "frame_timings.csv";
+			const char* jsonPath = "frame_timings.json";
+			if (m_pipeline.GetTelemetry().WriteCSV(csvPath) && m_pipeline.GetTelemetry().WriteJSON(jsonPath))
+			{
+				std::cout << "Saved frame timings to " << csvPath << " and " << jsonPath << std::endl;
+			}
+		});
+
+	// Per-thread job counters, which are only collected with job metrics on
+#if JOBS_COLLECT_METRICS
 	int totalJobsExecuted = 0;
 	for (size_t thread = 0; thread < Jobs::GetNumThreads(); thread++)
 	{
@@ -55,7 +111,8 @@ DEFINE_CLASS_JOB(FrameStartRunner, MainThreadTasks)
 		float percentageStarved = (float)numStarved * 100.0f / (float)totalLoops;
 		int ownExecuted = Jobs::GetNumOwnJobs(thread);
 		int stolenExecuted = Jobs::GetNumStolenJobs(thread);
-		int totalExecuted = ownExecuted + stolenExecuted;
+		int mailboxExecuted = Jobs::GetNumMailboxJobs(thread);
+		int totalExecuted = ownExecuted + stolenExecuted + mailboxExecuted;
 		float percentageStolen = (float)stolenExecuted * 100.0f / (float)totalExecuted;
 		int jobsCreated = Jobs::GetNumJobsCreated(thread);
 		int mainThreadJobsCreated = Jobs::GetNumMainThreadJobsCreated(thread);
@@ -85,6 +142,7 @@ DEFINE_CLASS_JOB(FrameStartRunner, MainThreadTasks)
 		frameData.m_imgui.Queue(ImGui::Text, "Total executed: %d", totalExecuted);
 		frameData.m_imgui.Queue(ImGui::Text, " - Own:    %d", ownExecuted);
 		frameData.m_imgui.Queue(ImGui::Text, " - Stolen: %d", stolenExecuted);
+		frameData.m_imgui.Queue(ImGui::Text, " - Mailbox: %d", mailboxExecuted);
 		frameData.m_imgui.Queue(ImGui::Text, " - Percentage stolen: %f", percentageStolen);
 		frameData.m_imgui.Queue(ImGui::Text, "Total created: %d", jobsCreated);
 		frameData.m_imgui.Queue(ImGui::Text, " - Main thread: %d", mainThreadJobsCreated);
@@ -101,7 +159,7 @@ DEFINE_CLASS_JOB(FrameStartRunner, MainThreadTasks)
 	auto seconds = std::chrono::duration_cast<std::chrono::duration<float>>(duration);
 	float jobsPerSecond = (float)totalJobsExecuted / seconds.count();
 	frameData.m_imgui.Queue(ImGui::Text, "Jobs-per-second: %f", jobsPerSecond);
+#endif
 
 	frameData.m_imgui.Queue(ImGui::End);
-#endif
 }
\ No newline at end of file
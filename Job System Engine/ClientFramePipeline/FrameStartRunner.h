@@ -1,24 +1,28 @@
 #pragma once
 #include "ClientFrameData.h"
+#include <FramePipeline/FramePipeline.h>
 #include <FramePipeline/FrameStageRunner.h>
 #include <Jobs/JobDecl.h>
+#include <atomic>
 
 class FrameStartRunner : public FrameStageRunner<ClientFrameData>
 {
 public:
-	FrameStartRunner() : FrameStageRunner("Frame Start") { }
+	FrameStartRunner(FramePipeline<ClientFrameData>& pipeline) : FrameStageRunner("Frame Start"), m_pipeline(pipeline) { }
 protected:
-	virtual void RunJobInner() override;
+	virtual void RunJobInner(FrameData<ClientFrameData>& frame) override;
 
 private:
 	DECLARE_CLASS_JOB(FrameStartRunner, MainThreadTasks);
 
 private:
-	/** Number of frames that have been started */
-	int m_frameCount = 0;
+	/** The pipeline this stage is in, for its metrics */
+	FramePipeline<ClientFrameData>& m_pipeline;
 	/** Time at the start of the last frame (in seconds since the app started) */
 	double m_lastFrameStartTime = 0.0;
 	/** Test ImGui */
 	bool m_showImGuiDemo = true;
+	/** Set from the metrics window to record the jobs run between the next two frame starts */
+	std::atomic<bool> m_recordJobsRequested = false;
 };
 
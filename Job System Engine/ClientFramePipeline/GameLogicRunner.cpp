@@ -7,11 +7,15 @@
 void GameLogicRunner::Init()
 {
 	// Set up a basic scene here
-	m_testModel.Load("Assets/unitcube.obj");
+	m_testModel = new ModelAsset();
+	m_testModel->Load(TEST_MODEL_PATH);
 	m_camera.m_transform.Translate(glm::vec3(1.0f, 0.0f, 2.0f));
 	m_camera.m_transform.Rotate(glm::vec3(0.0f, -90.0f, 0.0f));
+	m_previousCameraPosition = m_camera.m_transform.GetLocalPosition();
 
 	// Randomise the position of lots of cubes
+	m_testModelTransforms.Init(NUM_CUBES, CUBE_PARALLEL_CHUNK_SIZE, m_testModelPartitioner);
+	m_previousCubeRotations.Init(NUM_CUBES, CUBE_PARALLEL_CHUNK_SIZE, m_testModelPartitioner);
 	srand(0);
 	Jobs::ParallelFor(m_testModelTransforms.data(), NUM_CUBES, CUBE_PARALLEL_CHUNK_SIZE, std::function([=](Transform* data, size_t count, size_t startIndex)
 		{
@@ -19,23 +23,20 @@ void GameLogicRunner::Init()
 			{
 				Transform& t = data[i];
 				t.Translate(glm::vec3(rand() % CUBE_RANDOM_POS_RANGE, rand() % CUBE_RANDOM_POS_RANGE, rand() % CUBE_RANDOM_POS_RANGE));
+				m_previousCubeRotations[startIndex + i] = t.GetLocalRotation();
 			}
-		}));
+		}), m_testModelPartitioner);
 }
 
 // GameLogicRunner holds the ONLY representation of the game scene. Anything needed for rendering is extracted into FrameData before we proceed to RenderLogic
-void GameLogicRunner::RunJobInner()
+void GameLogicRunner::RunJobInner(FrameData<ClientFrameData>& frame)
 {
 	// Run game logic here (scripts, simulation, etc.)
-	ClientFrameData& frameData = *m_frameData->GetData();
+	ClientFrameData& frameData = *frame.GetData();
 	ASSERT(frameData.m_stage == FrameStage::FRAME_START);
 	frameData.m_stage = FrameStage::GAME_LOGIC;
 
-	// m_scene.RunFixedUpdate(); // Loop this however many times is needed for the fixed timestep
-	// m_scene.RunFrameUpdate(); // Run once per frame
-	// m_scene.ExtractFrameData(); // Returns data needed to render the scene
-
-	// Move camera
+	// Move camera, in whichever direction is held for the whole frame
 	InputState& input = frameData.m_input;
 	glm::vec3 moveDir = glm::vec3(0.0f);
 	if (input.GetKeyHeld(GLFW_KEY_W))
@@ -55,9 +56,7 @@ void GameLogicRunner::RunJobInner()
 		moveDir -= m_camera.m_transform.GetRightVector();
 	}
 
-	m_camera.m_transform.Translate(moveDir * 0.01f);
-
-	// Rotate camera
+	// Rotate camera. Mouse movement is per frame rather than per second, so this isn't part of the fixed steps.
 	const glm::vec2& mouseDelta = input.GetLastMouseOffset();
 	glm::vec3 rotation = m_camera.m_transform.GetLocalRotation();
 	rotation.x = glm::clamp(rotation.x - mouseDelta.y, -80.0f, 80.0f);
@@ -67,27 +66,123 @@ void GameLogicRunner::RunJobInner()
 	rotation.z = 0.0f;
 	m_camera.m_transform.SetLocalRotation(rotation);
 
-	// Rotate models
+	UpdateModelReload(input);
+
+	// Simulate as many fixed steps as the time since the last frame calls for
+	int numSteps = m_timestep.Advance(frameData.m_deltaTime);
+	for (int step = 0; step < numSteps; step++)
+	{
+		RunFixedUpdate(moveDir, step == numSteps - 1);
+	}
+
+	// A frame that won't be drawn doesn't need anything extracted for it
+	if (DropFrameIfOverloaded(frame))
+	{
+		return;
+	}
+
+	// Extract data into m_frameData, blended between the last two steps so movement is smooth at any frame rate
+	float alpha = (float)m_timestep.GetInterpolationAlpha();
+	glm::vec3 simulatedCameraPosition = m_camera.m_transform.GetLocalPosition();
+	glm::vec3 cameraPosition = glm::mix(m_previousCameraPosition, simulatedCameraPosition, alpha);
+	glm::vec3 cameraForward = m_camera.m_transform.GetForwardVector();
+	m_camera.m_transform.SetLocalPosition(cameraPosition);
+	frameData.m_camera = m_camera.GetFrameData();
+	m_camera.m_transform.SetLocalPosition(simulatedCameraPosition);
+	// Cull cubes behind the camera. Each job appends the cubes it keeps, so the number doesn't need to be known up-front.
+	m_visibleModels.Clear();
 	Jobs::ParallelFor(m_testModelTransforms.data(), NUM_CUBES, CUBE_PARALLEL_CHUNK_SIZE, std::function([=](Transform* data, size_t count, size_t startIndex)
 		{
 			for (int i = 0; i < count; i++)
 			{
 				Transform& t = data[i];
-				t.Rotate(glm::vec3(0.1f, 0.1f, 0.1f));
+				if (glm::dot(t.GetLocalPosition() - cameraPosition, cameraForward) < -CUBE_BOUNDING_RADIUS)
+				{
+					continue;
+				}
+				// Not a copy of t, as copying a Transform makes it a child of the original
+				Transform interpolated;
+				interpolated.SetLocalPosition(t.GetLocalPosition());
+				interpolated.SetLocalScale(t.GetLocalScale());
+				interpolated.SetLocalRotation(glm::mix(m_previousCubeRotations[startIndex + i], t.GetLocalRotation(), alpha));
+				m_visibleModels.Push({ m_testModel, interpolated.GetTRS() });
 			}
-		}));
+		}), m_testModelPartitioner);
+	m_visibleModels.CompactTo(frameData.m_modelsToRender);
+}
 
+void GameLogicRunner::RunFixedUpdate(const glm::vec3& moveDir, bool isLastStep)
+{
+	float stepTime = (float)m_timestep.GetStepTime();
+	if (isLastStep)
+	{
+		m_previousCameraPosition = m_camera.m_transform.GetLocalPosition();
+	}
+	m_camera.m_transform.Translate(moveDir * CAMERA_SPEED * stepTime);
 
-	// Extract data into m_frameData
-	frameData.m_camera = m_camera.GetFrameData();
-	frameData.m_modelsToRender.resize(NUM_CUBES);
-	Jobs::ParallelFor(m_testModelTransforms.data(), NUM_CUBES, CUBE_PARALLEL_CHUNK_SIZE, std::function([=, modelsToRender = &frameData.m_modelsToRender](Transform* data, size_t count, size_t startIndex)
+	// Rotate models
+	glm::vec3 spin = glm::vec3(CUBE_SPIN_SPEED * stepTime);
+	Jobs::ParallelFor(m_testModelTransforms.data(), NUM_CUBES, CUBE_PARALLEL_CHUNK_SIZE, std::function([=](Transform* data, size_t count, size_t startIndex)
 		{
 			for (int i = 0; i < count; i++)
 			{
 				Transform& t = data[i];
-				(*modelsToRender)[startIndex + i].m_model = &m_testModel;
-				(*modelsToRender)[startIndex + i].m_transRotScale = t.GetTRS();
+				if (isLastStep)
+				{
+					m_previousCubeRotations[startIndex + i] = t.GetLocalRotation();
+				}
+				t.Rotate(spin);
 			}
-		}));
+		}), m_testModelPartitioner);
+}
+
+namespace
+{
+	/** Frees a retired model. Its vertex buffers must be deleted on the main thread. */
+	void DeleteModel(void* data)
+	{
+		ModelAsset* model = static_cast<ModelAsset*>(data);
+		model->Unload();
+		delete model;
+	}
+}
+
+void GameLogicRunner::UpdateModelReload(const InputState& input)
+{
+	if (m_reloadingModel == nullptr)
+	{
+		if (input.GetKeyDown(GLFW_KEY_R))
+		{
+			m_reloadingModel = new ModelAsset();
+			m_reloadingModel->Load(TEST_MODEL_PATH);
+		}
+		return;
+	}
+
+	LoadState state = m_reloadingModel->GetLoadState();
+	if (state == LoadState::FAILED)
+	{
+		// Never seen by a frame, so it can be deleted straight away
+		delete m_reloadingModel;
+		m_reloadingModel = nullptr;
+	}
+	else if (state == LoadState::LOADED)
+	{
+		// Frames from here on draw the new model, and the old one is freed once the frames drawing it have finished
+		ModelAsset* oldModel = m_testModel;
+		m_testModel = m_reloadingModel;
+		m_reloadingModel = nullptr;
+		GetFrameReclaimer().Retire([oldModel]()
+			{
+				if (Jobs::IsRunning())
+				{
+					Jobs::CreateJob(DeleteModel, oldModel, JOBFLAG_MAINTHREAD);
+				}
+				else
+				{
+					// Shutting down, so the GL context (and the model's buffers) are already gone
+					delete oldModel;
+				}
+			});
+	}
 }
\ No newline at end of file
@@ -1,16 +1,35 @@
 #pragma once
 #include "ClientFrameData.h"
+#include <FramePipeline/FixedTimestep.h>
 #include <FramePipeline/FrameStageRunner.h>
 #include <Graphics/Camera/Camera.h>
 #include <Graphics/Model/ModelAsset.h>
+#include <Jobs/AppendBuffer.h>
+#include <Jobs/PagedArray.h>
+
+struct InputState;
 
 class GameLogicRunner : public FrameStageRunner<ClientFrameData>
 {
 public:
+	/** The scene is simulated in fixed steps of this many seconds */
+	static constexpr double SIMULATION_STEP_TIME = 1.0 / 60.0;
+
 	GameLogicRunner() : FrameStageRunner("Game Logic") { }
+	~GameLogicRunner()
+	{
+		delete m_testModel;
+		delete m_reloadingModel;
+	}
 	virtual void Init() override;
 protected:
-	virtual void RunJobInner() override;
+	virtual void RunJobInner(FrameData<ClientFrameData>& frame) override;
+
+private:
+	/** Advances the scene by one fixed step. On the last step of a frame, keeps the state from before it to interpolate from. */
+	void RunFixedUpdate(const glm::vec3& moveDir, bool isLastStep);
+	/** Reloads the test model when R is pressed, and swaps it in once loaded */
+	void UpdateModelReload(const InputState& input);
 
 private:
 	/********
@@ -18,12 +37,35 @@ private:
 	********/
 
 	Camera m_camera;
+	/** Camera speed, in units per second */
+	static constexpr float CAMERA_SPEED = 1.0f;
+	/** Camera position before the last step, for interpolation */
+	glm::vec3 m_previousCameraPosition = glm::vec3(0.0f);
+
+	/** At most MAX_SIMULATION_STEPS_PER_FRAME steps are run a frame, so a slow frame can't make the next one slower */
+	static constexpr int MAX_SIMULATION_STEPS_PER_FRAME = 4;
+	FixedTimestep m_timestep = FixedTimestep(SIMULATION_STEP_TIME, MAX_SIMULATION_STEPS_PER_FRAME);
 
-	ModelAsset m_testModel;
+	static constexpr const char* TEST_MODEL_PATH = "Assets/unitcube.obj";
+	/** Model drawn by every cube. Frames in flight point at it, so it is retired through the FrameReclaimer when replaced. */
+	ModelAsset* m_testModel = nullptr;
+	/** Reloaded copy of the test model that replaces m_testModel once loaded */
+	ModelAsset* m_reloadingModel = nullptr;
 	static constexpr int NUM_CUBES = 300000;
 	static constexpr int CUBE_PARALLEL_CHUNK_SIZE = 10000;
 	static constexpr int CUBE_RANDOM_POS_RANGE = 50;
-	std::array<Transform, NUM_CUBES> m_testModelTransforms;
+	/** How fast each cube spins around each axis, in degrees per second */
+	static constexpr float CUBE_SPIN_SPEED = 6.0f;
+	/** Radius of a sphere around each cube, for culling */
+	static constexpr float CUBE_BOUNDING_RADIUS = 1.0f;
+	/** Every cube's transform, constructed in Init() by the threads that go on to process each chunk of it */
+	PagedArray<Transform> m_testModelTransforms;
+	/** Every cube's rotation before the last step, for interpolation */
+	PagedArray<glm::vec3> m_previousCubeRotations;
+	/** Keeps each chunk of m_testModelTransforms on the same thread across ParallelFors, so it stays in that thread's cache */
+	AffinityPartitioner m_testModelPartitioner;
+	/** Cubes that passed culling this frame, before they're compacted into the frame's list of models to render */
+	AppendBuffer<ModelToRender> m_visibleModels;
 
 	/********
 	  DEBUG
@@ -0,0 +1,21 @@
+#include "HeadlessFrameStartRunner.h"
+#include <Input/Input.h>
+
+void HeadlessFrameStartRunner::RunJobInner(FrameData<ClientFrameData>& frame)
+{
+	// Reset this frameData, then free everything it allocated last time round the pipeline
+	ClientFrameData& frameData = *frame.GetData();
+	frameData.Reset(frame.m_frameNumber, frame.m_arena);
+	frame.m_arena.Reset();
+
+	// This stage runs one frame at a time in order, so scripted events land on the frames they were written for
+	Input& input = frameData.m_inputHandler;
+	input.RefreshInputs();
+	if (m_inputScript != nullptr)
+	{
+		m_inputScript->Apply(frame.m_frameNumber, input);
+	}
+	frameData.m_input = input.ExtractInputState();
+
+	frameData.m_deltaTime = m_frameTime;
+}
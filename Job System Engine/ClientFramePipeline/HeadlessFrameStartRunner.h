@@ -0,0 +1,24 @@
+#pragma once
+#include "ClientFrameData.h"
+#include <FramePipeline/FrameStageRunner.h>
+#include <Input/InputScript.h>
+
+/**
+ * First stage when running headless, in place of FrameStartRunner.
+ * There is no window to poll, so input is replayed from an InputScript (if there is one), and frames start as soon as there's room for them.
+ * Every frame is given the same delta time rather than the time since the last one, so a scripted run simulates the same steps
+ * however fast the machine is, and its recording can be compared between runs.
+ */
+class HeadlessFrameStartRunner : public FrameStageRunner<ClientFrameData>
+{
+public:
+	HeadlessFrameStartRunner(InputScript* inputScript, double frameTime) : FrameStageRunner("Frame Start"), m_inputScript(inputScript), m_frameTime(frameTime) { }
+protected:
+	virtual void RunJobInner(FrameData<ClientFrameData>& frame) override;
+
+private:
+	/** Input events to replay, or nullptr for none */
+	InputScript* m_inputScript;
+	/** Delta time of every frame, in seconds */
+	double m_frameTime;
+};
@@ -0,0 +1,84 @@
+#include "HeadlessOutputRunner.h"
+#include "../GameApp.h"
+#include <Diagnostic/Assert.h>
+#include <glm/matrix.hpp>
+#include <cstdio>
+#include <iostream>
+
+void HeadlessOutputRunner::Init()
+{
+	if (!m_recordPath.empty())
+	{
+		m_recordFile.open(m_recordPath);
+		if (!m_recordFile)
+		{
+			std::cout << "Error opening " << m_recordPath << " to record frames" << std::endl;
+			return;
+		}
+		m_recordFile << "# frame models cameraX cameraY cameraZ\n";
+	}
+}
+
+void HeadlessOutputRunner::RunJobInner(FrameData<ClientFrameData>& frame)
+{
+	ClientFrameData& frameData = *frame.GetData();
+	frameData.m_stage = FrameStage::GPU_EXECUTION;
+
+	// Frames already in flight carry on after the last one, until the job system stops. They don't count, so are skipped before the order check.
+	if (m_numFrames > 0 && m_framesCompleted >= m_numFrames)
+	{
+		return;
+	}
+
+	// Debug: Make sure frames are running in the correct order
+	ASSERT(frameData.m_frameNumber == m_framesCompleted);
+	if (m_framesCompleted == 0)
+	{
+		m_firstFrameBeginTime = frame.m_beginTime;
+	}
+
+	if (m_recordFile.is_open())
+	{
+		glm::vec3 cameraPosition = glm::inverse(frameData.m_camera.m_viewMatrix)[3];
+		m_recordFile << frameData.m_frameNumber << " " << frameData.m_modelsToRender.size() << " "
+			<< cameraPosition.x << " " << cameraPosition.y << " " << cameraPosition.z << "\n";
+	}
+
+	if (frameData.m_frameNumber % 100 == 0)
+	{
+		std::printf("Completed frame %lld \n", (long long)frameData.m_frameNumber);
+	}
+	m_framesCompleted++;
+	if (m_framesCompleted == m_numFrames)
+	{
+		FinishRun();
+	}
+}
+
+void HeadlessOutputRunner::FinishRun()
+{
+	m_recordFile.close();
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - m_firstFrameBeginTime).count();
+	std::printf("Ran %lld frames in %.2f s (%.1f frames per second)\n", (long long)m_framesCompleted, seconds, (double)m_framesCompleted / seconds);
+
+	// Where recent frames spent their time in each stage. This frame hasn't left the pipeline yet, so isn't included.
+	FrameTelemetry& telemetry = m_pipeline.GetTelemetry();
+	FrameTelemetryStats stats = telemetry.GetStats();
+	std::printf("Last %d frames: %.2f ms average latency, %lld frames dropped under load\n", (int)stats.m_numFrames, stats.m_averageLatencyMS,
+		(long long)m_pipeline.GetNumDroppedFrames());
+	for (int stage = 0; stage < (int)stats.m_stages.size(); stage++)
+	{
+		const FrameStageStats& stageStats = stats.m_stages[stage];
+		std::printf(" - %s%s: %.2f ms processing, %.2f ms queued, %.2f ms waiting for a thread, %.0f%% busy, %d bubbles (%.2f ms)\n",
+			stageStats.m_name, stage == stats.m_bottleneckStage ? " (bottleneck)" : "", stageStats.m_averageProcessingMS, stageStats.m_averageWaitMS,
+			stageStats.m_averageThreadWaitMS, stageStats.m_utilisation * 100.0, stageStats.m_numBubbles, stageStats.m_bubbleMS);
+	}
+	const char* csvPath = "frame_timings.csv";
+	const char* jsonPath = "frame_timings.json";
+	if (telemetry.WriteCSV(csvPath) && telemetry.WriteJSON(jsonPath))
+	{
+		std::cout << "Saved frame timings to " << csvPath << " and " << jsonPath << std::endl;
+	}
+
+	GameApp::Stop();
+}
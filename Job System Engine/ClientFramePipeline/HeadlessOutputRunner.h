@@ -0,0 +1,42 @@
+#pragma once
+#include "ClientFrameData.h"
+#include <FramePipeline/FramePipeline.h>
+#include <FramePipeline/FrameStageRunner.h>
+#include <chrono>
+#include <fstream>
+#include <string>
+
+/**
+ * Last stage when running headless, in place of OpenGLRenderRunner. Nothing is drawn.
+ * Each frame's output (the camera and what would have been drawn) can be recorded to a file, to check that runs with the same input match.
+ * After a set number of frames, prints the frame rate and where frames spent their time, writes the frame timings, and stops the app.
+ */
+class HeadlessOutputRunner : public FrameStageRunner<ClientFrameData>
+{
+public:
+	/** numFrames is the number of frames to run, or 0 to run until stopped. recordPath may be empty to record nothing. */
+	HeadlessOutputRunner(FramePipeline<ClientFrameData>& pipeline, int64_t numFrames, const std::string& recordPath)
+		: FrameStageRunner("Output")
+		, m_pipeline(pipeline)
+		, m_numFrames(numFrames)
+		, m_recordPath(recordPath)
+	{ }
+
+	virtual void Init() override;
+protected:
+	virtual void RunJobInner(FrameData<ClientFrameData>& frame) override;
+
+private:
+	/** Prints how the run went, writes the frame timings, and stops the app */
+	void FinishRun();
+
+private:
+	/** The pipeline this stage is in, for its frame timings */
+	FramePipeline<ClientFrameData>& m_pipeline;
+	int64_t m_numFrames;
+	std::string m_recordPath;
+	std::ofstream m_recordFile;
+	int64_t m_framesCompleted = 0;
+	/** When the first frame entered the pipeline */
+	std::chrono::high_resolution_clock::time_point m_firstFrameBeginTime;
+};
@@ -46,11 +46,12 @@ void OpenGLRenderRunner::Init()
 	std::cout << "OpenGL: " << glGetString(GL_VERSION) << std::endl;
 }
 
-void OpenGLRenderRunner::RunJobInner()
+void OpenGLRenderRunner::RunJobInner(FrameData<ClientFrameData>& frame)
 {
-	ClientFrameData& frameData = *m_frameData->GetData();
+	ClientFrameData& frameData = *frame.GetData();
 	// Debug: Make sure frames are running in the correct order
-	ASSERT(frameData.m_frameNumber == m_framesCompleted);
+	ASSERT(frameData.m_frameNumber > m_lastFrameNumber);
+	m_lastFrameNumber = frameData.m_frameNumber;
 	frameData.m_stage = FrameStage::GPU_EXECUTION;
 
 	// Make sure rendering all happens on the main thread (we can do things like visibility and occlusion on this thread though!
@@ -168,5 +169,4 @@ DEFINE_CLASS_JOB(OpenGLRenderRunner, MainThreadTasks)
 	{
 		std::printf("Completed frame %I64d \n", frameData.m_frameNumber);
 	}
-	m_framesCompleted++;
 }
\ No newline at end of file
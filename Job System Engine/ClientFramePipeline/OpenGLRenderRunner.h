@@ -7,17 +7,18 @@
 class OpenGLRenderRunner : public FrameStageRunner<ClientFrameData>
 {
 public:
-	OpenGLRenderRunner() : FrameStageRunner("GPU Execution") { }
+	OpenGLRenderRunner() : FrameStageRunner("GPU Execution") { SetSkippable(true); }
 
 	virtual void Init() override;
 protected:
-	virtual void RunJobInner() override;
+	virtual void RunJobInner(FrameData<ClientFrameData>& frame) override;
 
 private:
 	DECLARE_CLASS_JOB(OpenGLRenderRunner, MainThreadTasks);
 
 private:
-	int m_framesCompleted = 0;
+	/** Number of the last frame drawn. Frames dropped under load skip this stage, so there may be gaps. */
+	int64_t m_lastFrameNumber = -1;
 	ShaderProgram m_solidColourShader;
 };
 
@@ -3,7 +3,10 @@
 #include "ClientFramePipeline/OpenGLRenderRunner.h"
 #include "ClientFramePipeline/GameLogicRunner.h"
 #include "ClientFramePipeline/FrameStartRunner.h"
+#include "ClientFramePipeline/HeadlessFrameStartRunner.h"
+#include "ClientFramePipeline/HeadlessOutputRunner.h"
 #include <GLFW/glfw3.h>
+#include <Jobs/IOService.h>
 #include <Jobs/Jobs.h>
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
@@ -19,34 +22,83 @@
 
 void GameApp::Start()
 {
-	JobCounterPtr initCounter = Jobs::GetNewJobCounter();
-	Jobs::CreateJobAndCount(GameApp::Init, this, JOBFLAG_MAINTHREAD, initCounter);
-	// Run the main loop once all init jobs are completed
-	Jobs::CreateJobWithDependency(GameApp::StartMainLoop, this, JOBFLAG_MAINTHREAD, initCounter);
+	Jobs::CreateJob(GameApp::Init, this, JOBFLAG_MAINTHREAD);
+}
+
+void GameApp::Stop()
+{
+	// Reads finishing after the job system stops would post their continuations to it, so they're finished first
+	IOService::Shutdown();
+	Jobs::Stop();
 }
 
 DEFINE_CLASS_JOB(GameApp, Init)
+{
+	if (m_settings.m_headless)
+	{
+		InitHeadless();
+	}
+	else
+	{
+		InitWindowed();
+	}
+	// Run the main loop once every start-up task has finished
+	m_initGraph.Start(GameApp::StartMainLoop, this, JOBFLAG_MAINTHREAD);
+}
+
+void GameApp::InitWindowed()
 {
 	std::cout << "Initialising window" << std::endl;
 
+	m_stages.emplace_back(std::make_unique<FrameStartRunner>(m_pipeline));
+	m_stages.emplace_back(std::make_unique<GameLogicRunner>());
+	m_stages.emplace_back(std::make_unique<OpenGLRenderRunner>());
+	FrameStageRunner<ClientFrameData>* gameLogic = m_stages[1].get();
+	FrameStageRunner<ClientFrameData>* renderer = m_stages[2].get();
+
+	// Anything touching the window or the GL context stays on the main thread, while the scene is set up on the others
+	int windowTask = m_initGraph.AddTask("Window", [this]()
+		{
+			if (!InitWindow())
+			{
+				m_initGraph.Cancel();
+				GameApp::Stop();
+			}
+		}, {}, JOBFLAG_MAINTHREAD);
+	int imguiTask = m_initGraph.AddTask("ImGui", [this]() { InitImGui(); }, { windowTask }, JOBFLAG_MAINTHREAD);
+	int rendererTask = m_initGraph.AddTask("Renderer", [renderer]() { renderer->InitStage(); }, { windowTask }, JOBFLAG_MAINTHREAD);
+	int sceneTask = m_initGraph.AddTask("Scene", [gameLogic]() { gameLogic->InitStage(); });
+	m_initGraph.AddTask("Pipeline", [this]()
+		{
+			InitPipeline();
+
+			// If rendering falls behind, only draw the newest frame rather than letting frames queue up for it.
+			// Headless runs leave this off, so every frame is recorded the same way whatever the load.
+			FrameOverloadPolicy overloadPolicy;
+			overloadPolicy.m_enabled = true;
+			overloadPolicy.m_maxQueuedFrames = 0;
+			overloadPolicy.m_maxFrameAge = std::chrono::milliseconds(100);
+			m_pipeline.SetOverloadPolicy(overloadPolicy);
+		}, { windowTask, imguiTask, rendererTask, sceneTask });
+}
+
+bool GameApp::InitWindow()
+{
 	// Init GLFW and window
 	if (glfwInit() == GLFW_FALSE)
 	{
-		Jobs::Stop();
 		std::cout << "Error initialising GLFW" << std::endl;
-		return;
+		return false;
 	}
 	// GL 3.0 + GLSL 130
-	const char* glsl_version = "#version 130";
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
 
 	m_window = glfwCreateWindow(800, 600, "Engine", nullptr, nullptr);
 	if (m_window == nullptr)
 	{
-		Jobs::Stop();
 		std::cout << "Error creating window" << std::endl;
-		return;
+		return false;
 	}
 	glfwMakeContextCurrent(m_window);
 	glfwSwapInterval(0); //Disables vsync
@@ -69,24 +121,77 @@ DEFINE_CLASS_JOB(GameApp, Init)
 			GameApp* thisApp = (GameApp*)glfwGetWindowUserPointer(window);
 			thisApp->InputMousePosListener(window, xpos, ypos);
 		});
+	return true;
+}
 
-	// Init ImGui
+void GameApp::InitImGui()
+{
 	// Note: ImGui is not thread-safe, and as it has a single global state only one frame and one thread should do anything with it at one time.
 	// To do this, we will need to use a wrapper within ClientFrameData to collect imgui calls throughout a frame.
 	// At the end of the frame, we will then forward all inputs from our input state to it, execute the collected calls, and render it all in the Render stage.
+	const char* glsl_version = "#version 130";
 	IMGUI_CHECKVERSION();
 	ImGui::CreateContext();
 	ImGui::StyleColorsDark();
 	ImGui_ImplGlfw_InitForOpenGL(m_window, false);
 	ImGui_ImplOpenGL3_Init(glsl_version);
+}
 
-	// Initialise frame pipeline
+void GameApp::InitHeadless()
+{
+	std::cout << "Running headless" << std::endl;
+
+	// The real game logic, between stages that stand in for the window and the GPU
+	// One simulation step per frame, so scripted runs are reproducible
+	m_stages.emplace_back(std::make_unique<HeadlessFrameStartRunner>(m_settings.m_inputScriptPath.empty() ? nullptr : &m_inputScript,
+		GameLogicRunner::SIMULATION_STEP_TIME));
+	m_stages.emplace_back(std::make_unique<GameLogicRunner>());
+	m_stages.emplace_back(std::make_unique<HeadlessOutputRunner>(m_pipeline, m_settings.m_numFrames, m_settings.m_recordPath));
+	FrameStageRunner<ClientFrameData>* gameLogic = m_stages[1].get();
+	FrameStageRunner<ClientFrameData>* output = m_stages[2].get();
+
+	std::vector<int> pipelineDependencies;
+	if (!m_settings.m_inputScriptPath.empty())
+	{
+		pipelineDependencies.push_back(m_initGraph.AddTask("Input script", [this]()
+			{
+				if (!m_inputScript.Load(m_settings.m_inputScriptPath))
+				{
+					m_initGraph.Cancel();
+					GameApp::Stop();
+					std::cout << "Error loading input script " << m_settings.m_inputScriptPath << std::endl;
+					return;
+				}
+				std::cout << "Loaded " << m_inputScript.GetNumEvents() << " input events" << std::endl;
+			}));
+	}
+	pipelineDependencies.push_back(m_initGraph.AddTask("Scene", [gameLogic]() { gameLogic->InitStage(); }));
+	pipelineDependencies.push_back(m_initGraph.AddTask("Output", [output]() { output->InitStage(); }));
+	m_initGraph.AddTask("Pipeline", [this]() { InitPipeline(); }, pipelineDependencies);
+}
+
+void GameApp::InitPipeline()
+{
+	// Initialise frame pipeline, with up to NUM_SIMULTANEOUS_FRAMES in flight depending on how long each stage takes
 	constexpr int NUM_SIMULTANEOUS_FRAMES = 4;
-	std::vector<std::unique_ptr<FrameStageRunner<ClientFrameData>>> stages;
-	stages.emplace_back(std::make_unique<FrameStartRunner>());
-	stages.emplace_back(std::make_unique<GameLogicRunner>());
-	stages.emplace_back(std::make_unique<OpenGLRenderRunner>());
-	m_pipeline.Init(std::move(stages), NUM_SIMULTANEOUS_FRAMES, ClientFrameData(m_window, m_input));
+	FramesInFlightPolicy framesInFlightPolicy;
+	framesInFlightPolicy.m_enabled = true;
+	framesInFlightPolicy.m_targetLatency = std::chrono::milliseconds(50);
+	m_pipeline.SetFramesInFlightPolicy(framesInFlightPolicy);
+	m_pipeline.SetFirstFrameEndedCallback([this]() { FirstFrameEnded(); });
+	// Enough for every frame's list of models to render, so the arena doesn't need to grow
+	constexpr size_t FRAME_ARENA_SIZE = 32 * 1024 * 1024;
+	m_pipeline.Init(std::move(m_stages), NUM_SIMULTANEOUS_FRAMES, ClientFrameData(m_window, m_input), FRAME_ARENA_SIZE);
+}
+
+void GameApp::FirstFrameEnded()
+{
+	m_initGraph.Mark("First frame");
+	m_initGraph.PrintTimeline(std::cout);
+	if (m_initGraph.WriteTimelineJSON(STARTUP_TIMELINE_PATH))
+	{
+		std::cout << "Saved start-up timeline to " << STARTUP_TIMELINE_PATH << std::endl;
+	}
 }
 
 DEFINE_CLASS_JOB(GameApp, StartMainLoop)
@@ -1,17 +1,36 @@
 #pragma once
 #include <GL/glew.h>
 #include <FramePipeline/FramePipeline.h>
+#include <Jobs/InitGraph.h>
 #include <Jobs/JobDecl.h>
 #include "ClientFramePipeline/ClientFrameData.h"
 #include <Input/Input.h>
+#include <Input/InputScript.h>
+#include <string>
+
+/** How the app runs, set from the command line */
+struct GameAppSettings
+{
+	/** Run without a window or GPU, with input from a script, as fast as frames can be simulated */
+	bool m_headless = false;
+	/** Headless only: number of frames to run before exiting, or 0 to run until stopped */
+	int64_t m_numFrames = 0;
+	/** Headless only: file of input events to replay (see InputScript), or empty for no input */
+	std::string m_inputScriptPath;
+	/** Headless only: file to record each frame's output to, or empty to record nothing */
+	std::string m_recordPath;
+};
 
 class GameApp
 {
 public:
+	GameApp(const GameAppSettings& settings) : m_settings(settings) { }
 
 	void Start();
 
 	static void StartNewFrame();
+	/** Stops the app: finishes any file reads, then stops the job system. May be called from any job. */
+	static void Stop();
 
 	/** Forwarders for GLFW callback functions */
 	void InputKeyListener(GLFWwindow* window, int key, int scancode, int action, int mods) { m_input.KeyListener(window, key, scancode, action, mods); }
@@ -20,16 +39,39 @@ public:
 
 private:
 	// Jobs
-	// Initialise systems
+	// Initialise systems, by starting the init graph
 	DECLARE_CLASS_JOB(GameApp, Init);
-	// Start processing frames
+	// Start processing frames, once the init graph has finished
 	DECLARE_CLASS_JOB(GameApp, StartMainLoop);
 
+	/** Adds the tasks to start up with a window to the init graph */
+	void InitWindowed();
+	/** Adds the tasks to simulate frames without a window to the init graph, replacing the first and last stages */
+	void InitHeadless();
+	/** Creates the window and sets up its input callbacks. Returns false if it couldn't be created. */
+	bool InitWindow();
+	void InitImGui();
+	/** Initialises the pipeline with m_stages */
+	void InitPipeline();
+	/** Records the time to the first frame on the start-up timeline, and saves the timeline */
+	void FirstFrameEnded();
+
+private:
+	/** Where the start-up timeline is saved once the first frame has been shown */
+	static constexpr const char* STARTUP_TIMELINE_PATH = "startup_timeline.json";
+
 private:
+	GameAppSettings m_settings;
 	Input m_input;
+	/** Headless only: input events replayed in place of the window's */
+	InputScript m_inputScript;
 	FramePipeline<ClientFrameData> m_pipeline;
+	/** Stages waiting to be given to the pipeline, once the init graph has initialised them */
+	std::vector<std::unique_ptr<FrameStageRunner<ClientFrameData>>> m_stages;
+	/** Start-up tasks, and when they ran */
+	InitGraph m_initGraph;
 
 	// TODO: Singleton
-	GLFWwindow* m_window;
+	GLFWwindow* m_window = nullptr;
 };
 
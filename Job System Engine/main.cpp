@@ -1,5 +1,9 @@
+#include <Jobs/IOService.h>
 #include <Jobs/Jobs.h>
 #include "GameApp.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
 
 /*
 1. Initialise:
@@ -18,9 +22,60 @@ JOB_FUNCTION_START(StartApp, GameApp, app)
 }
 JOB_FUNCTION_END()
 
-int main()
+/**
+ * Usage: "Job System Engine" [--headless] [--frames N] [--input path] [--record path]
+ * --headless runs the game logic without a window or GPU, as fast as it can. The other options only apply when headless:
+ * --frames stops after N frames, --input replays input events from a file (see InputScript), and --record writes each frame's output to a file.
+ */
+bool ParseSettings(int argc, char** argv, GameAppSettings& settingsOut)
 {
-	GameApp app;
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (std::strcmp(argv[i], "--headless") == 0)
+		{
+			settingsOut.m_headless = true;
+		}
+		else if (std::strcmp(argv[i], "--frames") == 0 && hasValue)
+		{
+			settingsOut.m_numFrames = std::atoll(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--input") == 0 && hasValue)
+		{
+			settingsOut.m_inputScriptPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--record") == 0 && hasValue)
+		{
+			settingsOut.m_recordPath = argv[++i];
+		}
+		else
+		{
+			std::cout << "Unknown option " << argv[i] << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	GameAppSettings settings;
+	if (!ParseSettings(argc, argv, settings))
+	{
+		std::cout << "Usage: [--headless] [--frames N] [--input path] [--record path]" << std::endl;
+		return 1;
+	}
+	GameApp app(settings);
+
+	// Scale the number of active threads with load, so idle periods (e.g. menus) give cores back to the system
+	ElasticThreadPolicy elasticPolicy;
+	elasticPolicy.m_enabled = true;
+	elasticPolicy.m_minThreads = 2;
+	Jobs::SetElasticPolicy(elasticPolicy);
+
+	// File reads block, so they run on their own threads rather than occupying job threads. GameApp::Stop() shuts them down.
+	IOService::Init(2);
+
 	Jobs jobs(4, StartApp, &app);
 
 	return 0;
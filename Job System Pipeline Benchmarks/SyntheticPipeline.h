@@ -0,0 +1,162 @@
+#pragma once
+#include <FramePipeline/FramePipeline.h>
+#include <Jobs/Jobs.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+/** How the time a synthetic stage takes is spread from frame to frame */
+enum class StageCostDistribution : uint8_t
+{
+	/** Always the mean */
+	CONSTANT,
+	/** Anywhere between mean - spread and mean + spread */
+	UNIFORM,
+	/** Usually shorter than the mean, with a long tail of slow frames */
+	EXPONENTIAL,
+};
+
+/** Settings for one synthetic stage */
+struct SyntheticStageConfig
+{
+	const char* m_name = "";
+	StageCostDistribution m_distribution = StageCostDistribution::CONSTANT;
+	/** Average time the stage's work takes per frame, in microseconds */
+	double m_meanUS = 0.0;
+	/** How far either side of the mean a UNIFORM stage's time may be, in microseconds */
+	double m_spreadUS = 0.0;
+	/** Number of jobs the stage's work is split between. 1 runs the work in the stage's own job. */
+	int m_fanOut = 1;
+	/** Whether the work must run on the main thread, like rendering. Main-thread work isn't split, so m_fanOut must be 1. */
+	bool m_mainThread = false;
+};
+
+/** A pipeline of synthetic stages */
+struct SyntheticPipelineConfig
+{
+	std::string m_name;
+	std::vector<SyntheticStageConfig> m_stages;
+	/** Links between the stages, as for FramePipeline::Init(). If empty, each stage is linked to the next. */
+	std::vector<FrameStageLink> m_links;
+};
+
+/** Frame data for synthetic pipelines. Nothing is stored in it, as the stages only spend time. */
+struct SyntheticFrameData
+{
+};
+
+/** Busy-waits, so work takes a known time without giving its thread back to the OS */
+inline void SpinFor(long long durationNS)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	while (std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count() < durationNS)
+	{
+		_YIELD_PROCESSOR();
+	}
+}
+
+/**
+ * SyntheticStage
+ * A pipeline stage that spends a time drawn from its cost distribution on each frame, split between m_fanOut jobs or run on the main
+ * thread, so the pipeline's own overheads can be measured without any game code.
+ * The first stage of a pipeline also calls Jobs::Stop() once the given frame number is reached, which ends the run.
+ */
+class SyntheticStage : public FrameStageRunner<SyntheticFrameData>
+{
+public:
+	SyntheticStage(const SyntheticStageConfig& config, unsigned int seed, int64_t stopFrameNumber)
+		: FrameStageRunner(config.m_name)
+		, m_config(config)
+		, m_random(seed)
+		, m_stopFrameNumber(stopFrameNumber)
+	{
+		ASSERT(config.m_fanOut >= 1);
+		ASSERT(!config.m_mainThread || config.m_fanOut == 1);
+	}
+
+protected:
+	void RunJobInner(FrameData<SyntheticFrameData>& frame) override
+	{
+		if (m_stopFrameNumber >= 0 && frame.m_frameNumber >= m_stopFrameNumber)
+		{
+			// Frames still in flight are abandoned
+			if (frame.m_frameNumber == m_stopFrameNumber)
+			{
+				Jobs::Stop();
+			}
+			return;
+		}
+
+		// Stages are serial, so the generator is only used by one frame at a time
+		m_workNS = (long long)(SampleCostUS() * 1000.0) / m_config.m_fanOut;
+		if (m_workNS <= 0)
+		{
+			return;
+		}
+		if (m_config.m_mainThread)
+		{
+			Jobs::CreateJob(WorkJob, this, JOBFLAG_MAINTHREAD | JOBFLAG_ISCHILD);
+			return;
+		}
+		for (int i = 1; i < m_config.m_fanOut; i++)
+		{
+			Jobs::CreateJob(WorkJob, this, JOBFLAG_ISCHILD);
+		}
+		SpinFor(m_workNS);
+	}
+
+private:
+	static void WorkJob(void* data)
+	{
+		SyntheticStage& stage = *static_cast<SyntheticStage*>(data);
+		SpinFor(stage.m_workNS);
+	}
+
+	/** Returns this frame's cost, in microseconds */
+	double SampleCostUS()
+	{
+		switch (m_config.m_distribution)
+		{
+		case StageCostDistribution::UNIFORM:
+			return std::uniform_real_distribution<double>(std::max(m_config.m_meanUS - m_config.m_spreadUS, 0.0),
+				m_config.m_meanUS + m_config.m_spreadUS)(m_random);
+		case StageCostDistribution::EXPONENTIAL:
+			return m_config.m_meanUS > 0.0 ? std::exponential_distribution<double>(1.0 / m_config.m_meanUS)(m_random) : 0.0;
+		default:
+			return m_config.m_meanUS;
+		}
+	}
+
+	const SyntheticStageConfig m_config;
+	std::mt19937 m_random;
+	/** Frame number at which the run ends, or -1 for stages that don't end it */
+	const int64_t m_stopFrameNumber;
+	/** Time each of this frame's jobs spins for */
+	long long m_workNS = 0;
+};
+
+/** Builds a FramePipeline of synthetic stages, whose first stage stops the job system when stopFrameNumber is reached */
+inline void InitSyntheticPipeline(FramePipeline<SyntheticFrameData>& pipeline, const SyntheticPipelineConfig& config, int numFramesInFlight,
+	int64_t stopFrameNumber)
+{
+	ASSERT(!config.m_stages.empty());
+	std::vector<std::unique_ptr<FrameStageRunner<SyntheticFrameData>>> stages;
+	for (size_t i = 0; i < config.m_stages.size(); i++)
+	{
+		// Fixed seeds, so every run of a scenario sees the same costs
+		stages.push_back(std::make_unique<SyntheticStage>(config.m_stages[i], (unsigned int)(i + 1), i == 0 ? stopFrameNumber : -1));
+	}
+
+	std::vector<FrameStageLink> links = config.m_links;
+	if (links.empty())
+	{
+		for (int i = 0; i + 1 < (int)config.m_stages.size(); i++)
+		{
+			links.push_back({ i, i + 1 });
+		}
+	}
+	pipeline.Init(std::move(stages), links, numFramesInFlight, SyntheticFrameData(), 1024);
+}
@@ -0,0 +1,261 @@
+#include <FramePipeline/FramePipeline.h>
+#include <Jobs/Jobs.h>
+#include "SyntheticPipeline.h"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+/**
+ * Frame pipeline benchmarks
+ * Pushes frames through pipelines of synthetic stages, which only spend time, so the cost of the FramePipeline and FrameStageRunner
+ * machinery can be measured apart from game code. Each scenario is run at 1 to MAX_FRAMES_IN_FLIGHT frames in flight and at thread
+ * counts from 1 up to every hardware thread, and the frame rate, latency percentiles and handoff overhead are written to a JSON file.
+ * Usage: "Job System Pipeline Benchmarks" [output path, default pipeline_benchmark_results.json] [max threads, default all hardware threads]
+ */
+
+constexpr int MAX_FRAMES_IN_FLIGHT = 4;
+/** Frames left out at the start of each run, while the pipeline fills up */
+constexpr int64_t WARMUP_FRAMES = 40;
+/** Frames measured in each run. Must fit in the telemetry's history, with room for the frames in flight after them. */
+constexpr int64_t MEASURED_FRAMES = 200;
+static_assert(MEASURED_FRAMES + MAX_FRAMES_IN_FLIGHT < FrameTelemetry::DEFAULT_HISTORY_SIZE, "Measured frames must fit in the telemetry history");
+
+/** Measurements of one scenario at one thread count and number of frames in flight */
+struct PipelineBenchmarkResult
+{
+	std::string m_name;
+	int m_numThreads = 0;
+	int m_numFramesInFlight = 0;
+	size_t m_numFrames = 0;
+	double m_framesPerSecond = 0.0;
+	/** Time from frames entering the first stage to leaving the last, sorted */
+	std::vector<double> m_latenciesMS;
+	/** Time spent on each frame's work, summed over the stages */
+	double m_averageWorkMS = 0.0;
+	/**
+	 * Time from a stage finishing a frame to the next stage starting to run it, not counting the time it waited for the next stage to
+	 * finish the frames ahead of it. That's the pipeline's own overhead: queueing the frame, creating its jobs and a thread picking them up.
+	 * When every thread is busy, it also includes waiting for one to become free.
+	 */
+	std::vector<double> m_handoffsUS;
+	/** Average time frames waited for a stage to finish the frames ahead of them, per stage */
+	double m_averageQueueWaitUS = 0.0;
+};
+
+/** Returns the given percentile of sorted samples, interpolating between the nearest two */
+static double Percentile(const std::vector<double>& sorted, double percentile)
+{
+	if (sorted.empty())
+	{
+		return 0.0;
+	}
+	double position = percentile * (sorted.size() - 1);
+	size_t lower = (size_t)position;
+	size_t upper = std::min(lower + 1, sorted.size() - 1);
+	double fraction = position - lower;
+	return sorted[lower] + (sorted[upper] - sorted[lower]) * fraction;
+}
+
+template<typename DURATION>
+static double ToUS(DURATION duration)
+{
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count() / 1000.0;
+}
+
+/** Works out a run's measurements from the timings of its measured frames */
+static void Analyse(const SyntheticPipelineConfig& config, const std::vector<FrameTimings>& allFrames, PipelineBenchmarkResult& result)
+{
+	std::vector<FrameTimings> frames;
+	for (const FrameTimings& frame : allFrames)
+	{
+		if (frame.m_frameNumber >= WARMUP_FRAMES && frame.m_frameNumber < WARMUP_FRAMES + MEASURED_FRAMES)
+		{
+			frames.push_back(frame);
+		}
+	}
+	result.m_numFrames = frames.size();
+	if (frames.size() < 2)
+	{
+		return;
+	}
+
+	// Previous stages of each stage, to find when a frame was ready for it
+	std::vector<std::vector<int>> previousStages(config.m_stages.size());
+	for (const FrameStageLink& link : config.m_links)
+	{
+		previousStages[link.m_to].push_back(link.m_from);
+	}
+	for (int i = 1; config.m_links.empty() && i < (int)config.m_stages.size(); i++)
+	{
+		previousStages[i].push_back(i - 1);
+	}
+
+	std::sort(frames.begin(), frames.end(), [](const FrameTimings& a, const FrameTimings& b)
+		{
+			return a.m_stages.back().m_finishTime < b.m_stages.back().m_finishTime;
+		});
+	double durationUS = ToUS(frames.back().m_stages.back().m_finishTime - frames.front().m_stages.back().m_finishTime);
+	result.m_framesPerSecond = durationUS > 0.0 ? (double)(frames.size() - 1) * 1000000.0 / durationUS : 0.0;
+
+	double totalWorkUS = 0.0;
+	double totalQueueWaitUS = 0.0;
+	size_t numStageVisits = 0;
+	for (const FrameTimings& frame : frames)
+	{
+		result.m_latenciesMS.push_back(ToUS(frame.m_stages.back().m_finishTime - frame.m_stages.front().m_queuedTime) / 1000.0);
+		for (size_t stage = 0; stage < frame.m_stages.size(); stage++)
+		{
+			const FrameStageTiming& timing = frame.m_stages[stage];
+			totalWorkUS += ToUS(timing.m_finishTime - timing.m_runTime);
+			totalQueueWaitUS += ToUS(timing.m_startTime - timing.m_queuedTime);
+			numStageVisits++;
+			if (previousStages[stage].empty())
+			{
+				continue;
+			}
+			auto readyTime = frame.m_stages[previousStages[stage].front()].m_finishTime;
+			for (int previousStage : previousStages[stage])
+			{
+				readyTime = std::max(readyTime, frame.m_stages[previousStage].m_finishTime);
+			}
+			result.m_handoffsUS.push_back(ToUS(timing.m_queuedTime - readyTime) + ToUS(timing.m_runTime - timing.m_startTime));
+		}
+	}
+	std::sort(result.m_latenciesMS.begin(), result.m_latenciesMS.end());
+	std::sort(result.m_handoffsUS.begin(), result.m_handoffsUS.end());
+	result.m_averageWorkMS = totalWorkUS / 1000.0 / (double)frames.size();
+	result.m_averageQueueWaitUS = totalQueueWaitUS / (double)numStageVisits;
+}
+
+/** Main job of each run. It returns once the frames are started, so the main thread is free for main-thread stages. */
+void StartPipelineJob(void* data)
+{
+	static_cast<FramePipeline<SyntheticFrameData>*>(data)->Start();
+}
+
+/** Runs a scenario in its own job system until the measured frames have left the pipeline */
+static PipelineBenchmarkResult RunScenario(const SyntheticPipelineConfig& config, int numThreads, int numFramesInFlight)
+{
+	// Frame k + numFramesInFlight can't start until frame k has left the pipeline, so this is only reached once every measured frame has
+	FramePipeline<SyntheticFrameData> pipeline;
+	InitSyntheticPipeline(pipeline, config, numFramesInFlight, WARMUP_FRAMES + MEASURED_FRAMES + numFramesInFlight);
+	{
+		Jobs jobs(numThreads, StartPipelineJob, &pipeline);
+	}
+
+	PipelineBenchmarkResult result;
+	result.m_name = config.m_name;
+	result.m_numThreads = numThreads;
+	result.m_numFramesInFlight = numFramesInFlight;
+	Analyse(config, pipeline.GetTelemetry().GetFrames(), result);
+	return result;
+}
+
+/** Pipelines to measure, from pure overhead to something shaped like a game */
+static std::vector<SyntheticPipelineConfig> MakeScenarios()
+{
+	std::vector<SyntheticPipelineConfig> scenarios;
+
+	// Stages that do nothing, so every frame is only handoffs
+	scenarios.push_back({ "empty", {
+		{ "Stage 0" }, { "Stage 1" }, { "Stage 2" }, { "Stage 3" } } });
+
+	// Equal stages, which can all be kept busy with enough frames in flight
+	scenarios.push_back({ "balanced", {
+		{ "Stage 0", StageCostDistribution::CONSTANT, 500.0 },
+		{ "Stage 1", StageCostDistribution::CONSTANT, 500.0 },
+		{ "Stage 2", StageCostDistribution::CONSTANT, 500.0 },
+		{ "Stage 3", StageCostDistribution::CONSTANT, 500.0 } } });
+
+	// Stages whose times vary a lot, so frames bunch up behind slow ones
+	scenarios.push_back({ "spiky", {
+		{ "Stage 0", StageCostDistribution::EXPONENTIAL, 300.0 },
+		{ "Stage 1", StageCostDistribution::EXPONENTIAL, 600.0, 0.0, 2 },
+		{ "Stage 2", StageCostDistribution::EXPONENTIAL, 300.0 },
+		{ "Stage 3", StageCostDistribution::EXPONENTIAL, 600.0 } } });
+
+	// Like the engine: the frame starts and is drawn on the main thread, and the work in between is split across jobs
+	scenarios.push_back({ "game_like", {
+		{ "Frame start", StageCostDistribution::CONSTANT, 100.0, 0.0, 1, true },
+		{ "Game logic", StageCostDistribution::UNIFORM, 1200.0, 400.0, 4 },
+		{ "Render extraction", StageCostDistribution::UNIFORM, 400.0, 100.0, 2 },
+		{ "Render", StageCostDistribution::UNIFORM, 800.0, 200.0, 1, true } } });
+
+	// Two stages working on the same frame side by side, then joining
+	scenarios.push_back({ "branching", {
+		{ "Frame start", StageCostDistribution::CONSTANT, 100.0 },
+		{ "Simulation", StageCostDistribution::UNIFORM, 800.0, 200.0, 2 },
+		{ "Audio", StageCostDistribution::UNIFORM, 400.0, 100.0 },
+		{ "Present", StageCostDistribution::CONSTANT, 300.0 } },
+		{ { 0, 1 }, { 0, 2 }, { 1, 3 }, { 2, 3 } } });
+
+	return scenarios;
+}
+
+/** Writes every result as JSON, so runs can be compared across commits */
+static void WriteJson(std::ostream& out, int hardwareThreads, const std::vector<PipelineBenchmarkResult>& results)
+{
+	out << "{\n";
+	out << "\t\"hardwareThreads\": " << hardwareThreads << ",\n";
+	out << "\t\"measuredFrames\": " << MEASURED_FRAMES << ",\n";
+	out << "\t\"results\": [\n";
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const PipelineBenchmarkResult& result = results[i];
+		out << "\t\t{ \"benchmark\": \"" << result.m_name << "\"";
+		out << ", \"threads\": " << result.m_numThreads;
+		out << ", \"framesInFlight\": " << result.m_numFramesInFlight;
+		out << ", \"frames\": " << result.m_numFrames;
+		out << ", \"framesPerSecond\": " << result.m_framesPerSecond;
+		out << ", \"latencyP50MS\": " << Percentile(result.m_latenciesMS, 0.50);
+		out << ", \"latencyP90MS\": " << Percentile(result.m_latenciesMS, 0.90);
+		out << ", \"latencyP99MS\": " << Percentile(result.m_latenciesMS, 0.99);
+		out << ", \"latencyMaxMS\": " << (result.m_latenciesMS.empty() ? 0.0 : result.m_latenciesMS.back());
+		out << ", \"averageWorkMS\": " << result.m_averageWorkMS;
+		out << ", \"handoffP50US\": " << Percentile(result.m_handoffsUS, 0.50);
+		out << ", \"handoffP99US\": " << Percentile(result.m_handoffsUS, 0.99);
+		out << ", \"averageQueueWaitUS\": " << result.m_averageQueueWaitUS;
+		out << " }" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	out << "\t]\n";
+	out << "}\n";
+}
+
+int main(int argc, char** argv)
+{
+	const char* outputPath = argc > 1 ? argv[1] : "pipeline_benchmark_results.json";
+	int hardwareThreads = std::max(1, (int)std::thread::hardware_concurrency());
+	int maxThreads = argc > 2 ? std::max(1, std::atoi(argv[2])) : hardwareThreads;
+
+	// Powers of two up to the maximum
+	std::vector<int> threadCounts;
+	for (int numThreads = 1; numThreads < maxThreads; numThreads *= 2)
+	{
+		threadCounts.push_back(numThreads);
+	}
+	threadCounts.push_back(maxThreads);
+
+	std::vector<PipelineBenchmarkResult> results;
+	for (const SyntheticPipelineConfig& scenario : MakeScenarios())
+	{
+		std::cout << "Running " << scenario.m_name << std::endl;
+		for (int numThreads : threadCounts)
+		{
+			for (int numFramesInFlight = 1; numFramesInFlight <= MAX_FRAMES_IN_FLIGHT; numFramesInFlight++)
+			{
+				results.push_back(RunScenario(scenario, numThreads, numFramesInFlight));
+				const PipelineBenchmarkResult& result = results.back();
+				std::cout << "  " << numThreads << " threads, " << numFramesInFlight << " frames: " << result.m_framesPerSecond << " fps, latency p50 "
+					<< Percentile(result.m_latenciesMS, 0.50) << " ms, p99 " << Percentile(result.m_latenciesMS, 0.99) << " ms, handoff p50 "
+					<< Percentile(result.m_handoffsUS, 0.50) << " us" << std::endl;
+			}
+		}
+	}
+
+	std::ofstream file(outputPath);
+	WriteJson(file, hardwareThreads, results);
+	std::cout << "Results written to " << outputPath << std::endl;
+	return 0;
+}
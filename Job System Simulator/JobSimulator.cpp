@@ -0,0 +1,335 @@
+#include "JobSimulator.h"
+#include <Jobs/Job.h>
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <queue>
+#include <random>
+#include <unordered_map>
+
+JobSimulator::JobSimulator(const JobRecording& recording)
+{
+	std::unordered_map<uint32_t, int> jobIndices;
+	std::unordered_map<uint32_t, int> counterIndices;
+	auto getCounter = [&](uint32_t counterId)
+		{
+			if (counterId == 0)
+			{
+				return -1;
+			}
+			auto found = counterIndices.find(counterId);
+			if (found != counterIndices.end())
+			{
+				return found->second;
+			}
+			int index = (int)m_counters.size();
+			m_counters.emplace_back();
+			counterIndices[counterId] = index;
+			return index;
+		};
+
+	m_nodes.resize(recording.m_jobs.size());
+	for (size_t i = 0; i < recording.m_jobs.size(); i++)
+	{
+		const JobRecord& record = recording.m_jobs[i];
+		jobIndices[record.m_id] = (int)i;
+		m_nodes[i].m_func = record.m_func;
+		m_nodes[i].m_flags = record.m_flags;
+		m_nodes[i].m_durationNS = std::max<int64_t>(record.m_exclusiveNS, 0);
+		m_nodes[i].m_recordedThread = record.m_thread;
+		m_totalWorkNS += m_nodes[i].m_durationNS;
+	}
+
+	for (size_t i = 0; i < recording.m_jobs.size(); i++)
+	{
+		const JobRecord& record = recording.m_jobs[i];
+		Node& node = m_nodes[i];
+
+		auto creator = jobIndices.find(record.m_creatorId);
+		if (record.m_creatorId != 0 && creator != jobIndices.end())
+		{
+			// The creator may have run nested jobs before creating this one, so clamp to the creator's own run time
+			const JobRecord& creatorRecord = recording.m_jobs[creator->second];
+			node.m_creator = creator->second;
+			node.m_createOffsetNS = std::clamp<int64_t>(record.m_createNS - creatorRecord.m_startNS, 0, m_nodes[creator->second].m_durationNS);
+			m_nodes[creator->second].m_created.push_back((int)i);
+		}
+		else
+		{
+			// Created by something that wasn't recorded, so release it when it was really created
+			node.m_createOffsetNS = std::max<int64_t>(record.m_createNS, 0);
+		}
+
+		auto parent = jobIndices.find(record.m_parentId);
+		if (record.m_parentId != 0 && parent != jobIndices.end())
+		{
+			node.m_parent = parent->second;
+			m_nodes[parent->second].m_numChildren++;
+		}
+
+		node.m_decCounter = getCounter(record.m_decCounterId);
+		if (node.m_decCounter >= 0)
+		{
+			m_counters[node.m_decCounter].m_numJobs++;
+		}
+		node.m_waitCounter = getCounter(record.m_waitCounterId);
+		if (node.m_waitCounter >= 0)
+		{
+			m_counters[node.m_waitCounter].m_waiters.push_back((int)i);
+		}
+	}
+
+	for (const JobJoinRecord& join : recording.m_joins)
+	{
+		auto job = jobIndices.find(join.m_jobId);
+		int counter = getCounter(join.m_counterId);
+		if (job != jobIndices.end() && counter >= 0)
+		{
+			m_nodes[job->second].m_joinedCounters.push_back(counter);
+			m_counters[counter].m_joiners.push_back(job->second);
+		}
+	}
+}
+
+SimulationResult JobSimulator::Run(const SimulationSettings& settings) const
+{
+	enum EventType { EVENT_CREATED, EVENT_FINISHED };
+	struct Event
+	{
+		int64_t m_timeNS;
+		uint64_t m_order;
+		EventType m_type;
+		int m_node;
+		int m_worker;
+		bool operator>(const Event& other) const { return m_timeNS != other.m_timeNS ? m_timeNS > other.m_timeNS : m_order > other.m_order; }
+	};
+	/** A job starting or finishing, for building the parallelism profile */
+	struct RunMarker
+	{
+		int64_t m_timeNS;
+		int m_delta;
+		int m_node;
+	};
+
+	const int numWorkers = std::max(1, settings.m_numWorkers);
+	const size_t numNodes = m_nodes.size();
+	SimulationResult result;
+
+	std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+	uint64_t nextOrder = 0;
+	std::vector<int> unmetStartConditions(numNodes);
+	std::vector<int> pendingCompletions(numNodes);
+	std::vector<int> owners(numNodes, 0);
+	std::vector<int> counterRemaining(m_counters.size());
+	std::vector<RunMarker> runMarkers;
+	runMarkers.reserve(numNodes * 2);
+
+	// Ready queues
+	std::deque<int> mainThreadQueue;
+	std::deque<int> centralQueue;
+	std::vector<std::deque<int>> workerQueues(numWorkers);
+	std::vector<bool> workerBusy(numWorkers, false);
+	std::mt19937 random(settings.m_seed);
+
+	for (size_t i = 0; i < m_counters.size(); i++)
+	{
+		counterRemaining[i] = m_counters[i].m_numJobs;
+	}
+	for (size_t i = 0; i < numNodes; i++)
+	{
+		const Node& node = m_nodes[i];
+		bool waits = node.m_waitCounter >= 0 && m_counters[node.m_waitCounter].m_numJobs > 0;
+		unmetStartConditions[i] = 1 + (waits ? 1 : 0);
+		pendingCompletions[i] = 1 + node.m_numChildren;
+		for (int counter : node.m_joinedCounters)
+		{
+			pendingCompletions[i] += m_counters[counter].m_numJobs > 0 ? 1 : 0;
+		}
+		if (node.m_creator < 0)
+		{
+			owners[i] = node.m_recordedThread % numWorkers;
+			events.push({ node.m_createOffsetNS, nextOrder++, EVENT_CREATED, (int)i, -1 });
+		}
+	}
+
+	auto makeReady = [&](int index)
+		{
+			const Node& node = m_nodes[index];
+			if ((node.m_flags & JOBFLAG_MAINTHREAD) != 0)
+			{
+				mainThreadQueue.push_back(index);
+			}
+			else if (settings.m_policy == SchedulingPolicy::CENTRAL_QUEUE)
+			{
+				centralQueue.push_back(index);
+			}
+			else
+			{
+				workerQueues[owners[index]].push_back(index);
+			}
+		};
+
+	auto satisfyStartCondition = [&](int index)
+		{
+			if (--unmetStartConditions[index] == 0)
+			{
+				makeReady(index);
+			}
+		};
+
+	int64_t lastCompletionNS = 0;
+	std::function<void(int, int64_t)> complete = [&](int index, int64_t timeNS)
+		{
+			if (--pendingCompletions[index] > 0)
+			{
+				return;
+			}
+			lastCompletionNS = std::max(lastCompletionNS, timeNS);
+			const Node& node = m_nodes[index];
+			if (node.m_decCounter >= 0 && --counterRemaining[node.m_decCounter] == 0)
+			{
+				const Counter& counter = m_counters[node.m_decCounter];
+				for (int waiter : counter.m_waiters)
+				{
+					satisfyStartCondition(waiter);
+				}
+				for (int joiner : counter.m_joiners)
+				{
+					complete(joiner, timeNS);
+				}
+			}
+			if (node.m_parent >= 0)
+			{
+				complete(node.m_parent, timeNS);
+			}
+		};
+
+	/** Picks the next job for a worker. Returns -1 if there is nothing it can run. */
+	auto pickJob = [&](int worker, bool& stolen)
+		{
+			stolen = false;
+			if (worker == 0 && !mainThreadQueue.empty())
+			{
+				int index = mainThreadQueue.front();
+				mainThreadQueue.pop_front();
+				return index;
+			}
+			if (settings.m_policy == SchedulingPolicy::CENTRAL_QUEUE)
+			{
+				if (centralQueue.empty())
+				{
+					return -1;
+				}
+				int index = centralQueue.front();
+				centralQueue.pop_front();
+				return index;
+			}
+
+			// Newest job from our own queue
+			std::deque<int>& ownQueue = workerQueues[worker];
+			if (!ownQueue.empty())
+			{
+				int index = ownQueue.back();
+				ownQueue.pop_back();
+				return index;
+			}
+			// Oldest job from a random other worker
+			int firstVictim = std::uniform_int_distribution<int>(0, numWorkers - 1)(random);
+			for (int i = 0; i < numWorkers; i++)
+			{
+				std::deque<int>& victimQueue = workerQueues[(firstVictim + i) % numWorkers];
+				if (!victimQueue.empty())
+				{
+					int index = victimQueue.front();
+					victimQueue.pop_front();
+					stolen = true;
+					return index;
+				}
+			}
+			return -1;
+		};
+
+	while (!events.empty())
+	{
+		int64_t timeNS = events.top().m_timeNS;
+		while (!events.empty() && events.top().m_timeNS == timeNS)
+		{
+			Event event = events.top();
+			events.pop();
+			if (event.m_type == EVENT_CREATED)
+			{
+				satisfyStartCondition(event.m_node);
+			}
+			else
+			{
+				workerBusy[event.m_worker] = false;
+				complete(event.m_node, timeNS);
+			}
+		}
+
+		// Give every idle worker a job
+		for (int worker = 0; worker < numWorkers; worker++)
+		{
+			if (workerBusy[worker])
+			{
+				continue;
+			}
+			bool stolen = false;
+			int index = pickJob(worker, stolen);
+			if (index < 0)
+			{
+				continue;
+			}
+
+			const Node& node = m_nodes[index];
+			int64_t startNS = timeNS + (stolen ? settings.m_stealCostNS : 0);
+			int64_t endNS = startNS + node.m_durationNS;
+			result.m_numSteals += stolen ? 1 : 0;
+			workerBusy[worker] = true;
+			events.push({ endNS, nextOrder++, EVENT_FINISHED, index, worker });
+			runMarkers.push_back({ startNS, 1, index });
+			runMarkers.push_back({ endNS, -1, index });
+			for (int created : node.m_created)
+			{
+				owners[created] = worker;
+				events.push({ startNS + m_nodes[created].m_createOffsetNS, nextOrder++, EVENT_CREATED, created, -1 });
+			}
+		}
+	}
+
+	if (runMarkers.empty())
+	{
+		return result;
+	}
+
+	// Sweep the start/end markers to find how many jobs were running at each point in time. Ends sort before starts at the same time.
+	std::sort(runMarkers.begin(), runMarkers.end(), [](const RunMarker& a, const RunMarker& b)
+		{
+			return a.m_timeNS != b.m_timeNS ? a.m_timeNS < b.m_timeNS : a.m_delta < b.m_delta;
+		});
+	int64_t firstStartNS = runMarkers.front().m_timeNS;
+	int running = 0;
+	// While exactly one job is running, this is its index
+	int64_t runningIndexSum = 0;
+	for (size_t i = 0; i + 1 < runMarkers.size(); i++)
+	{
+		running += runMarkers[i].m_delta;
+		runningIndexSum += runMarkers[i].m_delta * (int64_t)runMarkers[i].m_node;
+		int64_t durationNS = runMarkers[i + 1].m_timeNS - runMarkers[i].m_timeNS;
+		if (durationNS <= 0)
+		{
+			continue;
+		}
+		if ((size_t)running >= result.m_parallelismProfileNS.size())
+		{
+			result.m_parallelismProfileNS.resize(running + 1, 0);
+		}
+		result.m_parallelismProfileNS[running] += durationNS;
+		if (running == 1)
+		{
+			result.m_serialTimeByFuncNS[m_nodes[runningIndexSum].m_func] += durationNS;
+		}
+	}
+	result.m_makespanNS = std::max(lastCompletionNS, runMarkers.back().m_timeNS) - firstStartNS;
+	return result;
+}
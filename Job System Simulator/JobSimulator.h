@@ -0,0 +1,99 @@
+#pragma once
+#include <Jobs/JobRecording.h>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+/** How simulated workers pick jobs */
+enum class SchedulingPolicy
+{
+	/** All workers share one FIFO queue of ready jobs. This is close to an ideal greedy scheduler. */
+	CENTRAL_QUEUE,
+	/** Like the job system: each worker pops its own newest job first, and steals the oldest job from a random other worker when it runs out */
+	WORK_STEALING,
+};
+
+struct SimulationSettings
+{
+	/** Number of workers, including the main thread (worker 0) */
+	int m_numWorkers = 1;
+	SchedulingPolicy m_policy = SchedulingPolicy::WORK_STEALING;
+	/** Time a worker takes to steal a job from another worker */
+	int64_t m_stealCostNS = 1000;
+	/** Seed for picking steal victims */
+	uint32_t m_seed = 1;
+};
+
+struct SimulationResult
+{
+	/** Time from the first job starting to the last job completing */
+	int64_t m_makespanNS = 0;
+	/** Time spent with each number of jobs running at once. Index is the number of jobs running. */
+	std::vector<int64_t> m_parallelismProfileNS;
+	/** Per job function, time spent running with no other job running at the same time */
+	std::map<uint64_t, int64_t> m_serialTimeByFuncNS;
+	/** Number of jobs that were stolen */
+	int m_numSteals = 0;
+};
+
+/**
+ * Replays a job recording against a model of N workers, to predict how the recorded work would scale.
+ *
+ * Each job runs for its recorded exclusive time. A job becomes ready once the job that created it has run up to the point that it was
+ * created, and once every job counted on the counter it waited on has completed. A job completes once it has run, its children have
+ * completed, and every counter it joined has completed. Time a job spent waiting in a join is not simulated, as the worker would
+ * execute other jobs during that time anyway.
+ * Main-thread jobs only run on worker 0.
+ */
+class JobSimulator
+{
+public:
+	explicit JobSimulator(const JobRecording& recording);
+
+	/** Simulates the recording with the given settings */
+	SimulationResult Run(const SimulationSettings& settings) const;
+
+	/** Total exclusive time of every job - the makespan with one worker, ignoring gaps between jobs */
+	int64_t GetTotalWorkNS() const { return m_totalWorkNS; }
+	size_t GetNumJobs() const { return m_nodes.size(); }
+
+private:
+	struct Node
+	{
+		uint64_t m_func = 0;
+		uint8_t m_flags = 0;
+		int64_t m_durationNS = 0;
+		/** Time after the creator starts that this job is created, or the recorded creation time if it has no recorded creator */
+		int64_t m_createOffsetNS = 0;
+		/** Index of the job that created this one, or -1 */
+		int m_creator = -1;
+		/** Recorded thread, used to place jobs with no recorded creator */
+		int m_recordedThread = 0;
+		/** Index of the counter this job is counted on, or -1 */
+		int m_decCounter = -1;
+		/** Index of the counter this job waits on before starting, or -1 */
+		int m_waitCounter = -1;
+		/** Index of this job's parent, or -1 */
+		int m_parent = -1;
+		/** Jobs created by this one */
+		std::vector<int> m_created;
+		/** Number of children this job must wait for to complete */
+		int m_numChildren = 0;
+		/** Counters this job joined */
+		std::vector<int> m_joinedCounters;
+	};
+
+	struct Counter
+	{
+		/** Jobs counted on this counter */
+		int m_numJobs = 0;
+		/** Jobs that wait on this counter before starting */
+		std::vector<int> m_waiters;
+		/** Jobs that joined this counter */
+		std::vector<int> m_joiners;
+	};
+
+	std::vector<Node> m_nodes;
+	std::vector<Counter> m_counters;
+	int64_t m_totalWorkNS = 0;
+};
@@ -0,0 +1,115 @@
+#include "JobSimulator.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+/**
+ * Job scheduling simulator
+ * Replays a recording made with Jobs::BeginRecording()/EndRecording() against models of 1 to N workers, and predicts how it would scale.
+ * Usage: "Job System Simulator" <recording> [max workers, default 64] [steal cost in ns, default 1000]
+ */
+
+static double ToMS(int64_t ns)
+{
+	return (double)ns / 1000000.0;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cout << "Usage: " << argv[0] << " <recording> [max workers] [steal cost ns]" << std::endl;
+		return 1;
+	}
+	int maxWorkers = argc > 2 ? std::max(1, std::atoi(argv[2])) : 64;
+	int64_t stealCostNS = argc > 3 ? std::atoll(argv[3]) : 1000;
+
+	JobRecording recording;
+	if (!recording.Load(argv[1]))
+	{
+		std::cout << "Could not read " << argv[1] << std::endl;
+		return 1;
+	}
+	if (recording.m_jobs.empty())
+	{
+		std::cout << "Recording has no jobs" << std::endl;
+		return 1;
+	}
+
+	int64_t firstStartNS = recording.m_jobs.front().m_startNS;
+	int64_t lastEndNS = recording.m_jobs.front().m_endNS;
+	for (const JobRecord& job : recording.m_jobs)
+	{
+		firstStartNS = std::min(firstStartNS, job.m_startNS);
+		lastEndNS = std::max(lastEndNS, job.m_endNS);
+	}
+
+	JobSimulator simulator(recording);
+	const int64_t workNS = simulator.GetTotalWorkNS();
+
+	// Unlimited workers gives the span (critical path), and shows how much parallelism the job graph has
+	SimulationSettings unlimited;
+	unlimited.m_numWorkers = (int)std::min<size_t>(simulator.GetNumJobs(), 4096);
+	unlimited.m_policy = SchedulingPolicy::CENTRAL_QUEUE;
+	unlimited.m_stealCostNS = 0;
+	SimulationResult unlimitedResult = simulator.Run(unlimited);
+	const int64_t spanNS = unlimitedResult.m_makespanNS;
+
+	// Work that can only run with nothing else running is the serial fraction in Amdahl's law
+	int64_t serialWorkNS = unlimitedResult.m_parallelismProfileNS.size() > 1 ? unlimitedResult.m_parallelismProfileNS[1] : 0;
+	double serialFraction = workNS > 0 ? (double)serialWorkNS / (double)workNS : 1.0;
+
+	std::printf("Recording: %zu jobs, %zu joins, recorded with %d threads\n", recording.m_jobs.size(), recording.m_joins.size(), recording.m_numThreads);
+	std::printf("Recorded makespan:            %10.3f ms\n", ToMS(lastEndNS - firstStartNS));
+	std::printf("Total work (T1):              %10.3f ms\n", ToMS(workNS));
+	std::printf("Span, unlimited workers (Tinf): %8.3f ms\n", ToMS(spanNS));
+	std::printf("Average parallelism (T1/Tinf): %9.2f\n", spanNS > 0 ? (double)workNS / (double)spanNS : 0.0);
+	std::printf("Serial fraction (Amdahl):     %10.2f %%\n", serialFraction * 100.0);
+
+	std::printf("\nParallelism profile (unlimited workers)\n");
+	for (size_t begin = 0; begin < unlimitedResult.m_parallelismProfileNS.size(); begin = begin == 0 ? 1 : begin * 2)
+	{
+		size_t end = std::min(begin == 0 ? 1 : begin * 2, unlimitedResult.m_parallelismProfileNS.size());
+		int64_t bucketNS = 0;
+		for (size_t running = begin; running < end; running++)
+		{
+			bucketNS += unlimitedResult.m_parallelismProfileNS[running];
+		}
+		std::printf("  %5zu-%-5zu jobs running: %10.3f ms (%5.1f %%)\n", begin, end - 1, ToMS(bucketNS), spanNS > 0 ? (double)bucketNS * 100.0 / (double)spanNS : 0.0);
+	}
+
+	std::printf("\nSerial bottlenecks (job functions running with nothing else running)\n");
+	std::vector<std::pair<uint64_t, int64_t>> serialFuncs(unlimitedResult.m_serialTimeByFuncNS.begin(), unlimitedResult.m_serialTimeByFuncNS.end());
+	std::sort(serialFuncs.begin(), serialFuncs.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+	for (size_t i = 0; i < serialFuncs.size() && i < 10; i++)
+	{
+		std::printf("  0x%016llx: %10.3f ms\n", (unsigned long long)serialFuncs[i].first, ToMS(serialFuncs[i].second));
+	}
+
+	std::printf("\nPredicted makespan (steal cost %lld ns)\n", (long long)stealCostNS);
+	std::printf("  workers | central queue (ms) | work stealing (ms) | speedup | Amdahl bound | work/span bound | steals\n");
+	for (int numWorkers = 1; ; numWorkers = std::min(numWorkers * 2, maxWorkers))
+	{
+		SimulationSettings settings;
+		settings.m_numWorkers = numWorkers;
+		settings.m_stealCostNS = stealCostNS;
+		settings.m_policy = SchedulingPolicy::CENTRAL_QUEUE;
+		SimulationResult central = simulator.Run(settings);
+		settings.m_policy = SchedulingPolicy::WORK_STEALING;
+		SimulationResult stealing = simulator.Run(settings);
+
+		double speedup = stealing.m_makespanNS > 0 ? (double)workNS / (double)stealing.m_makespanNS : 0.0;
+		double amdahlBound = 1.0 / (serialFraction + (1.0 - serialFraction) / numWorkers);
+		double workSpanBound = std::min((double)numWorkers, spanNS > 0 ? (double)workNS / (double)spanNS : 0.0);
+		std::printf("  %7d | %18.3f | %18.3f | %7.2f | %12.2f | %15.2f | %6d\n", numWorkers, ToMS(central.m_makespanNS), ToMS(stealing.m_makespanNS),
+			speedup, amdahlBound, workSpanBound, stealing.m_numSteals);
+
+		if (numWorkers == maxWorkers)
+		{
+			break;
+		}
+	}
+	return 0;
+}
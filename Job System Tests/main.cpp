@@ -1,4 +1,24 @@
+#include <Concurrency/MPMCQueue.h>
+#include <Concurrency/MPSCQueue.h>
+#include <Concurrency/SPSCQueue.h>
+#include <FramePipeline/FixedTimestep.h>
+#include <FramePipeline/FramePipeline.h>
+#include <FramePipeline/FrameReclaimer.h>
+#include <FramePipeline/FrameResource.h>
+#include <Jobs/AppendBuffer.h>
+#include <Jobs/IOService.h>
+#include <Jobs/InitGraph.h>
 #include <Jobs/Jobs.h>
+#include <Jobs/Pipeline.h>
+#include <Memory/MemoryPool.h>
+#include <Memory/ScratchStack.h>
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cmath>
+#include <deque>
+#include <fstream>
+#include <thread>
 
 
 std::atomic<int> m_jobsDone = 0;
@@ -65,6 +85,1089 @@ void Test2a(void* data)
 	Jobs::Stop();
 }
 
+// Repeatedly runs a ParallelFor over the same large array, so that chunks are only in cache if they run on the same thread each pass
+constexpr size_t AFFINITY_TEST_COUNT = 1 << 22;
+constexpr size_t AFFINITY_TEST_CHUNK_SIZE = 1 << 15;
+constexpr int AFFINITY_TEST_PASSES = 200;
+static std::vector<float> affinityTestData(AFFINITY_TEST_COUNT, 1.0f);
+
+void Test3a(void* data)
+{
+	AffinityPartitioner* partitioner = (AffinityPartitioner*)data;
+	for (int pass = 0; pass < AFFINITY_TEST_PASSES; pass++)
+	{
+		ParallelForFunc<float> func = [](float* chunk, size_t chunkCount, size_t startIndex)
+			{
+				for (size_t i = 0; i < chunkCount; i++)
+				{
+					chunk[i] = chunk[i] * 1.0001f + 0.5f;
+				}
+			};
+		if (partitioner)
+		{
+			Jobs::ParallelFor(affinityTestData.data(), AFFINITY_TEST_COUNT, AFFINITY_TEST_CHUNK_SIZE, func, *partitioner);
+		}
+		else
+		{
+			Jobs::ParallelFor(affinityTestData.data(), AFFINITY_TEST_COUNT, AFFINITY_TEST_CHUNK_SIZE, func);
+		}
+	}
+	Jobs::Stop();
+}
+
+// Streams items through read -> decompress -> parse -> upload-prep stages, checking that the in-order stage sees items in order
+constexpr int PIPELINE_TEST_ITEMS = 20000;
+constexpr int PIPELINE_TEST_TOKENS = 64;
+
+void Test4a(void* data)
+{
+	std::vector<uint64_t> items(PIPELINE_TEST_ITEMS);
+	int nextItem = 0;
+	int nextUpload = 0;
+	bool inOrder = true;
+
+	Pipeline pipeline;
+	// Read: serial, produces items in order
+	pipeline.AddStage(PipelineStageMode::SERIAL_IN_ORDER, [&](void*) -> void*
+		{
+			if (nextItem == PIPELINE_TEST_ITEMS)
+			{
+				return nullptr;
+			}
+			items[nextItem] = nextItem;
+			return &items[nextItem++];
+		});
+	// Decompress: parallel
+	pipeline.AddStage(PipelineStageMode::PARALLEL, [](void* item) -> void*
+		{
+			uint64_t total = 0;
+			for (int i = 0; i < 12345; i++)
+			{
+				total += i;
+			}
+			count.fetch_add(total);
+			return item;
+		});
+	// Parse: serial, any order
+	pipeline.AddStage(PipelineStageMode::SERIAL_OUT_OF_ORDER, [](void* item) -> void*
+		{
+			*static_cast<uint64_t*>(item) *= 2;
+			return item;
+		});
+	// Upload-prep: serial, in the order items were read
+	pipeline.AddStage(PipelineStageMode::SERIAL_IN_ORDER, [&](void* item) -> void*
+		{
+			inOrder &= item == &items[nextUpload++];
+			return item;
+		});
+	pipeline.Run(PIPELINE_TEST_TOKENS);
+
+	std::cout << "Pipeline processed " << nextUpload << " items " << (inOrder ? "in order" : "OUT OF ORDER") << std::endl;
+	Jobs::Stop();
+}
+
+// Reads a file many times with mixed priorities in one batch, plus a file that doesn't exist, checking each continuation sees its result
+constexpr int IO_TEST_REQUESTS = 64;
+const char* IO_TEST_FILE = "io_test.txt";
+const char* IO_TEST_CONTENTS = "The quick brown fox jumps over the lazy dog";
+
+void Test5b(void* data)
+{
+	const IORequest* request = static_cast<const IORequest*>(data);
+	if (request->m_succeeded && std::string(request->m_buffer.begin(), request->m_buffer.end()) == IO_TEST_CONTENTS)
+	{
+		count++;
+	}
+}
+
+void Test5a(void* data)
+{
+	std::vector<IORequest> requests(IO_TEST_REQUESTS + 1);
+	std::vector<IORequest*> batch;
+	for (int i = 0; i < IO_TEST_REQUESTS + 1; i++)
+	{
+		IORequest& request = requests[i];
+		request.m_path = i < IO_TEST_REQUESTS ? IO_TEST_FILE : "io_test_missing.txt";
+		request.m_priority = (IOPriority)(i % 3);
+		request.m_continuation = Test5b;
+		request.m_continuationData = &request;
+		batch.push_back(&request);
+	}
+	JobCounterPtr counter = Jobs::GetNewJobCounter();
+	IOService::SubmitBatchAndCount(batch.data(), batch.size(), counter);
+	Jobs::JoinUntilCompleted(counter);
+
+	// Shut down while the job system is still running, then check a read submitted afterwards fails without leaving its counter waiting
+	IOService::Shutdown();
+	IORequest& lateRequest = requests[0];
+	lateRequest.m_continuation = Test5b;
+	JobCounterPtr lateCounter = Jobs::GetNewJobCounter();
+	IOService::SubmitAndCount(lateRequest, lateCounter);
+	Jobs::JoinUntilCompleted(lateCounter);
+
+	std::cout << "I/O test read " << count << "/" << IO_TEST_REQUESTS << " files" << (requests.back().m_succeeded ? ", MISSING FILE WAS READ" : "")
+		<< (lateRequest.m_succeeded ? ", READ AFTER SHUTDOWN" : "") << std::endl;
+	Jobs::Stop();
+}
+
+// Allocates blocks of every size class on some threads and checks and frees them on others, over several rounds so spans are reused
+constexpr size_t MEMORY_TEST_BLOCKS = 1 << 14;
+constexpr int MEMORY_TEST_ROUNDS = 4;
+
+void Test6a(void* data)
+{
+	std::vector<uint8_t*> blocks(MEMORY_TEST_BLOCKS);
+	std::atomic<size_t> corrupted = 0;
+	for (int round = 0; round < MEMORY_TEST_ROUNDS; round++)
+	{
+		Jobs::ParallelFor<uint8_t*>(blocks.data(), MEMORY_TEST_BLOCKS, 1000, [](uint8_t** chunk, size_t chunkCount, size_t startIndex)
+			{
+				for (size_t i = 0; i < chunkCount; i++)
+				{
+					size_t index = startIndex + i;
+					size_t size = 1 + (index * 37) % (MemoryPool::MAX_SMALL_SIZE + 1024);
+					chunk[i] = static_cast<uint8_t*>(MemoryPool::Allocate(size));
+					std::fill(chunk[i], chunk[i] + size, (uint8_t)index);
+				}
+			});
+		Jobs::ParallelFor<uint8_t*>(blocks.data(), MEMORY_TEST_BLOCKS, 1500, [&corrupted](uint8_t** chunk, size_t chunkCount, size_t startIndex)
+			{
+				for (size_t i = 0; i < chunkCount; i++)
+				{
+					size_t index = startIndex + i;
+					size_t size = 1 + (index * 37) % (MemoryPool::MAX_SMALL_SIZE + 1024);
+					if (std::count(chunk[i], chunk[i] + size, (uint8_t)index) != (ptrdiff_t)size)
+					{
+						corrupted++;
+					}
+					MemoryPool::Free(chunk[i]);
+				}
+			});
+	}
+
+	MemoryPoolStats stats = MemoryPool::GetStats();
+	std::cout << "Memory pool test found " << corrupted << " corrupted blocks, " << stats.m_numSpansInUse << " spans in use, "
+		<< stats.m_numFreeSpans << " free, " << stats.m_largeBytes << " large bytes" << std::endl;
+	Jobs::Stop();
+}
+
+// Builds temporary arrays on the scratch stack in nested jobs, checking each job's memory is freed when it returns
+constexpr size_t SCRATCH_TEST_ITEMS = 1 << 16;
+constexpr int SCRATCH_TEST_ROUNDS = 8;
+
+void Test7a(void* data)
+{
+	std::vector<uint32_t> items(SCRATCH_TEST_ITEMS);
+	size_t reservedAfterFirstRound = 0;
+	for (int round = 0; round < SCRATCH_TEST_ROUNDS; round++)
+	{
+		Jobs::ParallelFor<uint32_t>(items.data(), items.size(), 4096, [](uint32_t* chunk, size_t chunkCount, size_t startIndex)
+			{
+				ScratchVector<uint32_t> squares;
+				for (size_t i = 0; i < chunkCount; i++)
+				{
+					squares.push_back((uint32_t)((startIndex + i) * (startIndex + i)));
+				}
+				{
+					// A scope inside the job releases its memory early
+					ScratchScope scope;
+					ScratchVector<uint32_t> scratch(chunkCount, 1u);
+				}
+				std::copy(squares.begin(), squares.end(), chunk);
+			});
+		if (round == 0)
+		{
+			reservedAfterFirstRound = ScratchStack::Get().GetReservedBytes();
+		}
+	}
+
+	bool correct = true;
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		correct &= items[i] == (uint32_t)(i * i);
+	}
+	// Every job's memory was released, so later rounds on this thread reuse the same blocks
+	bool reused = ScratchStack::Get().GetReservedBytes() == reservedAfterFirstRound;
+	std::cout << "Scratch stack test results are " << (correct ? "correct" : "WRONG") << ", blocks " << (reused ? "reused" : "GREW") << std::endl;
+	Jobs::Stop();
+}
+
+// Replaces shared data every frame while several frames are in flight, checking no frame ever sees data that has been freed
+constexpr int RECLAIM_TEST_FRAMES = 10000;
+constexpr int RECLAIM_TEST_FRAMES_IN_FLIGHT = 3;
+
+struct ReclaimTestData
+{
+	int64_t m_version = 0;
+	bool m_freed = false;
+};
+
+void Test8a(void* data)
+{
+	// Declared before the reclaimer, as its destructor runs the deleters still waiting
+	std::vector<std::unique_ptr<ReclaimTestData>> allData;
+	FrameReclaimer reclaimer;
+	allData.push_back(std::make_unique<ReclaimTestData>());
+	std::atomic<ReclaimTestData*> shared = allData.back().get();
+
+	// Each frame in flight remembers the data it saw when it began
+	std::deque<std::pair<int64_t, ReclaimTestData*>> framesInFlight;
+	bool correct = true;
+	for (int i = 0; i < RECLAIM_TEST_FRAMES; i++)
+	{
+		int64_t frameNumber = reclaimer.BeginFrame();
+		framesInFlight.push_back({ frameNumber, shared.load() });
+
+		// Publish a new version, and free the old one once no frame can see it
+		allData.push_back(std::make_unique<ReclaimTestData>());
+		allData.back()->m_version = frameNumber + 1;
+		ReclaimTestData* oldData = shared.exchange(allData.back().get());
+		reclaimer.Retire([oldData]() { oldData->m_freed = true; });
+
+		if (framesInFlight.size() == RECLAIM_TEST_FRAMES_IN_FLIGHT)
+		{
+			auto [oldestFrame, seenData] = framesInFlight.front();
+			correct &= !seenData->m_freed;
+			reclaimer.EndFrame(oldestFrame);
+			framesInFlight.pop_front();
+		}
+	}
+	// Only the versions seen by the frames still in flight (and the current version) should be left
+	bool reclaimed = reclaimer.GetNumRetired() == RECLAIM_TEST_FRAMES_IN_FLIGHT - 1;
+	std::cout << "Frame reclaimer test results are " << (correct ? "correct" : "WRONG") << ", old data " << (reclaimed ? "reclaimed" : "NOT RECLAIMED") << std::endl;
+	Jobs::Stop();
+}
+
+// Passes every item through each kind of queue from several threads at once, checking each item comes out exactly once
+constexpr size_t QUEUE_TEST_ITEMS = 1 << 16;
+constexpr size_t QUEUE_TEST_CHUNK = 1024;
+constexpr size_t QUEUE_TEST_BATCH = 16;
+
+struct QueueTestNode : MPSCQueueNode
+{
+	uint32_t m_value = 0;
+};
+
+void Test9a(void* data)
+{
+	std::vector<std::atomic<uint32_t>> timesSeen(QUEUE_TEST_ITEMS);
+	std::vector<uint32_t> items(QUEUE_TEST_ITEMS);
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		items[i] = (uint32_t)i;
+	}
+	bool correct = true;
+	auto checkSeenOnce = [&]()
+		{
+			for (std::atomic<uint32_t>& seen : timesSeen)
+			{
+				correct &= seen.exchange(0) == 1;
+			}
+		};
+
+	// MPMC: every chunk pushes its items (half in batches), then pops as many items as it pushed, from any chunk
+	MPMCQueue<uint32_t> mpmcQueue(QUEUE_TEST_ITEMS);
+	Jobs::ParallelFor<uint32_t>(items.data(), items.size(), QUEUE_TEST_CHUNK, [&](uint32_t* chunk, size_t chunkCount, size_t startIndex)
+		{
+			size_t half = chunkCount / 2;
+			for (size_t i = 0; i < half; i++)
+			{
+				mpmcQueue.TryPush(chunk[i]);
+			}
+			for (size_t i = half; i < chunkCount; i += mpmcQueue.TryPushBatch(chunk + i, std::min(QUEUE_TEST_BATCH, chunkCount - i)))
+			{
+			}
+
+			uint32_t popped[QUEUE_TEST_BATCH];
+			size_t numPopped = 0;
+			while (numPopped < chunkCount)
+			{
+				size_t count = mpmcQueue.TryPopBatch(popped, std::min(QUEUE_TEST_BATCH, chunkCount - numPopped));
+				for (size_t i = 0; i < count; i++)
+				{
+					timesSeen[popped[i]]++;
+				}
+				numPopped += count;
+			}
+		});
+	correct &= mpmcQueue.IsEmpty();
+	checkSeenOnce();
+
+	// SPSC: a small queue between two threads, so the producer often finds it full
+	SPSCQueue<uint32_t> spscQueue(256);
+	std::thread spscProducer([&]()
+		{
+			for (size_t i = 0; i < items.size(); )
+			{
+				size_t pushed = (i % 2 == 0) ? (spscQueue.TryPush(items[i]) ? 1 : 0) : spscQueue.TryPushBatch(&items[i], std::min(QUEUE_TEST_BATCH, items.size() - i));
+				if (pushed == 0)
+				{
+					std::this_thread::yield();
+				}
+				i += pushed;
+			}
+		});
+	uint32_t expected = 0;
+	while (expected < QUEUE_TEST_ITEMS)
+	{
+		uint32_t popped[QUEUE_TEST_BATCH];
+		size_t count = spscQueue.TryPopBatch(popped, QUEUE_TEST_BATCH);
+		if (count == 0)
+		{
+			std::this_thread::yield();
+		}
+		for (size_t i = 0; i < count; i++)
+		{
+			// Items must arrive in order
+			correct &= popped[i] == expected++;
+		}
+	}
+	spscProducer.join();
+
+	// MPSC: every chunk pushes its nodes (half in batches) while another thread pops
+	std::vector<QueueTestNode> nodes(QUEUE_TEST_ITEMS);
+	MPSCQueue<QueueTestNode> mpscQueue;
+	std::thread mpscConsumer([&]()
+		{
+			size_t numPopped = 0;
+			while (numPopped < QUEUE_TEST_ITEMS)
+			{
+				QueueTestNode* popped[QUEUE_TEST_BATCH];
+				size_t count = mpscQueue.TryPopBatch(popped, QUEUE_TEST_BATCH);
+				if (count == 0)
+				{
+					std::this_thread::yield();
+				}
+				for (size_t i = 0; i < count; i++)
+				{
+					timesSeen[popped[i]->m_value]++;
+				}
+				numPopped += count;
+			}
+		});
+	Jobs::ParallelFor<QueueTestNode>(nodes.data(), nodes.size(), QUEUE_TEST_CHUNK, [&](QueueTestNode* chunk, size_t chunkCount, size_t startIndex)
+		{
+			QueueTestNode* batch[QUEUE_TEST_BATCH];
+			size_t batchSize = 0;
+			for (size_t i = 0; i < chunkCount; i++)
+			{
+				chunk[i].m_value = (uint32_t)(startIndex + i);
+				if (i < chunkCount / 2)
+				{
+					mpscQueue.Push(&chunk[i]);
+					continue;
+				}
+				batch[batchSize++] = &chunk[i];
+				if (batchSize == QUEUE_TEST_BATCH || i == chunkCount - 1)
+				{
+					mpscQueue.PushBatch(batch, batchSize);
+					batchSize = 0;
+				}
+			}
+		});
+	mpscConsumer.join();
+	correct &= mpscQueue.IsEmpty();
+	checkSeenOnce();
+
+	std::cout << "Queue test results are " << (correct ? "correct" : "WRONG") << std::endl;
+	Jobs::Stop();
+}
+
+// Appends every multiple of 3 from a ParallelFor, then checks the compacted array holds each of them once. The second round reuses the first round's chunks.
+constexpr size_t APPEND_TEST_ITEMS = 1 << 18;
+
+void Test10a(void* data)
+{
+	std::vector<uint32_t> items(APPEND_TEST_ITEMS);
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		items[i] = (uint32_t)i;
+	}
+	AppendBuffer<uint32_t> buffer;
+	std::vector<uint32_t> compacted;
+	bool correct = true;
+	for (int round = 0; round < 2; round++)
+	{
+		buffer.Clear();
+		Jobs::ParallelFor<uint32_t>(items.data(), items.size(), 1000, [&](uint32_t* chunk, size_t chunkCount, size_t startIndex)
+			{
+				for (size_t i = 0; i < chunkCount; i++)
+				{
+					if (chunk[i] % 3 == 0)
+					{
+						buffer.Push(chunk[i]);
+					}
+				}
+			});
+		buffer.CompactTo(compacted);
+
+		std::sort(compacted.begin(), compacted.end());
+		correct &= compacted.size() == (APPEND_TEST_ITEMS + 2) / 3 && buffer.GetSize() == compacted.size();
+		for (size_t i = 0; i < compacted.size() && correct; i++)
+		{
+			correct &= compacted[i] == i * 3;
+		}
+	}
+	std::cout << "Append buffer test results are " << (correct ? "correct" : "WRONG") << std::endl;
+	Jobs::Stop();
+}
+
+// Runs frames through a pipeline whose middle stage processes several at once and finishes them out of order, checking they still reach the last stage in order
+constexpr int PIPELINE_TEST_FRAMES = 2000;
+constexpr int PIPELINE_TEST_FRAMES_IN_FLIGHT = 4;
+constexpr int PIPELINE_TEST_SLOTS = 3;
+
+struct PipelineTestData
+{
+	uint64_t m_result = 0;
+};
+
+uint64_t PipelineTestWork(int64_t frameNumber)
+{
+	// Later frames in each group of slots do less work, so they finish first
+	uint64_t total = 0;
+	for (int i = 0; i < (PIPELINE_TEST_SLOTS - frameNumber % PIPELINE_TEST_SLOTS) * 20000; i++)
+	{
+		total += i ^ frameNumber;
+	}
+	return total;
+}
+
+class PipelineTestStartStage : public FrameStageRunner<PipelineTestData>
+{
+public:
+	PipelineTestStartStage() : FrameStageRunner("Start") { }
+protected:
+	virtual void RunJobInner(FrameData<PipelineTestData>& frame) override { frame.GetData()->m_result = 0; }
+};
+
+class PipelineTestWorkStage : public FrameStageRunner<PipelineTestData>
+{
+public:
+	PipelineTestWorkStage() : FrameStageRunner("Work") { SetConcurrency(StageConcurrency::ORDERED, PIPELINE_TEST_SLOTS); }
+protected:
+	virtual void RunJobInner(FrameData<PipelineTestData>& frame) override { frame.GetData()->m_result = PipelineTestWork(frame.m_frameNumber); }
+};
+
+class PipelineTestCheckStage : public FrameStageRunner<PipelineTestData>
+{
+public:
+	PipelineTestCheckStage() : FrameStageRunner("Check") { }
+protected:
+	virtual void RunJobInner(FrameData<PipelineTestData>& frame) override
+	{
+		if (m_framesChecked == PIPELINE_TEST_FRAMES)
+		{
+			return;
+		}
+		m_correct &= frame.m_frameNumber == m_framesChecked && frame.GetData()->m_result == PipelineTestWork(frame.m_frameNumber);
+		m_framesChecked++;
+		if (m_framesChecked == PIPELINE_TEST_FRAMES)
+		{
+			std::cout << "Pipeline concurrency test results are " << (m_correct ? "correct" : "WRONG") << std::endl;
+			Jobs::Stop();
+		}
+	}
+private:
+	int64_t m_framesChecked = 0;
+	bool m_correct = true;
+};
+
+void Test11a(void* data)
+{
+	FramePipeline<PipelineTestData>& pipeline = *static_cast<FramePipeline<PipelineTestData>*>(data);
+	std::vector<std::unique_ptr<FrameStageRunner<PipelineTestData>>> stages;
+	stages.emplace_back(std::make_unique<PipelineTestStartStage>());
+	stages.emplace_back(std::make_unique<PipelineTestWorkStage>());
+	stages.emplace_back(std::make_unique<PipelineTestCheckStage>());
+	pipeline.Init(std::move(stages), PIPELINE_TEST_FRAMES_IN_FLIGHT, PipelineTestData());
+	pipeline.Start();
+}
+
+// Runs a pipeline whose middle stage is the slowest, checking the pipeline settles on about the two frames in flight needed to keep that stage busy
+constexpr int FRAMES_IN_FLIGHT_TEST_MAX_FRAMES = 4;
+/** Stage times are noisy, so the pipeline may settle on either side of the two frames the stage times call for */
+constexpr int FRAMES_IN_FLIGHT_TEST_MIN_EXPECTED_FRAMES = 2;
+constexpr int FRAMES_IN_FLIGHT_TEST_MAX_EXPECTED_FRAMES = 3;
+constexpr auto FRAMES_IN_FLIGHT_TEST_DURATION = std::chrono::seconds(2);
+/** Time at the end of the test the number of frames in flight mustn't change in */
+constexpr auto FRAMES_IN_FLIGHT_TEST_SETTLE_TIME = std::chrono::milliseconds(500);
+
+class FramesInFlightTestStage : public FrameStageRunner<PipelineTestData>
+{
+public:
+	FramesInFlightTestStage(const char* name, std::chrono::milliseconds frameTime) : FrameStageRunner(name), m_frameTime(frameTime) { }
+protected:
+	virtual void RunJobInner(FrameData<PipelineTestData>& frame) override { std::this_thread::sleep_for(m_frameTime); }
+private:
+	std::chrono::milliseconds m_frameTime;
+};
+
+void Test12a(void* data)
+{
+	FramePipeline<PipelineTestData>& pipeline = *static_cast<FramePipeline<PipelineTestData>*>(data);
+	std::vector<std::unique_ptr<FrameStageRunner<PipelineTestData>>> stages;
+	stages.emplace_back(std::make_unique<FramesInFlightTestStage>("Fast", std::chrono::milliseconds(2)));
+	stages.emplace_back(std::make_unique<FramesInFlightTestStage>("Slow", std::chrono::milliseconds(8)));
+	stages.emplace_back(std::make_unique<FramesInFlightTestStage>("Fast", std::chrono::milliseconds(2)));
+	FramesInFlightPolicy policy;
+	policy.m_enabled = true;
+	policy.m_targetLatency = std::chrono::milliseconds(30);
+	policy.m_updateInterval = std::chrono::milliseconds(50);
+	pipeline.SetFramesInFlightPolicy(policy);
+	pipeline.Init(std::move(stages), FRAMES_IN_FLIGHT_TEST_MAX_FRAMES, PipelineTestData());
+	pipeline.Start();
+
+	// Let the pipeline settle, then check on the main thread that it has, on a number of frames in the expected range
+	std::this_thread::sleep_for(FRAMES_IN_FLIGHT_TEST_DURATION - FRAMES_IN_FLIGHT_TEST_SETTLE_TIME);
+	size_t numChangesBeforeSettling = pipeline.GetFramesInFlightChanges().size();
+	std::this_thread::sleep_for(FRAMES_IN_FLIGHT_TEST_SETTLE_TIME);
+	int numFramesInFlight = pipeline.GetNumFramesInFlight();
+	std::vector<FramesInFlightChange> changes = pipeline.GetFramesInFlightChanges();
+	bool correct = numFramesInFlight >= FRAMES_IN_FLIGHT_TEST_MIN_EXPECTED_FRAMES && numFramesInFlight <= FRAMES_IN_FLIGHT_TEST_MAX_EXPECTED_FRAMES
+		&& changes.size() == numChangesBeforeSettling;
+	for (const FramesInFlightChange& change : changes)
+	{
+		std::cout << "Frame " << change.m_frameNumber << ": " << change.m_oldFrames << " -> " << change.m_newFrames << " frames in flight (slowest stage " << change.m_slowestStageMS
+			<< "ms, all stages " << change.m_totalStageMS << "ms, latency " << change.m_latencyMS << "ms)" << std::endl;
+	}
+	std::cout << "Frames in flight test results are " << (correct ? "correct" : "WRONG") << std::endl;
+	Jobs::Stop();
+}
+
+// Runs the same stages without adapting the frames in flight, checking the telemetry finds the slow stage and the bubbles in the fast ones
+constexpr auto TELEMETRY_TEST_DURATION = std::chrono::seconds(1);
+
+void Test13a(void* data)
+{
+	FramePipeline<PipelineTestData>& pipeline = *static_cast<FramePipeline<PipelineTestData>*>(data);
+	std::vector<std::unique_ptr<FrameStageRunner<PipelineTestData>>> stages;
+	stages.emplace_back(std::make_unique<FramesInFlightTestStage>("Fast", std::chrono::milliseconds(2)));
+	stages.emplace_back(std::make_unique<FramesInFlightTestStage>("Slow", std::chrono::milliseconds(8)));
+	stages.emplace_back(std::make_unique<FramesInFlightTestStage>("Fast", std::chrono::milliseconds(2)));
+	pipeline.Init(std::move(stages), FRAMES_IN_FLIGHT_TEST_MAX_FRAMES, PipelineTestData());
+	pipeline.Start();
+	std::this_thread::sleep_for(TELEMETRY_TEST_DURATION);
+
+	FrameTelemetryStats stats = pipeline.GetTelemetry().GetStats();
+	bool correct = stats.m_numFrames > 0 && stats.m_bottleneckStage == 1 && stats.m_stages[0].m_numBubbles > 0 && stats.m_stages[2].m_numBubbles > 0;
+	for (const FrameStageStats& stage : stats.m_stages)
+	{
+		std::cout << stage.m_name << ": " << stage.m_averageProcessingMS << "ms processing, " << stage.m_averageWaitMS << "ms waiting, " << stage.m_utilisation * 100.0
+			<< "% busy, " << stage.m_numBubbles << " bubbles (" << stage.m_bubbleMS << "ms)" << std::endl;
+	}
+	bool written = pipeline.GetTelemetry().WriteCSV("frame_timings.csv") && pipeline.GetTelemetry().WriteJSON("frame_timings.json");
+	std::cout << "Telemetry test results are " << (correct ? "correct" : "WRONG") << ", timings " << (written ? "written" : "NOT WRITTEN") << std::endl;
+	Jobs::Stop();
+}
+
+// Runs a pipeline that splits into two branches and joins again, checking both branches ran on every frame before the join, in order
+struct PipelineGraphTestData
+{
+	uint64_t m_branchA = 0;
+	uint64_t m_branchB = 0;
+};
+
+/** Number of branches processing a frame, to count how often they overlap */
+std::atomic<int> pipelineGraphTestBranchesRunning = 0;
+std::atomic<int> pipelineGraphTestOverlaps = 0;
+
+class PipelineGraphTestStartStage : public FrameStageRunner<PipelineGraphTestData>
+{
+public:
+	PipelineGraphTestStartStage() : FrameStageRunner("Start") { }
+protected:
+	virtual void RunJobInner(FrameData<PipelineGraphTestData>& frame) override { *frame.GetData() = PipelineGraphTestData(); }
+};
+
+class PipelineGraphTestBranchStage : public FrameStageRunner<PipelineGraphTestData>
+{
+public:
+	PipelineGraphTestBranchStage(const char* name, bool isBranchA) : FrameStageRunner(name), m_isBranchA(isBranchA)
+	{
+		// One branch also overlaps frames, to check the join still gets them in order
+		if (isBranchA)
+		{
+			SetConcurrency(StageConcurrency::ORDERED, PIPELINE_TEST_SLOTS);
+		}
+	}
+protected:
+	virtual void RunJobInner(FrameData<PipelineGraphTestData>& frame) override
+	{
+		if (++pipelineGraphTestBranchesRunning > 1)
+		{
+			pipelineGraphTestOverlaps++;
+		}
+		uint64_t result = PipelineTestWork(frame.m_frameNumber);
+		(m_isBranchA ? frame.GetData()->m_branchA : frame.GetData()->m_branchB) = result;
+		pipelineGraphTestBranchesRunning--;
+	}
+private:
+	bool m_isBranchA;
+};
+
+class PipelineGraphTestJoinStage : public FrameStageRunner<PipelineGraphTestData>
+{
+public:
+	PipelineGraphTestJoinStage() : FrameStageRunner("Join") { }
+protected:
+	virtual void RunJobInner(FrameData<PipelineGraphTestData>& frame) override
+	{
+		if (m_framesChecked == PIPELINE_TEST_FRAMES)
+		{
+			return;
+		}
+		uint64_t expected = PipelineTestWork(frame.m_frameNumber);
+		m_correct &= frame.m_frameNumber == m_framesChecked && frame.GetData()->m_branchA == expected && frame.GetData()->m_branchB == expected;
+		m_framesChecked++;
+		if (m_framesChecked == PIPELINE_TEST_FRAMES)
+		{
+			std::cout << "Pipeline graph test results are " << (m_correct ? "correct" : "WRONG") << ", branches overlapped " << pipelineGraphTestOverlaps << " times" << std::endl;
+			Jobs::Stop();
+		}
+	}
+private:
+	int64_t m_framesChecked = 0;
+	bool m_correct = true;
+};
+
+void Test15a(void* data)
+{
+	FramePipeline<PipelineGraphTestData>& pipeline = *static_cast<FramePipeline<PipelineGraphTestData>*>(data);
+	std::vector<std::unique_ptr<FrameStageRunner<PipelineGraphTestData>>> stages;
+	stages.emplace_back(std::make_unique<PipelineGraphTestStartStage>());
+	stages.emplace_back(std::make_unique<PipelineGraphTestBranchStage>("Branch A", true));
+	stages.emplace_back(std::make_unique<PipelineGraphTestBranchStage>("Branch B", false));
+	stages.emplace_back(std::make_unique<PipelineGraphTestJoinStage>());
+	std::vector<FrameStageLink> links = { { 0, 1 }, { 0, 2 }, { 1, 3 }, { 2, 3 } };
+	pipeline.Init(std::move(stages), links, PIPELINE_TEST_FRAMES_IN_FLIGHT, PipelineGraphTestData());
+	pipeline.Start();
+}
+
+// Holds frames at a pipeline's last stage until every other frame is waiting for it, checking the frames behind the first one waiting are
+// dropped rather than queueing up too. Then lets a set number of frames be presented, checking every dropped frame skipped the last stage.
+constexpr int OVERLOAD_TEST_FRAMES = 100;
+/** Frames the work stage should drop while the first frame is held at the present stage, as a bit per frame */
+constexpr uint64_t OVERLOAD_TEST_EXPECTED_DROPS = 0b1100;
+/** Longest a test waits for a pipeline to reach the state it's checking for, so a broken pipeline fails the test rather than hanging it */
+constexpr auto PIPELINE_TEST_TIMEOUT = std::chrono::seconds(10);
+
+/** Waits until condition returns true, or PIPELINE_TEST_TIMEOUT has passed. Returns whether it did. */
+bool WaitForPipelineTest(const std::function<bool()>& condition)
+{
+	auto endTime = std::chrono::high_resolution_clock::now() + PIPELINE_TEST_TIMEOUT;
+	while (!condition())
+	{
+		if (std::chrono::high_resolution_clock::now() >= endTime)
+		{
+			return false;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return true;
+}
+
+/** Holds frames in a test stage until the test lets them through, so the test can check the pipeline in a known state. Only for SERIAL stages. */
+class PipelineTestGate
+{
+public:
+	PipelineTestGate(int framesAllowed) : m_framesAllowed(framesAllowed) { }
+	/** Blocks until another frame is allowed through */
+	void Wait()
+	{
+		if (m_framesPassed >= m_framesAllowed)
+		{
+			m_holding = true;
+			while (m_framesPassed >= m_framesAllowed)
+			{
+				std::this_thread::yield();
+			}
+			m_holding = false;
+		}
+		m_framesPassed++;
+	}
+	/** Lets numFrames more frames through */
+	void Allow(int numFrames) { m_framesAllowed += numFrames; }
+	/** Lets every frame through, e.g. before stopping the job system, so no job thread is left blocked */
+	void Open() { m_framesAllowed = INT_MAX / 2; }
+	/** Returns whether a frame is being held */
+	bool IsHolding() const { return m_holding; }
+private:
+	std::atomic<int> m_framesAllowed;
+	std::atomic<int> m_framesPassed = 0;
+	std::atomic<bool> m_holding = false;
+};
+
+class OverloadTestWorkStage : public FrameStageRunner<PipelineTestData>
+{
+public:
+	OverloadTestWorkStage(int framesAllowed = INT_MAX / 2) : FrameStageRunner("Work"), m_gate(framesAllowed) { }
+	/** Number of frames this stage has finished running */
+	std::atomic<int> m_framesRun = 0;
+	/** Bit per frame, for the first 64 frames, of whether this stage dropped it */
+	std::atomic<uint64_t> m_droppedFrames = 0;
+	PipelineTestGate m_gate;
+protected:
+	virtual void RunJobInner(FrameData<PipelineTestData>& frame) override
+	{
+		m_gate.Wait();
+		if (DropFrameIfOverloaded(frame) && frame.m_frameNumber < 64)
+		{
+			m_droppedFrames |= 1ull << frame.m_frameNumber;
+		}
+		m_framesRun++;
+	}
+};
+
+class OverloadTestPresentStage : public FrameStageRunner<PipelineTestData>
+{
+public:
+	OverloadTestPresentStage(int framesAllowed = INT_MAX / 2) : FrameStageRunner("Present"), m_gate(framesAllowed) { SetSkippable(true); }
+	/** Whether every frame presented was newer than the last, and not dropped */
+	std::atomic<bool> m_correct = true;
+	std::atomic<int> m_framesPresented = 0;
+	PipelineTestGate m_gate;
+protected:
+	virtual void RunJobInner(FrameData<PipelineTestData>& frame) override
+	{
+		m_gate.Wait();
+		m_correct = m_correct && !frame.m_dropped && frame.m_frameNumber > m_lastFrameNumber;
+		m_lastFrameNumber = frame.m_frameNumber;
+		m_framesPresented++;
+	}
+private:
+	int64_t m_lastFrameNumber = -1;
+};
+
+/** Runs the overload test, dropping frames under load or not. Without dropping frames, none should be dropped, but back-pressure is still found. */
+void RunOverloadTest(FramePipeline<PipelineTestData>& pipeline, bool dropFrames, const char* testName)
+{
+	std::vector<std::unique_ptr<FrameStageRunner<PipelineTestData>>> stages;
+	stages.emplace_back(std::make_unique<PipelineTestStartStage>());
+	stages.emplace_back(std::make_unique<OverloadTestWorkStage>());
+	stages.emplace_back(std::make_unique<OverloadTestPresentStage>(0));
+	FrameOverloadPolicy policy;
+	policy.m_enabled = dropFrames;
+	pipeline.SetOverloadPolicy(policy);
+	pipeline.Init(std::move(stages), FRAMES_IN_FLIGHT_TEST_MAX_FRAMES, PipelineTestData());
+	OverloadTestWorkStage& work = static_cast<OverloadTestWorkStage&>(*pipeline.m_stages[1]);
+	OverloadTestPresentStage& present = static_cast<OverloadTestPresentStage&>(*pipeline.m_stages[2]);
+	pipeline.Start();
+
+	// The first frame is held at the present stage and the second queues for it, so the work stage should drop the rest
+	bool overloaded = WaitForPipelineTest([&]() { return present.m_gate.IsHolding() && work.m_framesRun == FRAMES_IN_FLIGHT_TEST_MAX_FRAMES; });
+	bool backPressure = pipeline.GetBackPressureStage() == 2;
+	bool framesDropped = work.m_droppedFrames == (dropFrames ? OVERLOAD_TEST_EXPECTED_DROPS : 0);
+
+	// Let a set number of frames be presented, then wait for every frame to be held or waiting at the present stage again, so the counts have settled
+	present.m_gate.Allow(OVERLOAD_TEST_FRAMES);
+	bool settled = WaitForPipelineTest([&]()
+		{
+			int framesWaiting = work.m_framesRun - present.m_framesPresented - (int)present.GetNumFramesSkipped();
+			return present.m_gate.IsHolding() && present.m_framesPresented == OVERLOAD_TEST_FRAMES && framesWaiting == FRAMES_IN_FLIGHT_TEST_MAX_FRAMES;
+		});
+	int64_t numDropped = pipeline.GetNumDroppedFrames();
+	bool framesSkipped = numDropped == present.GetNumFramesSkipped() && (dropFrames ? numDropped > 0 : numDropped == 0);
+	present.m_gate.Open();
+
+	bool correct = overloaded && backPressure && framesDropped && settled && framesSkipped && present.m_correct;
+	std::cout << testName << " results are " << (correct ? "correct" : "WRONG") << ", " << present.m_framesPresented << " frames presented, "
+		<< numDropped << " dropped, " << present.GetNumFramesSkipped() << " skipped" << std::endl;
+	Jobs::Stop();
+}
+
+void Test16b(void* data)
+{
+	RunOverloadTest(*static_cast<FramePipeline<PipelineTestData>*>(data), false, "Overload test without dropping frames");
+}
+
+void Test16a(void* data)
+{
+	RunOverloadTest(*static_cast<FramePipeline<PipelineTestData>*>(data), true, "Overload test");
+}
+
+// Holds a frame in a pipeline's middle stage until the frames behind it are all waiting for that stage, then checks the frame isn't
+// dropped just because they're waiting, as dropping it wouldn't get them through any sooner and nothing would be presented
+constexpr int MIDDLE_OVERLOAD_TEST_FRAMES = 100;
+
+void Test19a(void* data)
+{
+	FramePipeline<PipelineTestData>& pipeline = *static_cast<FramePipeline<PipelineTestData>*>(data);
+	std::vector<std::unique_ptr<FrameStageRunner<PipelineTestData>>> stages;
+	stages.emplace_back(std::make_unique<PipelineTestStartStage>());
+	stages.emplace_back(std::make_unique<OverloadTestWorkStage>(0));
+	stages.emplace_back(std::make_unique<OverloadTestPresentStage>());
+	FrameOverloadPolicy policy;
+	policy.m_enabled = true;
+	pipeline.SetOverloadPolicy(policy);
+	pipeline.Init(std::move(stages), FRAMES_IN_FLIGHT_TEST_MAX_FRAMES, PipelineTestData());
+	OverloadTestWorkStage& work = static_cast<OverloadTestWorkStage&>(*pipeline.m_stages[1]);
+	OverloadTestPresentStage& present = static_cast<OverloadTestPresentStage&>(*pipeline.m_stages[2]);
+	pipeline.Start();
+
+	// The first frame is held in the work stage until every other frame is waiting for it
+	bool overloaded = WaitForPipelineTest([&]() { return work.m_gate.IsHolding() && work.GetNumQueuedFrames() == FRAMES_IN_FLIGHT_TEST_MAX_FRAMES - 1; });
+	bool backPressure = pipeline.GetBackPressureStage() == 1;
+
+	// Let it through, and it should be presented, while the next frame is held
+	work.m_gate.Allow(1);
+	bool firstFramePresented = WaitForPipelineTest([&]() { return present.m_framesPresented == 1 && work.m_gate.IsHolding(); })
+		&& (work.m_droppedFrames & 1) == 0;
+
+	// Then let the rest through, checking frames keep being presented
+	work.m_gate.Open();
+	bool framesPresented = WaitForPipelineTest([&]() { return present.m_framesPresented >= MIDDLE_OVERLOAD_TEST_FRAMES; });
+
+	bool correct = overloaded && backPressure && firstFramePresented && framesPresented && present.m_correct;
+	std::cout << "Middle stage overload test results are " << (correct ? "correct" : "WRONG") << ", " << present.m_framesPresented << " of "
+		<< work.m_framesRun << " frames presented, " << pipeline.GetNumDroppedFrames() << " dropped" << std::endl;
+	Jobs::Stop();
+}
+
+// Runs frames through a stage that fills a per-frame buffer while processing several frames at once, then a stage that reads it,
+// checking no frame's buffer was overwritten by another frame before it was read
+constexpr size_t FRAME_RESOURCE_TEST_BUFFER_SIZE = 1024;
+
+/** Written by the fill stage and read by the check stage, one buffer per frame in flight */
+FrameResource<std::vector<int64_t>> frameResourceTestBuffers;
+/** Number of frames the fill stage is processing, to count how often they overlap */
+std::atomic<int> frameResourceTestFramesFilling = 0;
+std::atomic<int> frameResourceTestOverlaps = 0;
+
+class FrameResourceTestFillStage : public FrameStageRunner<PipelineTestData>
+{
+public:
+	FrameResourceTestFillStage() : FrameStageRunner("Fill") { SetConcurrency(StageConcurrency::ORDERED, PIPELINE_TEST_SLOTS); }
+	virtual void Init() override
+	{
+		frameResourceTestBuffers.Init(GetNumSimultaneousFrames());
+		for (size_t i = 0; i < frameResourceTestBuffers.GetNumFrames(); i++)
+		{
+			frameResourceTestBuffers.GetById((int)i).resize(FRAME_RESOURCE_TEST_BUFFER_SIZE);
+		}
+	}
+protected:
+	virtual void RunJobInner(FrameData<PipelineTestData>& frame) override
+	{
+		if (++frameResourceTestFramesFilling > 1)
+		{
+			frameResourceTestOverlaps++;
+		}
+		std::vector<int64_t>& buffer = frameResourceTestBuffers.Get(frame);
+		std::fill(buffer.begin(), buffer.end(), frame.m_frameNumber);
+		frame.GetData()->m_result = PipelineTestWork(frame.m_frameNumber);
+		frameResourceTestFramesFilling--;
+	}
+};
+
+class FrameResourceTestCheckStage : public FrameStageRunner<PipelineTestData>
+{
+public:
+	FrameResourceTestCheckStage() : FrameStageRunner("Check") { }
+protected:
+	virtual void RunJobInner(FrameData<PipelineTestData>& frame) override
+	{
+		if (m_framesChecked == PIPELINE_TEST_FRAMES)
+		{
+			return;
+		}
+		const std::vector<int64_t>& buffer = frameResourceTestBuffers.Get(frame);
+		m_correct &= std::all_of(buffer.begin(), buffer.end(), [&](int64_t value) { return value == frame.m_frameNumber; });
+		m_framesChecked++;
+		if (m_framesChecked == PIPELINE_TEST_FRAMES)
+		{
+			std::cout << "Frame resource test results are " << (m_correct ? "correct" : "WRONG") << ", frames overlapped " << frameResourceTestOverlaps << " times" << std::endl;
+			Jobs::Stop();
+		}
+	}
+private:
+	int64_t m_framesChecked = 0;
+	bool m_correct = true;
+};
+
+void Test17a(void* data)
+{
+	FramePipeline<PipelineTestData>& pipeline = *static_cast<FramePipeline<PipelineTestData>*>(data);
+	std::vector<std::unique_ptr<FrameStageRunner<PipelineTestData>>> stages;
+	stages.emplace_back(std::make_unique<PipelineTestStartStage>());
+	stages.emplace_back(std::make_unique<FrameResourceTestFillStage>());
+	stages.emplace_back(std::make_unique<FrameResourceTestCheckStage>());
+	pipeline.Init(std::move(stages), PIPELINE_TEST_FRAMES_IN_FLIGHT, PipelineTestData());
+	pipeline.Start();
+}
+
+// Runs a graph of start-up tasks, checking each only starts once its dependencies have finished and main thread tasks stay there,
+// and a second graph that's cancelled part way, checking the rest of its tasks and its completion job are skipped
+enum InitGraphTestTask { INIT_TEST_WINDOW, INIT_TEST_SCENE, INIT_TEST_SHADERS, INIT_TEST_RENDERER, INIT_TEST_PIPELINE, INIT_TEST_NUM_TASKS };
+static InitGraph initGraphTest;
+static InitGraph cancelledInitGraphTest;
+static std::atomic<int> initGraphTestOrder = 0;
+static std::array<std::atomic<int>, INIT_TEST_NUM_TASKS> initGraphTestTaskOrders;
+static std::array<std::atomic<int>, INIT_TEST_NUM_TASKS> initGraphTestTaskThreads;
+static std::atomic<int> cancelledInitGraphTestRuns = 0;
+
+void InitGraphTestTask(int task)
+{
+	initGraphTestTaskThreads[task] = Jobs::GetThisThreadIndex();
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	initGraphTestTaskOrders[task] = initGraphTestOrder++;
+}
+
+void CancelledInitGraphTestComplete(void* data)
+{
+	cancelledInitGraphTestRuns += 100;
+}
+
+void InitGraphTestComplete(void* data)
+{
+	const int mainThread = (int)Jobs::GetMainThreadIndex();
+	bool correct = initGraphTest.IsComplete() && initGraphTestOrder == INIT_TEST_NUM_TASKS;
+	correct &= initGraphTestTaskOrders[INIT_TEST_RENDERER] > initGraphTestTaskOrders[INIT_TEST_WINDOW];
+	correct &= initGraphTestTaskOrders[INIT_TEST_RENDERER] > initGraphTestTaskOrders[INIT_TEST_SHADERS];
+	for (int task = 0; task < INIT_TEST_PIPELINE; task++)
+	{
+		correct &= initGraphTestTaskOrders[INIT_TEST_PIPELINE] > initGraphTestTaskOrders[task];
+	}
+	correct &= initGraphTestTaskThreads[INIT_TEST_WINDOW] == mainThread && initGraphTestTaskThreads[INIT_TEST_RENDERER] == mainThread;
+
+	// The recorded timeline should agree
+	std::vector<InitTaskTiming> timings = initGraphTest.GetTaskTimings();
+	correct &= timings.size() == INIT_TEST_NUM_TASKS;
+	if (correct)
+	{
+		correct &= timings[INIT_TEST_RENDERER].m_mainThread && timings[INIT_TEST_RENDERER].m_dependencies.size() == 2;
+		correct &= timings[INIT_TEST_RENDERER].m_startMS >= timings[INIT_TEST_WINDOW].m_endMS && timings[INIT_TEST_RENDERER].m_startMS >= timings[INIT_TEST_SHADERS].m_endMS;
+		correct &= timings[INIT_TEST_PIPELINE].m_startMS >= timings[INIT_TEST_RENDERER].m_endMS && timings[INIT_TEST_PIPELINE].m_startMS >= timings[INIT_TEST_SCENE].m_endMS;
+	}
+
+	// Only the task that cancelled the graph should have run
+	while (!cancelledInitGraphTest.IsComplete())
+	{
+		std::this_thread::yield();
+	}
+	correct &= cancelledInitGraphTestRuns == 1 && cancelledInitGraphTest.GetTaskTimings().size() == 1;
+
+	std::cout << "Init graph test results are " << (correct ? "correct" : "WRONG") << std::endl;
+	initGraphTest.PrintTimeline(std::cout);
+	Jobs::Stop();
+}
+
+void Test18a(void* data)
+{
+	int window = initGraphTest.AddTask("Window", []() { InitGraphTestTask(INIT_TEST_WINDOW); }, {}, JOBFLAG_MAINTHREAD);
+	int scene = initGraphTest.AddTask("Scene", []() { InitGraphTestTask(INIT_TEST_SCENE); });
+	int shaders = initGraphTest.AddTask("Shaders", []() { InitGraphTestTask(INIT_TEST_SHADERS); });
+	int renderer = initGraphTest.AddTask("Renderer", []() { InitGraphTestTask(INIT_TEST_RENDERER); }, { window, shaders }, JOBFLAG_MAINTHREAD);
+	initGraphTest.AddTask("Pipeline", []() { InitGraphTestTask(INIT_TEST_PIPELINE); }, { window, scene, shaders, renderer });
+
+	int failing = cancelledInitGraphTest.AddTask("Failing", []() { cancelledInitGraphTestRuns++; cancelledInitGraphTest.Cancel(); });
+	int skipped = cancelledInitGraphTest.AddTask("Skipped", []() { cancelledInitGraphTestRuns++; }, { failing });
+	cancelledInitGraphTest.AddTask("Also skipped", []() { cancelledInitGraphTestRuns++; }, { skipped }, JOBFLAG_MAINTHREAD);
+
+	cancelledInitGraphTest.Start(CancelledInitGraphTestComplete, nullptr, JOBFLAG_NONE);
+	initGraphTest.Start(InitGraphTestComplete, nullptr, JOBFLAG_NONE);
+}
+
+// Leaves jobs queued that wait on a counter that doesn't complete, with nothing else to do, checking the elastic thread policy still
+// retires threads down to its minimum rather than treating the waiting jobs as work. Then completes the counter, checking the jobs still run.
+constexpr int ELASTIC_TEST_WAITING_JOBS = 32;
+/** Longest to wait for the policy to retire threads, so a policy that never does fails the test rather than hanging it */
+constexpr auto ELASTIC_TEST_TIMEOUT = std::chrono::seconds(10);
+/** Waits for threads to be retired, then posts the check job, from outside the job system so no job thread is kept busy waiting */
+static std::thread elasticTestWatcher;
+static std::atomic<bool> elasticTestThreadsRetired = false;
+/** The job the waiting jobs' counter is waiting for. It isn't posted until the check, so they stay queued until then. */
+static JobPtr elasticTestReleaseJob;
+static JobCounterPtr elasticTestWaitingJobsCounter;
+static std::atomic<int> elasticTestJobsRun = 0;
+
+void ElasticTestWaitingJob(void* data)
+{
+	elasticTestJobsRun++;
+}
+
+void ElasticTestReleaseJob(void* data)
+{
+}
+
+void Test20b(void* data)
+{
+	elasticTestWatcher.join();
+	const ElasticThreadPolicy& policy = *static_cast<ElasticThreadPolicy*>(data);
+	int numActiveThreads = Jobs::GetNumActiveThreads();
+
+	// Release the waiting jobs, and wait for them to run
+	Jobs::PostJob(std::move(elasticTestReleaseJob), Jobs::GetThisThreadIndex());
+	Jobs::JoinUntilCompleted(elasticTestWaitingJobsCounter);
+
+	bool correct = elasticTestThreadsRetired && numActiveThreads == policy.m_minThreads && elasticTestJobsRun == ELASTIC_TEST_WAITING_JOBS;
+	std::cout << "Elastic thread test results are " << (correct ? "correct" : "WRONG") << ", " << numActiveThreads << " threads active" << std::endl;
+	Jobs::SetElasticPolicy(ElasticThreadPolicy());
+	Jobs::Stop();
+}
+
+void Test20a(void* data)
+{
+	const ElasticThreadPolicy& policy = *static_cast<ElasticThreadPolicy*>(data);
+	JobCounterPtr releaseCounter = Jobs::GetNewJobCounter();
+	elasticTestReleaseJob = Jobs::CreateUnqueuedJobAndCount(ElasticTestReleaseJob, nullptr, JOBFLAG_NONE, releaseCounter);
+	elasticTestWaitingJobsCounter = Jobs::GetNewJobCounter();
+	for (int i = 0; i < ELASTIC_TEST_WAITING_JOBS; i++)
+	{
+		Jobs::CreateJobWithDependencyAndCount(ElasticTestWaitingJob, nullptr, JOBFLAG_NONE, releaseCounter, elasticTestWaitingJobsCounter);
+	}
+
+	JobPtr checkJob = Jobs::CreateUnqueuedJob(Test20b, data, JOBFLAG_NONE);
+	int minThreads = policy.m_minThreads;
+	elasticTestWatcher = std::thread([checkJob, minThreads]() mutable
+		{
+			auto endTime = std::chrono::high_resolution_clock::now() + ELASTIC_TEST_TIMEOUT;
+			while (Jobs::GetNumActiveThreads() > minThreads && std::chrono::high_resolution_clock::now() < endTime)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+			elasticTestThreadsRetired = Jobs::GetNumActiveThreads() == minThreads;
+			Jobs::PostJob(std::move(checkJob), (uint8_t)Jobs::GetMainThreadIndex());
+		});
+}
+
+// Checks that fixed timesteps don't depend on the frame rate, and that a long frame can't make the simulation run too many steps
+void Test14a(void* data)
+{
+	constexpr double STEP_TIME = 1.0 / 60.0;
+	constexpr int MAX_STEPS = 4;
+
+	// One simulated second at 240 and 60 frames per second should take the same number of steps
+	FixedTimestep fastFrames(STEP_TIME, MAX_STEPS);
+	FixedTimestep slowFrames(STEP_TIME, MAX_STEPS);
+	for (int i = 0; i < 240; i++)
+	{
+		fastFrames.Advance(1.0 / 240.0);
+	}
+	for (int i = 0; i < 60; i++)
+	{
+		slowFrames.Advance(1.0 / 60.0);
+	}
+	bool correct = std::abs(fastFrames.GetTotalSteps() - 60) <= 1 && std::abs(slowFrames.GetTotalSteps() - 60) <= 1;
+
+	// Half a step leaves the frame half way to the next step
+	FixedTimestep timestep(STEP_TIME, MAX_STEPS);
+	correct &= timestep.Advance(STEP_TIME * 0.5) == 0;
+	correct &= std::abs(timestep.GetInterpolationAlpha() - 0.5) < 0.001;
+
+	// A one second hitch only runs MAX_STEPS steps, and drops the rest of the time apart from the fraction of a step
+	int hitchSteps = timestep.Advance(1.0);
+	correct &= hitchSteps == MAX_STEPS;
+	correct &= timestep.GetDroppedTime() > 1.0 - STEP_TIME * (MAX_STEPS + 1) && timestep.GetDroppedTime() < 1.0 - STEP_TIME * (MAX_STEPS - 1);
+	correct &= timestep.GetInterpolationAlpha() >= 0.0 && timestep.GetInterpolationAlpha() < 1.0;
+	// Then normal frames carry on as usual
+	correct &= timestep.Advance(STEP_TIME) == 1;
+
+	std::cout << "Fixed timestep test results are " << (correct ? "correct" : "WRONG") << ", " << hitchSteps << " steps after a hitch, "
+		<< timestep.GetDroppedTime() << "s dropped" << std::endl;
+	Jobs::Stop();
+}
+
 int main()
 {
 	// Single-thread test
@@ -94,5 +1197,175 @@ int main()
 	elapsed = end - start;
 	std::cout << "nested job test completed in " << elapsed.count() << "ns" << "(Result: " << count << ")" << std::endl;
 
+	// Affinity test (compare cache misses of these two runs with a profiler, e.g. perf stat -e cache-misses)
+	std::cout << "Starting parallel-for test without affinity" << std::endl;
+	start = std::chrono::system_clock::now();
+	Jobs noAffinityTest(12, Test3a, nullptr);
+	end = std::chrono::system_clock::now();
+	elapsed = end - start;
+	std::cout << "Parallel-for test without affinity completed in " << elapsed.count() << "ns" << std::endl;
+
+	std::cout << "Starting parallel-for test with affinity" << std::endl;
+	AffinityPartitioner partitioner;
+	start = std::chrono::system_clock::now();
+	Jobs affinityTest(12, Test3a, &partitioner);
+	end = std::chrono::system_clock::now();
+	elapsed = end - start;
+	std::cout << "Parallel-for test with affinity completed in " << elapsed.count() << "ns" << std::endl;
+
+	// Pipeline test
+	std::cout << "Starting pipeline test" << std::endl;
+	count = 0;
+	start = std::chrono::system_clock::now();
+	Jobs pipelineTest(12, Test4a, nullptr);
+	end = std::chrono::system_clock::now();
+	elapsed = end - start;
+	std::cout << "Pipeline test completed in " << elapsed.count() << "ns" << "(Result: " << count << ")" << std::endl;
+
+	// I/O test
+	std::cout << "Starting I/O test" << std::endl;
+	std::ofstream(IO_TEST_FILE, std::ios::binary) << IO_TEST_CONTENTS;
+	count = 0;
+	IOService::Init(2);
+	start = std::chrono::system_clock::now();
+	Jobs ioTest(12, Test5a, nullptr);
+	end = std::chrono::system_clock::now();
+	elapsed = end - start;
+	std::cout << "I/O test completed in " << elapsed.count() << "ns" << "(Result: " << count << ")" << std::endl;
+
+	// Memory pool test
+	std::cout << "Starting memory pool test" << std::endl;
+	start = std::chrono::system_clock::now();
+	Jobs memoryTest(12, Test6a, nullptr);
+	end = std::chrono::system_clock::now();
+	elapsed = end - start;
+	std::cout << "Memory pool test completed in " << elapsed.count() << "ns" << std::endl;
+
+	// Scratch stack test
+	std::cout << "Starting scratch stack test" << std::endl;
+	start = std::chrono::system_clock::now();
+	Jobs scratchTest(12, Test7a, nullptr);
+	end = std::chrono::system_clock::now();
+	elapsed = end - start;
+	std::cout << "Scratch stack test completed in " << elapsed.count() << "ns" << std::endl;
+
+	// Frame reclaimer test
+	std::cout << "Starting frame reclaimer test" << std::endl;
+	start = std::chrono::system_clock::now();
+	Jobs reclaimTest(1, Test8a, nullptr);
+	end = std::chrono::system_clock::now();
+	elapsed = end - start;
+	std::cout << "Frame reclaimer test completed in " << elapsed.count() << "ns" << std::endl;
+
+	// Queue test
+	std::cout << "Starting queue test" << std::endl;
+	start = std::chrono::system_clock::now();
+	Jobs queueTest(12, Test9a, nullptr);
+	end = std::chrono::system_clock::now();
+	elapsed = end - start;
+	std::cout << "Queue test completed in " << elapsed.count() << "ns" << std::endl;
+
+	// Append buffer test
+	std::cout << "Starting append buffer test" << std::endl;
+	start = std::chrono::system_clock::now();
+	Jobs appendTest(12, Test10a, nullptr);
+	end = std::chrono::system_clock::now();
+	elapsed = end - start;
+	std::cout << "Append buffer test completed in " << elapsed.count() << "ns" << std::endl;
+
+	// Pipeline concurrency test
+	std::cout << "Starting pipeline concurrency test" << std::endl;
+	FramePipeline<PipelineTestData> framePipeline;
+	start = std::chrono::system_clock::now();
+	Jobs framePipelineTest(12, Test11a, &framePipeline);
+	end = std::chrono::system_clock::now();
+	elapsed = end - start;
+	std::cout << "Pipeline concurrency test completed in " << elapsed.count() << "ns" << std::endl;
+
+	// Frames in flight test
+	std::cout << "Starting frames in flight test" << std::endl;
+	FramePipeline<PipelineTestData> adaptivePipeline;
+	start = std::chrono::system_clock::now();
+	Jobs framesInFlightTest(2, Test12a, &adaptivePipeline);
+	end = std::chrono::system_clock::now();
+	elapsed = end - start;
+	std::cout << "Frames in flight test completed in " << elapsed.count() << "ns" << std::endl;
+
+	// Telemetry test
+	std::cout << "Starting telemetry test" << std::endl;
+	FramePipeline<PipelineTestData> telemetryPipeline;
+	start = std::chrono::system_clock::now();
+	Jobs telemetryTest(2, Test13a, &telemetryPipeline);
+	end = std::chrono::system_clock::now();
+	elapsed = end - start;
+	std::cout << "Telemetry test completed in " << elapsed.count() << "ns" << std::endl;
+
+	// Fixed timestep test
+	std::cout << "Starting fixed timestep test" << std::endl;
+	start = std::chrono::system_clock::now();
+	Jobs fixedTimestepTest(2, Test14a, nullptr);
+	end = std::chrono::system_clock::now();
+	elapsed = end - start;
+	std::cout << "Fixed timestep test completed in " << elapsed.count() << "ns" << std::endl;
+
+	// Pipeline graph test
+	std::cout << "Starting pipeline graph test" << std::endl;
+	FramePipeline<PipelineGraphTestData> graphPipeline;
+	start = std::chrono::system_clock::now();
+	Jobs pipelineGraphTest(12, Test15a, &graphPipeline);
+	end = std::chrono::system_clock::now();
+	elapsed = end - start;
+	std::cout << "Pipeline graph test completed in " << elapsed.count() << "ns" << std::endl;
+
+	// Overload test
+	std::cout << "Starting overload test" << std::endl;
+	FramePipeline<PipelineTestData> overloadWithoutDroppingPipeline;
+	FramePipeline<PipelineTestData> overloadPipeline;
+	start = std::chrono::system_clock::now();
+	Jobs overloadWithoutDroppingTest(4, Test16b, &overloadWithoutDroppingPipeline);
+	Jobs overloadTest(4, Test16a, &overloadPipeline);
+	end = std::chrono::system_clock::now();
+	elapsed = end - start;
+	std::cout << "Overload test completed in " << elapsed.count() << "ns" << std::endl;
+
+	// Middle stage overload test
+	std::cout << "Starting middle stage overload test" << std::endl;
+	FramePipeline<PipelineTestData> middleOverloadPipeline;
+	start = std::chrono::system_clock::now();
+	Jobs middleOverloadTest(4, Test19a, &middleOverloadPipeline);
+	end = std::chrono::system_clock::now();
+	elapsed = end - start;
+	std::cout << "Middle stage overload test completed in " << elapsed.count() << "ns" << std::endl;
+
+	// Frame resource test
+	std::cout << "Starting frame resource test" << std::endl;
+	FramePipeline<PipelineTestData> frameResourcePipeline;
+	start = std::chrono::system_clock::now();
+	Jobs frameResourceTest(12, Test17a, &frameResourcePipeline);
+	end = std::chrono::system_clock::now();
+	elapsed = end - start;
+	std::cout << "Frame resource test completed in " << elapsed.count() << "ns" << std::endl;
+
+	// Init graph test
+	std::cout << "Starting init graph test" << std::endl;
+	start = std::chrono::system_clock::now();
+	Jobs initGraphTestJobs(4, Test18a, nullptr);
+	end = std::chrono::system_clock::now();
+	elapsed = end - start;
+	std::cout << "Init graph test completed in " << elapsed.count() << "ns" << std::endl;
+
+	// Elastic thread test
+	std::cout << "Starting elastic thread test" << std::endl;
+	ElasticThreadPolicy elasticPolicy;
+	elasticPolicy.m_enabled = true;
+	elasticPolicy.m_minThreads = 1;
+	elasticPolicy.m_updateInterval = std::chrono::milliseconds(10);
+	Jobs::SetElasticPolicy(elasticPolicy);
+	start = std::chrono::system_clock::now();
+	Jobs elasticTest(4, Test20a, &elasticPolicy);
+	end = std::chrono::system_clock::now();
+	elapsed = end - start;
+	std::cout << "Elastic thread test completed in " << elapsed.count() << "ns" << std::endl;
+
 	return 0;
 }
\ No newline at end of file
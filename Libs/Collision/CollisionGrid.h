@@ -1,5 +1,5 @@
 #pragma once
-#include <vector>
+#include <Memory/HugePageAllocator.h>
 
 // A 3D grid of cells, where each cell holds information about three of its sides.
 // To be as memory-efficient as possible, cells are 4-bit structures where each bit represents:
@@ -84,8 +84,8 @@ public:
     }
 
 private:
-    /** Array of blocks (2x2x2 cells), stored in groups of 4x1x4 for cache efficiency */
-    std::vector<int> m_blocks;
+    /** Array of blocks (2x2x2 cells), stored in groups of 4x1x4 for cache efficiency. Backed by huge pages where possible, as big grids span many pages. */
+    HugePageVector<int> m_blocks;
 
 	int m_width = 0;
 	int m_height = 0;
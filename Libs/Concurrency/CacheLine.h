@@ -0,0 +1,5 @@
+#pragma once
+#include <cstddef>
+
+/** Size of a cache line. Data written by different threads should be at least this far apart, so they don't contend on the same line. */
+constexpr size_t CACHE_LINE_SIZE = 64;
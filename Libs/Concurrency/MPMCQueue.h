@@ -0,0 +1,195 @@
+#pragma once
+#include "CacheLine.h"
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+/**
+ * MPMCQueue
+ * A bounded queue that any thread may push to or pop from, without locking (Vyukov's bounded MPMC queue).
+ * Each slot has a sequence number saying which lap of the ring it is ready for, so pushing or popping an item only needs one
+ * compare-and-swap on the tail or head. Batches claim several slots with a single compare-and-swap.
+ * T must be default-constructible and copyable or movable.
+ * NOTE: Size MUST be a power-of-two, and at least 2
+ */
+template<typename T>
+class MPMCQueue
+{
+public:
+	MPMCQueue(size_t size)
+		: m_slots(size)
+		, m_mask(size - 1u)
+	{
+		_ASSERT(size >= 2 && (size & m_mask) == 0);
+		for (size_t i = 0; i < size; i++)
+		{
+			m_slots[i].m_sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+	MPMCQueue(const MPMCQueue&) = delete;
+	MPMCQueue& operator=(const MPMCQueue&) = delete;
+
+	/** Pushes an item to the back of the queue. May be called from any thread. Returns false if the queue is full. */
+	bool TryPush(const T& item)
+	{
+		return TryPushBatch(&item, 1) == 1;
+	}
+
+	/** Moves an item to the back of the queue. May be called from any thread. Returns false (leaving item alone) if the queue is full. */
+	bool TryPush(T&& item)
+	{
+		uint64_t pos;
+		if (ClaimPushSlots(1, pos) == 0)
+		{
+			return false;
+		}
+		Slot& slot = m_slots[pos & m_mask];
+		slot.m_item = std::move(item);
+		// Publish the item to poppers
+		slot.m_sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	/** Pops the oldest item from the queue. May be called from any thread. Returns false if the queue is empty. */
+	bool TryPop(T& itemOut)
+	{
+		return TryPopBatch(&itemOut, 1) == 1;
+	}
+
+	/** Pushes up to count items in order, as long as there is space for them. May be called from any thread. Returns the number pushed. */
+	size_t TryPushBatch(const T* items, size_t count)
+	{
+		uint64_t pos;
+		size_t claimed = ClaimPushSlots(count, pos);
+		for (size_t i = 0; i < claimed; i++)
+		{
+			Slot& slot = m_slots[(pos + i) & m_mask];
+			slot.m_item = items[i];
+			slot.m_sequence.store(pos + i + 1, std::memory_order_release);
+		}
+		return claimed;
+	}
+
+	/** Pops up to maxCount of the oldest items, in order. May be called from any thread. Returns the number popped. */
+	size_t TryPopBatch(T* itemsOut, size_t maxCount)
+	{
+		uint64_t pos;
+		size_t claimed = ClaimPopSlots(maxCount, pos);
+		for (size_t i = 0; i < claimed; i++)
+		{
+			Slot& slot = m_slots[(pos + i) & m_mask];
+			itemsOut[i] = std::move(slot.m_item);
+			// Release the slot for the next lap
+			slot.m_sequence.store(pos + i + m_mask + 1, std::memory_order_release);
+		}
+		return claimed;
+	}
+
+	/** Returns true if the queue appears empty. The result may be stale by the time it is used. */
+	bool IsEmpty() const { return m_head.load(std::memory_order_relaxed) >= m_tail.load(std::memory_order_relaxed); }
+	/** Returns the approximate number of items in the queue. The result may be stale by the time it is used. */
+	size_t GetApproxSize() const
+	{
+		uint64_t head = m_head.load(std::memory_order_relaxed);
+		uint64_t tail = m_tail.load(std::memory_order_relaxed);
+		return tail > head ? (size_t)(tail - head) : 0;
+	}
+	/** Returns the maximum number of items the queue can hold */
+	size_t GetCapacity() const { return m_slots.size(); }
+
+private:
+	struct Slot
+	{
+		std::atomic<uint64_t> m_sequence = 0;
+		T m_item = T();
+	};
+
+	/**
+	 * Claims up to count free slots at the tail, and returns the number claimed and the position of the first.
+	 * A free slot stays free until someone moves the tail past it, so checking the slots before the compare-and-swap is enough.
+	 */
+	size_t ClaimPushSlots(size_t count, uint64_t& posOut)
+	{
+		uint64_t pos = m_tail.load(std::memory_order_relaxed);
+		while (true)
+		{
+			size_t available = 0;
+			bool lostRace = false;
+			while (available < count)
+			{
+				uint64_t seq = m_slots[(pos + available) & m_mask].m_sequence.load(std::memory_order_acquire);
+				int64_t diff = (int64_t)seq - (int64_t)(pos + available);
+				if (diff != 0)
+				{
+					// diff < 0: the slot still holds an item from the previous lap, so the queue is full from here.
+					// diff > 0 on the first slot: another thread has already claimed it.
+					lostRace = diff > 0 && available == 0;
+					break;
+				}
+				available++;
+			}
+
+			if (available == 0)
+			{
+				if (!lostRace)
+				{
+					return 0;
+				}
+				pos = m_tail.load(std::memory_order_relaxed);
+			}
+			else if (m_tail.compare_exchange_weak(pos, pos + available, std::memory_order_relaxed))
+			{
+				posOut = pos;
+				return available;
+			}
+		}
+	}
+
+	/** Claims up to count published slots at the head, and returns the number claimed and the position of the first */
+	size_t ClaimPopSlots(size_t count, uint64_t& posOut)
+	{
+		uint64_t pos = m_head.load(std::memory_order_relaxed);
+		while (true)
+		{
+			size_t available = 0;
+			bool lostRace = false;
+			while (available < count)
+			{
+				uint64_t seq = m_slots[(pos + available) & m_mask].m_sequence.load(std::memory_order_acquire);
+				int64_t diff = (int64_t)seq - (int64_t)(pos + available + 1);
+				if (diff != 0)
+				{
+					// diff < 0: the slot hasn't been published yet, so the queue is empty from here.
+					// diff > 0 on the first slot: another thread has already taken it.
+					lostRace = diff > 0 && available == 0;
+					break;
+				}
+				available++;
+			}
+
+			if (available == 0)
+			{
+				if (!lostRace)
+				{
+					return 0;
+				}
+				pos = m_head.load(std::memory_order_relaxed);
+			}
+			else if (m_head.compare_exchange_weak(pos, pos + available, std::memory_order_relaxed))
+			{
+				posOut = pos;
+				return available;
+			}
+		}
+	}
+
+private:
+	/** List of slots */
+	std::vector<Slot> m_slots;
+	/** Mask used to wrap the head and tail indices. This requires the size to be a power-of-two. */
+	const uint64_t m_mask;
+	/** Index of the next item to pop. Kept on its own cache line so poppers and pushers don't contend. */
+	alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> m_head = 0;
+	/** Index of the next free slot to push to */
+	alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> m_tail = 0;
+};
@@ -0,0 +1,138 @@
+#pragma once
+#include "CacheLine.h"
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+/** Base class for items that can be queued in an MPSCQueue. An item can only be in one queue at a time. */
+struct MPSCQueueNode
+{
+	std::atomic<MPSCQueueNode*> m_next = nullptr;
+};
+
+/**
+ * MPSCQueue
+ * An intrusive queue that any thread may push to, but only one consumer thread may pop from (Vyukov's intrusive MPSC queue).
+ * Items link themselves through their MPSCQueueNode, so the queue never allocates and is only bounded by the items that exist.
+ * Pushing is a single atomic exchange, however many items are pushed at once, and never fails.
+ *
+ * A push that has swapped itself in but not yet linked to the previous item hides everything after it, so TryPop() may
+ * briefly return nullptr while the queue isn't empty. Consumers should treat nullptr as "nothing yet", not "nothing ever".
+ * T must derive from MPSCQueueNode. Items must outlive their time in the queue.
+ */
+template<typename T>
+class MPSCQueue
+{
+	static_assert(std::is_base_of_v<MPSCQueueNode, T>, "MPSCQueue items must derive from MPSCQueueNode");
+
+public:
+	MPSCQueue()
+		: m_head(&m_stub)
+		, m_tail(&m_stub)
+	{ }
+	MPSCQueue(const MPSCQueue&) = delete;
+	MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+	/** Pushes an item to the back of the queue. May be called from any thread. */
+	void Push(T* item)
+	{
+		PushNodes(item, item);
+	}
+
+	/** Pushes count items to the back of the queue, in order, with a single atomic exchange. May be called from any thread. */
+	void PushBatch(T* const* items, size_t count)
+	{
+		if (count == 0)
+		{
+			return;
+		}
+		// Link the batch up before publishing it
+		for (size_t i = 0; i + 1 < count; i++)
+		{
+			items[i]->m_next.store(items[i + 1], std::memory_order_relaxed);
+		}
+		PushNodes(items[0], items[count - 1]);
+	}
+
+	/** Pops the oldest item from the queue. Consumer only. Returns nullptr if the queue is empty, or a push is in progress. */
+	T* TryPop()
+	{
+		MPSCQueueNode* head = m_head;
+		MPSCQueueNode* next = head->m_next.load(std::memory_order_acquire);
+		// Skip over the stub
+		if (head == &m_stub)
+		{
+			if (next == nullptr)
+			{
+				return nullptr;
+			}
+			m_head = next;
+			head = next;
+			next = next->m_next.load(std::memory_order_acquire);
+		}
+
+		if (next != nullptr)
+		{
+			m_head = next;
+			return static_cast<T*>(head);
+		}
+
+		// head is the last linked item. If it isn't the tail, a push is in progress and hasn't linked itself to head yet.
+		if (head != m_tail.load(std::memory_order_acquire))
+		{
+			return nullptr;
+		}
+		// Push the stub behind head, so head can be taken without leaving the queue without a node
+		PushNodes(&m_stub, &m_stub);
+		next = head->m_next.load(std::memory_order_acquire);
+		if (next != nullptr)
+		{
+			m_head = next;
+			return static_cast<T*>(head);
+		}
+		return nullptr;
+	}
+
+	/** Pops up to maxCount of the oldest items, in order. Consumer only. Returns the number popped. */
+	size_t TryPopBatch(T** itemsOut, size_t maxCount)
+	{
+		size_t numPopped = 0;
+		while (numPopped < maxCount)
+		{
+			T* item = TryPop();
+			if (item == nullptr)
+			{
+				break;
+			}
+			itemsOut[numPopped++] = item;
+		}
+		return numPopped;
+	}
+
+	/** Returns true if the queue appears empty. The result may be stale by the time it is used. Consumer only. */
+	bool IsEmpty() const
+	{
+		// Only the stub is left
+		return m_head == &m_stub && m_tail.load(std::memory_order_acquire) == &m_stub;
+	}
+
+private:
+	/** Appends an already linked chain of nodes from first to last */
+	void PushNodes(MPSCQueueNode* first, MPSCQueueNode* last)
+	{
+		last->m_next.store(nullptr, std::memory_order_relaxed);
+		MPSCQueueNode* prev = m_tail.exchange(last, std::memory_order_acq_rel);
+		// Until this store, consumers can't see past prev
+		prev->m_next.store(first, std::memory_order_release);
+	}
+
+private:
+	// Consumer's cache line
+	/** Oldest node, which the consumer pops from. Consumer only. */
+	alignas(CACHE_LINE_SIZE) MPSCQueueNode* m_head;
+	/** Placeholder node, so the queue is never left without a node */
+	MPSCQueueNode m_stub;
+
+	/** Newest node, which producers push after */
+	alignas(CACHE_LINE_SIZE) std::atomic<MPSCQueueNode*> m_tail;
+};
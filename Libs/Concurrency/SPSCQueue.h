@@ -0,0 +1,139 @@
+#pragma once
+#include "CacheLine.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+/**
+ * SPSCQueue
+ * A bounded ring buffer for passing items from one producer thread to one consumer thread, without locking.
+ * Each side only writes its own index, and keeps a cached copy of the other side's index so it only reads the shared one
+ * (and takes a cache miss) when the cached copy says the queue is full or empty. Batches publish all their items at once.
+ * T must be default-constructible and copyable or movable.
+ * NOTE: Size MUST be a power-of-two, and at least 2
+ */
+template<typename T>
+class SPSCQueue
+{
+public:
+	SPSCQueue(size_t size)
+		: m_items(size)
+		, m_mask(size - 1u)
+	{
+		_ASSERT(size >= 2 && (size & m_mask) == 0);
+	}
+	SPSCQueue(const SPSCQueue&) = delete;
+	SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+	/** Pushes an item to the back of the queue. Producer only. Returns false if the queue is full. */
+	bool TryPush(const T& item)
+	{
+		return TryPushBatch(&item, 1) == 1;
+	}
+
+	/** Moves an item to the back of the queue. Producer only. Returns false (leaving item alone) if the queue is full. */
+	bool TryPush(T&& item)
+	{
+		uint64_t tail = m_tail.load(std::memory_order_relaxed);
+		if (GetFreeSlots(tail) == 0)
+		{
+			return false;
+		}
+		m_items[tail & m_mask] = std::move(item);
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	/** Pops the oldest item from the queue. Consumer only. Returns false if the queue is empty. */
+	bool TryPop(T& itemOut)
+	{
+		return TryPopBatch(&itemOut, 1) == 1;
+	}
+
+	/** Pushes up to count items in order, as long as there is space for them. Producer only. Returns the number pushed. */
+	size_t TryPushBatch(const T* items, size_t count)
+	{
+		uint64_t tail = m_tail.load(std::memory_order_relaxed);
+		size_t numToPush = std::min(count, GetFreeSlots(tail));
+		for (size_t i = 0; i < numToPush; i++)
+		{
+			m_items[(tail + i) & m_mask] = items[i];
+		}
+		if (numToPush > 0)
+		{
+			m_tail.store(tail + numToPush, std::memory_order_release);
+		}
+		return numToPush;
+	}
+
+	/** Pops up to maxCount of the oldest items, in order. Consumer only. Returns the number popped. */
+	size_t TryPopBatch(T* itemsOut, size_t maxCount)
+	{
+		uint64_t head = m_head.load(std::memory_order_relaxed);
+		size_t numToPop = std::min(maxCount, GetFilledSlots(head));
+		for (size_t i = 0; i < numToPop; i++)
+		{
+			itemsOut[i] = std::move(m_items[(head + i) & m_mask]);
+		}
+		if (numToPop > 0)
+		{
+			m_head.store(head + numToPop, std::memory_order_release);
+		}
+		return numToPop;
+	}
+
+	/** Returns true if the queue appears empty. The result may be stale by the time it is used. */
+	bool IsEmpty() const { return m_head.load(std::memory_order_relaxed) >= m_tail.load(std::memory_order_relaxed); }
+	/** Returns the approximate number of items in the queue. The result may be stale by the time it is used. */
+	size_t GetApproxSize() const
+	{
+		uint64_t head = m_head.load(std::memory_order_relaxed);
+		uint64_t tail = m_tail.load(std::memory_order_relaxed);
+		return tail > head ? (size_t)(tail - head) : 0;
+	}
+	/** Returns the maximum number of items the queue can hold */
+	size_t GetCapacity() const { return m_items.size(); }
+
+private:
+	/** Returns the number of slots the producer can fill, only reloading the head if the cached copy says the queue is full */
+	size_t GetFreeSlots(uint64_t tail)
+	{
+		size_t freeSlots = m_items.size() - (size_t)(tail - m_cachedHead);
+		if (freeSlots == 0)
+		{
+			m_cachedHead = m_head.load(std::memory_order_acquire);
+			freeSlots = m_items.size() - (size_t)(tail - m_cachedHead);
+		}
+		return freeSlots;
+	}
+
+	/** Returns the number of items the consumer can take, only reloading the tail if the cached copy says the queue is empty */
+	size_t GetFilledSlots(uint64_t head)
+	{
+		size_t filledSlots = (size_t)(m_cachedTail - head);
+		if (filledSlots == 0)
+		{
+			m_cachedTail = m_tail.load(std::memory_order_acquire);
+			filledSlots = (size_t)(m_cachedTail - head);
+		}
+		return filledSlots;
+	}
+
+private:
+	std::vector<T> m_items;
+	/** Mask used to wrap the head and tail indices. This requires the size to be a power-of-two. */
+	const uint64_t m_mask;
+
+	// Consumer's cache line
+	/** Index of the next item to pop */
+	alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> m_head = 0;
+	/** Consumer's copy of m_tail */
+	uint64_t m_cachedTail = 0;
+
+	// Producer's cache line
+	/** Index of the next free slot to push to */
+	alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> m_tail = 0;
+	/** Producer's copy of m_head */
+	uint64_t m_cachedHead = 0;
+};
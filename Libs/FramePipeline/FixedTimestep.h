@@ -0,0 +1,60 @@
+#pragma once
+#include <Diagnostic/Assert.h>
+#include <algorithm>
+#include <cstdint>
+
+/**
+ * FixedTimestep
+ * Turns variable frame times into a whole number of fixed-length simulation steps, so the simulation behaves the same at any frame rate.
+ * Each frame, call Advance() with the frame's delta time and run the number of steps it returns. Time left over carries into the next
+ * frame; GetInterpolationAlpha() says how far between the last two steps the frame is, so what's drawn can be blended between them.
+ *
+ * If the simulation can't keep up, every frame would need more steps than the last (a spiral of death). To stop that, at most
+ * maxStepsPerFrame steps are run per frame, and time beyond that is dropped: the simulation slows down instead of the frame rate.
+ */
+class FixedTimestep
+{
+public:
+	FixedTimestep(double stepTime, int maxStepsPerFrame)
+		: m_stepTime(stepTime)
+		, m_maxStepsPerFrame(maxStepsPerFrame)
+	{
+		ASSERT(stepTime > 0.0 && maxStepsPerFrame > 0);
+	}
+
+	/** Adds a frame's time (in seconds), and returns the number of steps to run for it */
+	int Advance(double deltaTime)
+	{
+		m_accumulatedTime += std::max(deltaTime, 0.0);
+		double maxTime = m_stepTime * m_maxStepsPerFrame;
+		if (m_accumulatedTime >= maxTime + m_stepTime)
+		{
+			// Keep the fraction of a step, so interpolation carries on smoothly
+			double droppedSteps = (double)(int64_t)((m_accumulatedTime - maxTime) / m_stepTime);
+			m_droppedTime += droppedSteps * m_stepTime;
+			m_accumulatedTime -= droppedSteps * m_stepTime;
+		}
+
+		int numSteps = std::min((int)(m_accumulatedTime / m_stepTime), m_maxStepsPerFrame);
+		m_accumulatedTime -= numSteps * m_stepTime;
+		m_totalSteps += numSteps;
+		return numSteps;
+	}
+
+	/** Returns how far the frame is between the last step and the next, from 0 to 1 */
+	double GetInterpolationAlpha() const { return std::clamp(m_accumulatedTime / m_stepTime, 0.0, 1.0); }
+	/** Returns the simulated time per step, in seconds */
+	double GetStepTime() const { return m_stepTime; }
+	/** Returns the number of steps run since the start */
+	int64_t GetTotalSteps() const { return m_totalSteps; }
+	/** Returns the time (in seconds) dropped because frames took too long to keep up with */
+	double GetDroppedTime() const { return m_droppedTime; }
+
+private:
+	const double m_stepTime;
+	const int m_maxStepsPerFrame;
+	/** Time that hasn't been simulated yet */
+	double m_accumulatedTime = 0.0;
+	int64_t m_totalSteps = 0;
+	double m_droppedTime = 0.0;
+};
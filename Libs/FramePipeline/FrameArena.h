@@ -0,0 +1,178 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+/** Memory usage of a FrameArena */
+struct FrameArenaStats
+{
+	/** Size of the arena's main block */
+	size_t m_capacity = 0;
+	/** Bytes allocated from the arena since it was last reset */
+	size_t m_usedBytes = 0;
+	/** Bytes that didn't fit in the main block since the arena was last reset */
+	size_t m_overflowBytes = 0;
+	/** Largest number of bytes allocated from the arena in one frame */
+	size_t m_highWaterBytes = 0;
+};
+
+/**
+ * FrameArena
+ * A bump allocator for memory that only needs to live as long as one frame. Any thread may allocate from it without locking,
+ * and everything is freed at once by Reset() when the frame starts again. Individual allocations are never freed.
+ * If a frame allocates more than the main block holds, the rest comes from overflow blocks (under a lock), and the main block
+ * grows at the next Reset() to fit what was used.
+ */
+class FrameArena
+{
+public:
+	explicit FrameArena(size_t capacity)
+		: m_capacity(capacity)
+		, m_block(std::make_unique<char[]>(capacity))
+	{ }
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+	/** Moves an arena that isn't in use yet */
+	FrameArena(FrameArena&& other) noexcept
+		: m_capacity(other.m_capacity)
+		, m_block(std::move(other.m_block))
+		, m_offset(other.m_offset.load())
+		, m_highWaterBytes(other.m_highWaterBytes)
+	{ }
+
+	/** Allocates frame-lifetime memory. May be called from any thread. */
+	void* Allocate(size_t size, size_t alignment)
+	{
+		const uintptr_t base = reinterpret_cast<uintptr_t>(m_block.get());
+		size_t offset = m_offset.load(std::memory_order_relaxed);
+		while (true)
+		{
+			size_t alignedOffset = ((base + offset + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+			if (alignedOffset + size > m_capacity)
+			{
+				return AllocateOverflow(size, alignment);
+			}
+			if (m_offset.compare_exchange_weak(offset, alignedOffset + size, std::memory_order_relaxed))
+			{
+				return m_block.get() + alignedOffset;
+			}
+		}
+	}
+
+	/** Allocates frame-lifetime memory for count objects of type T, without constructing them */
+	template<typename T>
+	T* Allocate(size_t count)
+	{
+		return static_cast<T*>(Allocate(count * sizeof(T), alignof(T)));
+	}
+
+	/**
+	 * Frees everything allocated from this arena. Only call once nothing is using the frame's memory, e.g. at the start of a frame.
+	 * Grows the main block if the last frame overflowed it.
+	 */
+	void Reset()
+	{
+		size_t usedBytes = m_offset.load(std::memory_order_relaxed) + m_overflowBytes;
+		m_highWaterBytes = std::max(m_highWaterBytes, usedBytes);
+		if (m_overflowBytes > 0)
+		{
+			// Round up so that slowly growing frames don't reallocate every time
+			size_t newCapacity = std::max(m_capacity, (size_t)1);
+			while (newCapacity < m_highWaterBytes)
+			{
+				newCapacity *= 2;
+			}
+			m_block = std::make_unique<char[]>(newCapacity);
+			m_capacity = newCapacity;
+		}
+		m_overflowBlocks.clear();
+		m_overflowBytes = 0;
+		m_offset.store(0, std::memory_order_relaxed);
+	}
+
+	/** Returns memory usage. Only accurate while no other thread is allocating. */
+	FrameArenaStats GetStats() const
+	{
+		FrameArenaStats stats;
+		stats.m_capacity = m_capacity;
+		stats.m_overflowBytes = m_overflowBytes;
+		stats.m_usedBytes = m_offset.load(std::memory_order_relaxed) + m_overflowBytes;
+		stats.m_highWaterBytes = std::max(m_highWaterBytes, stats.m_usedBytes);
+		return stats;
+	}
+
+private:
+	/** Allocates memory that didn't fit in the main block */
+	void* AllocateOverflow(size_t size, size_t alignment)
+	{
+		std::lock_guard<std::mutex> lock(m_overflowMutex);
+		m_overflowBlocks.emplace_back(std::make_unique<char[]>(size + alignment - 1));
+		m_overflowBytes += size;
+		uintptr_t address = reinterpret_cast<uintptr_t>(m_overflowBlocks.back().get());
+		return reinterpret_cast<void*>((address + alignment - 1) & ~(uintptr_t)(alignment - 1));
+	}
+
+private:
+	size_t m_capacity;
+	std::unique_ptr<char[]> m_block;
+	/** Offset of the first free byte in m_block */
+	std::atomic<size_t> m_offset = 0;
+	size_t m_highWaterBytes = 0;
+
+	/** Allocations that didn't fit in m_block, freed on Reset() */
+	std::vector<std::unique_ptr<char[]>> m_overflowBlocks;
+	size_t m_overflowBytes = 0;
+	std::mutex m_overflowMutex;
+};
+
+/**
+ * STL allocator that allocates from a FrameArena, so containers can hold frame-lifetime data.
+ * Deallocation does nothing, as the arena frees everything when it is reset. A container using this must be cleared or
+ * reassigned before its arena is reset.
+ * A default-constructed allocator has no arena and uses the heap instead, so containers can exist before the frame's arena does.
+ */
+template<typename T>
+struct FrameArenaAllocator
+{
+	using value_type = T;
+	using propagate_on_container_copy_assignment = std::true_type;
+	using propagate_on_container_move_assignment = std::true_type;
+	using propagate_on_container_swap = std::true_type;
+
+	FrameArenaAllocator() = default;
+	explicit FrameArenaAllocator(FrameArena& arena) : m_arena(&arena) { }
+	template<typename U>
+	FrameArenaAllocator(const FrameArenaAllocator<U>& other) : m_arena(other.m_arena) { }
+
+	T* allocate(size_t count)
+	{
+		if (m_arena == nullptr)
+		{
+			return static_cast<T*>(::operator new(count * sizeof(T)));
+		}
+		return m_arena->Allocate<T>(count);
+	}
+
+	void deallocate(T* ptr, size_t)
+	{
+		if (m_arena == nullptr)
+		{
+			::operator delete(ptr);
+		}
+	}
+
+	template<typename U>
+	bool operator==(const FrameArenaAllocator<U>& other) const { return m_arena == other.m_arena; }
+	template<typename U>
+	bool operator!=(const FrameArenaAllocator<U>& other) const { return m_arena != other.m_arena; }
+
+	FrameArena* m_arena = nullptr;
+};
+
+/** A vector whose memory lives as long as the frame */
+template<typename T>
+using FrameVector = std::vector<T, FrameArenaAllocator<T>>;
@@ -1,5 +1,9 @@
 #pragma once
+#include "FrameArena.h"
+#include "FrameTelemetry.h"
+#include <chrono>
 #include <stdint.h>
+#include <vector>
 
 struct GLFWwindow;
 
@@ -13,8 +17,9 @@ struct FrameData
 {
 public:
 	/** Constructs a new FrameData<DATA> object. defaultData is copied into this frame's data object. */
-	FrameData(int id, DATA defaultData)
+	FrameData(int id, DATA defaultData, size_t arenaSize)
 		: m_myId(id)
+		, m_arena(arenaSize)
 		, m_data(defaultData)
 	{ }
 
@@ -25,10 +30,26 @@ public:
 	 META DATA
 	**********/
 
-	/** The global ID of this frame. */
+	/** The global ID of this frame, counting up from 0. Stages index their per-frame state with it. */
 	const int m_myId;
-	/** Debug - Is this frame currently being processed? */
-	bool m_active = false;
+	/** Number of this trip through the pipeline, counting every frame. Set when the frame enters the first stage. */
+	int64_t m_frameNumber = -1;
+	/** When the frame entered the first stage */
+	std::chrono::high_resolution_clock::time_point m_beginTime;
+	/**
+	 * Whether the frame was dropped under load on this trip through the pipeline. Skippable stages don't run dropped frames, and other
+	 * stages may leave out work that only matters if the frame is shown. Only skippable stages and DropFrameIfOverloaded() set it, so
+	 * stages on parallel branches shouldn't do either.
+	 */
+	bool m_dropped = false;
+	/** Timings for each stage on this trip through the pipeline, indexed by stage */
+	std::vector<FrameStageTiming> m_stageTimings;
+
+	/**
+	 * Memory that lives as long as this frame. Jobs in any stage may allocate from it. It is reset when the frame starts again,
+	 * so anything allocated from it (e.g. FrameVectors in m_data) must be cleared before then.
+	 */
+	FrameArena m_arena;
 
 	/***********
 	 FRAME DATA
@@ -1,14 +1,89 @@
 #pragma once
 #include "FrameStageRunner.h"
+#include "FrameTelemetry.h"
 #include <Diagnostic/Assert.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <mutex>
 
 template<typename DATA>
 struct FrameData;
 
+/**
+ * Settings for automatically changing the number of frames in flight.
+ * More frames in flight keep every stage busy, but each frame spends longer waiting between stages, which adds input-to-photon latency.
+ * Every m_updateInterval, the pipeline measures how long each stage takes per frame. It aims for enough frames to keep the slowest stage
+ * busy, but no more than can get through the slowest stage within m_targetLatency, and moves one frame at a time towards that.
+ */
+struct FramesInFlightPolicy
+{
+	/** Whether the number of frames in flight is adjusted automatically */
+	bool m_enabled = false;
+	/** Minimum number of frames in flight */
+	int m_minFrames = 1;
+	/** Frames to keep in flight on top of what the stage times call for, to absorb frames that take longer than usual */
+	int m_extraFrames = 0;
+	/** Longest time a frame should take to get through the pipeline */
+	std::chrono::microseconds m_targetLatency = std::chrono::milliseconds(50);
+	/** How often to re-evaluate the number of frames in flight */
+	std::chrono::milliseconds m_updateInterval = std::chrono::milliseconds(250);
+};
+
+/** A change in the number of frames in flight, and the measurements that caused it */
+struct FramesInFlightChange
+{
+	/** Frame that ended just before the change */
+	int64_t m_frameNumber = 0;
+	int m_oldFrames = 0;
+	int m_newFrames = 0;
+	/** Average time per frame of the slowest stage, divided by the number of frames it processes at once */
+	double m_slowestStageMS = 0.0;
+	/** Average time per frame of the stages along the slowest path through the pipeline */
+	double m_totalStageMS = 0.0;
+	/** Average time from a frame entering the pipeline to leaving it */
+	double m_latencyMS = 0.0;
+};
+
+/**
+ * Settings for dropping frames when the pipeline can't keep up, so latency stays bounded instead of growing with the number of frames
+ * queued. A stage has back-pressure when more than m_maxQueuedFrames frames are waiting for it. A frame reaching a skippable stage (or
+ * a stage that calls DropFrameIfOverloaded()) while that stage or any after it has back-pressure would only wait behind newer work, so
+ * it is dropped: later skippable stages pass it straight on, and the frames behind it are shown instead.
+ * Frames that took longer than m_maxFrameAge to get there are dropped too, as they'd be out of date by the time they were shown.
+ */
+struct FrameOverloadPolicy
+{
+	/** Whether frames are dropped under load */
+	bool m_enabled = false;
+	/** Most frames that may wait for a stage before it has back-pressure. Dropped frames don't count. */
+	int m_maxQueuedFrames = 0;
+	/** Frames older than this are dropped as stale, or never if zero */
+	std::chrono::microseconds m_maxFrameAge = std::chrono::microseconds(0);
+	/** Frames aren't dropped once this many frames in a row have been, so something is still shown however overloaded the pipeline is */
+	int m_maxConsecutiveDrops = 2;
+};
+
+/** A link from one stage to another, by their indices in the stages passed to FramePipeline::Init() */
+struct FrameStageLink
+{
+	int m_from = 0;
+	int m_to = 0;
+};
+
 /**
  * The pipeline through which a frame ends up drawn to the screen. Multiple frames can be executed in parallel.
  * Create by passing a vector of stages in order into Init().
  * Call Start() to begin pushing frames through the pipeline. When they complete, they will return to the start of the pipeline.
+ * Stages that don't depend on each other can run side by side on the same frame, by also passing the links between stages to Init().
+ * Frames enter at the first stage, which may send them to several stages, and leave from the last, which waits for them to get
+ * there along every path.
+ * Every frame's time in each stage is kept in a FrameTelemetry, to find the stage that limits the frame rate.
+ * Init() allocates the most frames that can be in flight. With a FramesInFlightPolicy, frames that aren't needed are parked when they
+ * leave the pipeline, and sent round again when they are.
+ * With a FrameOverloadPolicy, frames are dropped when a stage falls behind, and skip the expensive stages that would have shown them.
  *
  * Stages that may be useful:
  * - Frame start
@@ -22,35 +97,96 @@ struct FrameData;
 template<typename DATA>
 struct FramePipeline
 {
-	void Init(std::vector<std::unique_ptr<FrameStageRunner<DATA>>>&& pipelineStages, int numSimultaneousFrames, const DATA& defaultData)
+	/** Default size of each frame's arena. It grows if a frame allocates more than this. */
+	static constexpr size_t DEFAULT_FRAME_ARENA_SIZE = 1024 * 1024;
+	/** Number of changes to the frames in flight that are kept for GetFramesInFlightChanges() */
+	static constexpr size_t MAX_FRAMES_IN_FLIGHT_CHANGES = 32;
+	/**
+	 * How far over a whole number of frames the stage times must be before another frame in flight is added. Stage times are noisy, and
+	 * measure longer with fewer frames in flight, so without this the pipeline flips between two counts.
+	 */
+	static constexpr double FRAMES_IN_FLIGHT_ROUNDING_SLACK = 0.25;
+
+	void Init(std::vector<std::unique_ptr<FrameStageRunner<DATA>>>&& pipelineStages, int numSimultaneousFrames, const DATA& defaultData,
+		size_t frameArenaSize = DEFAULT_FRAME_ARENA_SIZE)
+	{
+		// Link each stage to the next
+		std::vector<FrameStageLink> links;
+		for (int i = 0; i < (int)pipelineStages.size() - 1; i++)
+		{
+			links.push_back({ i, i + 1 });
+		}
+		Init(std::move(pipelineStages), links, numSimultaneousFrames, defaultData, frameArenaSize);
+	}
+
+	/**
+	 * Initialises a pipeline shaped as a graph. Links must go from earlier stages to later ones. Every stage but the first must have a link
+	 * to it, and every stage but the last must have a link from it.
+	 */
+	void Init(std::vector<std::unique_ptr<FrameStageRunner<DATA>>>&& pipelineStages, const std::vector<FrameStageLink>& links, int numSimultaneousFrames,
+		const DATA& defaultData, size_t frameArenaSize = DEFAULT_FRAME_ARENA_SIZE)
 	{
 		m_stages = std::move(pipelineStages);
 
-		// Link each stage to the next
-		for (int i = 0; i < m_stages.size() - 1; i++)
+		// Link the stages
+		m_previousStages.resize(m_stages.size());
+		std::vector<int> numNextStages(m_stages.size(), 0);
+		for (const FrameStageLink& link : links)
+		{
+			ASSERT(link.m_from >= 0 && link.m_from < link.m_to && link.m_to < (int)m_stages.size());
+			m_stages[link.m_from]->AddNextStage(m_stages[link.m_to].get());
+			m_previousStages[link.m_to].push_back(link.m_from);
+			numNextStages[link.m_from]++;
+		}
+		for (int i = 0; i < m_stages.size(); i++)
+		{
+			ASSERT(i == 0 || !m_previousStages[i].empty());
+			ASSERT(i == m_stages.size() - 1 || numNextStages[i] > 0);
+		}
+		// Final stage loops back to start, through FrameEnded() so frames can be parked
+		ASSERT(m_stages[0]->GetNumPreviousStages() == 0);
+		m_stages[m_stages.size() - 1]->AddNextStage(m_stages[0].get());
+		m_stages[m_stages.size() - 1]->SetFrameEndedCallback([this](FrameData<DATA>& frame) { FrameEnded(frame); });
+		for (int i = 0; i < m_stages.size(); i++)
 		{
-			m_stages[i]->SetNextStage(m_stages[i + 1].get());
+			m_stages[i]->SetDropFrameCheck([this, i](FrameData<DATA>& frame) { return ShouldDropFrame(i, frame); });
 		}
-		// Final stage loops back to start
-		m_stages[m_stages.size() - 1]->SetNextStage(m_stages[0].get());
 
 		// Initialise each stage
+		std::vector<const char*> stageNames;
+		std::vector<int> stageMaxActiveFrames;
 		for (int i = 0; i < m_stages.size(); i++)
 		{
+			m_stages[i]->SetStageIndex(i);
+			m_stages[i]->SetFrameReclaimer(&m_reclaimer, i == 0, i == m_stages.size() - 1);
 			m_stages[i]->InitFrameQueue(numSimultaneousFrames);
-			m_stages[i]->Init();
+			m_stages[i]->InitStage();
+			stageNames.push_back(m_stages[i]->GetName());
+			stageMaxActiveFrames.push_back(m_stages[i]->GetMaxActiveFrames());
 		}
+		m_telemetry.Init(stageNames, stageMaxActiveFrames);
 
 		// Set up frames
 		m_frames.reserve(numSimultaneousFrames);
 		for (int i = 0; i < numSimultaneousFrames; i++)
 		{
-			m_frames.emplace_back(i, defaultData);
+			m_frames.emplace_back(i, defaultData, frameArenaSize);
+			m_frames.back().m_stageTimings.resize(m_stages.size());
 		}
 	}
 
+	/** Sets the policy for automatically adjusting the number of frames in flight. Call before Start(). */
+	void SetFramesInFlightPolicy(const FramesInFlightPolicy& policy) { m_framesInFlightPolicy = policy; }
+	/** Sets the policy for dropping frames under load. Call before Start(). */
+	void SetOverloadPolicy(const FrameOverloadPolicy& policy) { m_overloadPolicy = policy; }
+	/** Sets a function that's called once, as the first frame leaves the pipeline (e.g. to measure start-up time). Call before Start(). */
+	void SetFirstFrameEndedCallback(std::function<void()> callback) { m_firstFrameEndedCallback = std::move(callback); }
+
 	void Start()
 	{
+		m_numActiveFrames = m_targetFrames = (int)m_frames.size();
+		m_lastFramesInFlightUpdateTime = std::chrono::high_resolution_clock::now();
+
 		// Kick off all frames
 		for (int i = 0; i < m_frames.size(); i++)
 		{
@@ -58,8 +194,226 @@ struct FramePipeline
 		}
 	}
 
-	/** Stages that a frame goes through in order */
+	/** Returns the number of frames in the pipeline, not counting parked frames */
+	int GetNumFramesInFlight()
+	{
+		std::lock_guard<std::mutex> lock(m_framesInFlightMutex);
+		return m_numActiveFrames;
+	}
+	/** Returns the timings of the most recent frames to leave the pipeline */
+	FrameTelemetry& GetTelemetry() { return m_telemetry; }
+	/** Returns the most frames that can be in flight */
+	int GetMaxFramesInFlight() const { return (int)m_frames.size(); }
+	/** Returns the number of frames dropped under load since the pipeline started */
+	int64_t GetNumDroppedFrames() const { return m_numDroppedFrames.load(std::memory_order_relaxed); }
+	/**
+	 * Returns the first stage, from firstStage on, with more frames waiting for it than the overload policy allows, or -1 if none have.
+	 * Works whether or not frames are being dropped.
+	 */
+	int GetBackPressureStage(int firstStage = 0) const
+	{
+		for (int i = firstStage; i < (int)m_stages.size(); i++)
+		{
+			if (m_stages[i]->GetNumQueuedFrames() > m_overloadPolicy.m_maxQueuedFrames)
+			{
+				return i;
+			}
+		}
+		return -1;
+	}
+	/** Returns the most recent changes to the number of frames in flight, oldest first */
+	std::vector<FramesInFlightChange> GetFramesInFlightChanges()
+	{
+		std::lock_guard<std::mutex> lock(m_framesInFlightMutex);
+		return std::vector<FramesInFlightChange>(m_framesInFlightChanges.begin(), m_framesInFlightChanges.end());
+	}
+
+private:
+	/** Called as each frame leaves the last stage. Sends it round again, or parks it if there are more frames in flight than needed. */
+	void FrameEnded(FrameData<DATA>& frame)
+	{
+		auto now = std::chrono::high_resolution_clock::now();
+		m_telemetry.Record(frame.m_frameNumber, frame.m_stageTimings);
+		if (m_firstFrameEndedCallback && !m_firstFrameEnded.exchange(true))
+		{
+			m_firstFrameEndedCallback();
+		}
+		if (frame.m_dropped)
+		{
+			m_numDroppedFrames.fetch_add(1, std::memory_order_relaxed);
+			m_numConsecutiveDrops.fetch_add(1, std::memory_order_relaxed);
+		}
+		else
+		{
+			m_numConsecutiveDrops.store(0, std::memory_order_relaxed);
+		}
+		bool parkFrame = false;
+		std::vector<FrameData<DATA>*> framesToRelease;
+		{
+			std::lock_guard<std::mutex> lock(m_framesInFlightMutex);
+			// Dropped frames skip stages, so would hide how long shown frames take
+			if (!frame.m_dropped)
+			{
+				m_totalLatency += now - frame.m_beginTime;
+				m_numLatencySamples++;
+			}
+			if (m_framesInFlightPolicy.m_enabled && now - m_lastFramesInFlightUpdateTime >= m_framesInFlightPolicy.m_updateInterval)
+			{
+				m_lastFramesInFlightUpdateTime = now;
+				UpdateFramesInFlight(frame.m_frameNumber);
+			}
+
+			if (m_numActiveFrames > m_targetFrames)
+			{
+				m_parkedFrames.push_back(&frame);
+				m_numActiveFrames--;
+				parkFrame = true;
+			}
+			while (m_numActiveFrames < m_targetFrames && !m_parkedFrames.empty())
+			{
+				framesToRelease.push_back(m_parkedFrames.back());
+				m_parkedFrames.pop_back();
+				m_numActiveFrames++;
+			}
+		}
+
+		if (!parkFrame)
+		{
+			m_stages[0]->QueueFrame(frame);
+		}
+		for (FrameData<DATA>* releasedFrame : framesToRelease)
+		{
+			m_stages[0]->QueueFrame(*releasedFrame);
+		}
+	}
+
+	/** Decides whether a frame reaching the given stage should be dropped, under the overload policy */
+	bool ShouldDropFrame(int stageIndex, FrameData<DATA>& frame)
+	{
+		if (!m_overloadPolicy.m_enabled)
+		{
+			return false;
+		}
+
+		// So many frames have been dropped that nothing would be shown
+		if (m_numConsecutiveDrops.load(std::memory_order_relaxed) >= m_overloadPolicy.m_maxConsecutiveDrops)
+		{
+			return false;
+		}
+
+		// Newer frames that still need work are waiting further on, so this one would only hold them up. A skippable stage also looks at
+		// its own queue, as skipping the frame frees it for them. Any other stage runs the frame anyway, so dropping it only helps later stages.
+		int firstStage = m_stages[stageIndex]->IsSkippable() ? stageIndex : stageIndex + 1;
+		if (GetBackPressureStage(firstStage) >= 0)
+		{
+			return true;
+		}
+
+		// Too late to be worth showing
+		return m_overloadPolicy.m_maxFrameAge.count() > 0 && std::chrono::high_resolution_clock::now() - frame.m_beginTime > m_overloadPolicy.m_maxFrameAge;
+	}
+
+	/** Moves the target number of frames in flight one step towards what the latest stage times call for. Called with m_framesInFlightMutex locked. */
+	void UpdateFramesInFlight(int64_t frameNumber)
+	{
+		// Wait until every stage has processed a frame, keeping the samples of those that have. Skippable stages may go several updates
+		// without processing one while frames are being dropped.
+		for (int i = 0; i < m_stages.size(); i++)
+		{
+			if (m_stages[i]->GetNumFramesProcessed() == 0)
+			{
+				return;
+			}
+		}
+
+		// Measure the time per frame along the slowest path through the stages, and of the stage that limits the frame rate.
+		// Links only go to later stages, so every stage's previous stages have been measured before it.
+		std::vector<double> pathNS(m_stages.size(), 0.0);
+		double slowestStageNS = 0.0;
+		for (int i = 0; i < m_stages.size(); i++)
+		{
+			std::chrono::nanoseconds processingTime;
+			int64_t numFrames;
+			m_stages[i]->TakeProcessingTime(processingTime, numFrames);
+			double stageNS = (double)processingTime.count() / (double)numFrames;
+			for (int previousStage : m_previousStages[i])
+			{
+				pathNS[i] = std::max(pathNS[i], pathNS[previousStage]);
+			}
+			pathNS[i] += stageNS;
+			slowestStageNS = std::max(slowestStageNS, stageNS / (double)m_stages[i]->GetMaxActiveFrames());
+		}
+		double totalStageNS = pathNS.back();
+		double latencyNS = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(m_totalLatency).count() / (double)std::max<int64_t>(m_numLatencySamples, 1);
+		m_totalLatency = {};
+		m_numLatencySamples = 0;
+		if (slowestStageNS <= 0.0)
+		{
+			return;
+		}
+
+		// Enough frames that the slowest stage never waits for one, but no more than it can get through within the target latency
+		int framesForThroughput = (int)std::ceil(totalStageNS / slowestStageNS - FRAMES_IN_FLIGHT_ROUNDING_SLACK) + m_framesInFlightPolicy.m_extraFrames;
+		double targetLatencyNS = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(m_framesInFlightPolicy.m_targetLatency).count();
+		int framesForLatency = (int)(targetLatencyNS / slowestStageNS);
+		int idealFrames = std::clamp(std::min(framesForThroughput, framesForLatency), std::max(m_framesInFlightPolicy.m_minFrames, 1), (int)m_frames.size());
+
+		int oldTarget = m_targetFrames;
+		if (idealFrames > m_targetFrames)
+		{
+			m_targetFrames++;
+		}
+		else if (idealFrames < m_targetFrames)
+		{
+			m_targetFrames--;
+		}
+		if (m_targetFrames != oldTarget)
+		{
+			FramesInFlightChange change;
+			change.m_frameNumber = frameNumber;
+			change.m_oldFrames = oldTarget;
+			change.m_newFrames = m_targetFrames;
+			change.m_slowestStageMS = slowestStageNS / 1000000.0;
+			change.m_totalStageMS = totalStageNS / 1000000.0;
+			change.m_latencyMS = latencyNS / 1000000.0;
+			m_framesInFlightChanges.push_back(change);
+			if (m_framesInFlightChanges.size() > MAX_FRAMES_IN_FLIGHT_CHANGES)
+			{
+				m_framesInFlightChanges.pop_front();
+			}
+		}
+	}
+
+public:
+	/** Frees data shared between frames once no frame in flight can see it. Declared first so it's destroyed last. */
+	FrameReclaimer m_reclaimer;
+	/** Stages that a frame goes through, in an order that every link goes forwards in */
 	std::vector<std::unique_ptr<FrameStageRunner<DATA>>> m_stages;
 	/** Objects containing transient data for each frame in flight */
 	std::vector<FrameData<DATA>> m_frames;
+
+private:
+	/** Indices of the stages that link to each stage */
+	std::vector<std::vector<int>> m_previousStages;
+	FrameTelemetry m_telemetry;
+	FramesInFlightPolicy m_framesInFlightPolicy;
+	FrameOverloadPolicy m_overloadPolicy;
+	/** Number of frames dropped under load, and the number of frames in a row to leave the pipeline dropped */
+	std::atomic<int64_t> m_numDroppedFrames = 0;
+	std::atomic<int> m_numConsecutiveDrops = 0;
+	/** Called as the first frame leaves the pipeline, if set */
+	std::function<void()> m_firstFrameEndedCallback;
+	std::atomic<bool> m_firstFrameEnded = false;
+	/** Locks everything below */
+	std::mutex m_framesInFlightMutex;
+	/** Number of frames in the pipeline, and the number there should be */
+	int m_numActiveFrames = 0;
+	int m_targetFrames = 0;
+	/** Frames waiting to be sent round the pipeline again */
+	std::vector<FrameData<DATA>*> m_parkedFrames;
+	std::chrono::high_resolution_clock::time_point m_lastFramesInFlightUpdateTime;
+	/** Time taken by frames to get through the pipeline since the last update */
+	std::chrono::high_resolution_clock::duration m_totalLatency = {};
+	int64_t m_numLatencySamples = 0;
+	std::deque<FramesInFlightChange> m_framesInFlightChanges;
 };
\ No newline at end of file
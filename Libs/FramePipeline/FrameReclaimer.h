@@ -0,0 +1,136 @@
+#pragma once
+#include <Diagnostic/Assert.h>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+/**
+ * FrameReclaimer
+ * Epoch-based reclamation for data shared between frames in flight, using frame numbers as epochs.
+ *
+ * To replace shared data, publish the new version first (e.g. by swapping a pointer), then Retire() the old one. The old version
+ * is freed once every frame that had started before it was retired has left the pipeline, as those are the only frames that could
+ * still see it. Frames read shared data without locks or reference counting, but shared pointers must be std::atomic, loaded with
+ * the default (sequentially consistent) ordering.
+ *
+ * The FramePipeline numbers frames and calls BeginFrame() and EndFrame(). Frames may end in any order, and from several threads at once.
+ * Deleters run on whichever thread ends the frame, so anything that must be freed on a particular thread (e.g. GPU resources on the
+ * main thread) should have a deleter that queues a job to do it.
+ */
+class FrameReclaimer
+{
+public:
+	FrameReclaimer() = default;
+	FrameReclaimer(const FrameReclaimer&) = delete;
+	FrameReclaimer& operator=(const FrameReclaimer&) = delete;
+	/** Frees everything still retired. Only destroy once no frames are in flight. */
+	~FrameReclaimer()
+	{
+		for (RetiredObject& retired : m_retired)
+		{
+			retired.m_deleter();
+		}
+	}
+
+	/** Called when a frame enters the pipeline. Returns the frame's number. */
+	int64_t BeginFrame()
+	{
+		// Published before the frame reads any shared data, so Retire() can't miss a frame that sees the old version
+		return m_nextFrameNumber.fetch_add(1, std::memory_order_seq_cst);
+	}
+
+	/** Called when a frame leaves the pipeline. Frees anything that only frames up to the oldest one still in flight could see. */
+	void EndFrame(int64_t frameNumber)
+	{
+		std::vector<std::function<void()>> deleters;
+		{
+			std::lock_guard<std::mutex> lock(m_retiredMutex);
+			ASSERT(frameNumber > m_lastEndedFrame);
+			if (frameNumber != m_lastEndedFrame + 1)
+			{
+				// An older frame is still in flight, so nothing more can be freed until it ends
+				m_framesEndedEarly.push_back(frameNumber);
+				return;
+			}
+
+			// Catch up with any newer frames that ended first
+			m_lastEndedFrame = frameNumber;
+			auto nextEnded = std::find(m_framesEndedEarly.begin(), m_framesEndedEarly.end(), m_lastEndedFrame + 1);
+			while (nextEnded != m_framesEndedEarly.end())
+			{
+				m_framesEndedEarly.erase(nextEnded);
+				m_lastEndedFrame++;
+				nextEnded = std::find(m_framesEndedEarly.begin(), m_framesEndedEarly.end(), m_lastEndedFrame + 1);
+			}
+
+			while (!m_retired.empty() && m_retired.front().m_lastVisibleFrame <= m_lastEndedFrame)
+			{
+				deleters.push_back(std::move(m_retired.front().m_deleter));
+				m_retired.pop_front();
+			}
+		}
+		for (auto& deleter : deleters)
+		{
+			deleter();
+		}
+	}
+
+	/** Runs deleter once no frame in flight can see the retired data. Call after the replacement is published. May be called from any thread. */
+	void Retire(std::function<void()> deleter)
+	{
+		std::lock_guard<std::mutex> lock(m_retiredMutex);
+		// Every frame that has started so far might have seen the old data. Read under the lock so the queue stays in order.
+		int64_t lastVisibleFrame = m_nextFrameNumber.load(std::memory_order_seq_cst) - 1;
+		m_retired.push_back({ lastVisibleFrame, std::move(deleter) });
+	}
+
+	/** Deletes object once no frame in flight can see it */
+	template<typename T>
+	void Retire(T* object)
+	{
+		Retire([object]() { delete object; });
+	}
+
+	/**
+	 * Publishes newValue in place of the current value of shared, and retires the old value.
+	 * The old value isn't returned, as once retired another thread's EndFrame() may delete it at any time.
+	 */
+	template<typename T>
+	void Replace(std::atomic<T*>& shared, T* newValue)
+	{
+		T* oldValue = shared.exchange(newValue, std::memory_order_seq_cst);
+		if (oldValue != nullptr)
+		{
+			Retire(oldValue);
+		}
+	}
+
+	/** Returns the number of objects waiting to be freed */
+	size_t GetNumRetired()
+	{
+		std::lock_guard<std::mutex> lock(m_retiredMutex);
+		return m_retired.size();
+	}
+
+private:
+	struct RetiredObject
+	{
+		/** Newest frame that could see the object */
+		int64_t m_lastVisibleFrame;
+		std::function<void()> m_deleter;
+	};
+
+	/** Number given to the next frame that begins */
+	std::atomic<int64_t> m_nextFrameNumber = 0;
+	/** Number of the last frame to leave the pipeline with every older frame. Locked by m_retiredMutex. */
+	int64_t m_lastEndedFrame = -1;
+	/** Frames that left the pipeline before an older frame did. Never more than the number of frames in flight. Locked by m_retiredMutex. */
+	std::vector<int64_t> m_framesEndedEarly;
+
+	/** Retired objects, in the order they were retired (so also in order of m_lastVisibleFrame) */
+	std::deque<RetiredObject> m_retired;
+	std::mutex m_retiredMutex;
+};
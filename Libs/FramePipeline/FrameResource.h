@@ -0,0 +1,85 @@
+#pragma once
+#include "FrameData.h"
+#include <Concurrency/CacheLine.h>
+#include <Diagnostic/Assert.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Debug to check that frames only use the resources they should
+#define FRAME_RESOURCE_CHECK_ACCESS 1
+
+/** Most frames in flight a FrameResource has room for, unless given another size */
+constexpr size_t FRAME_RESOURCE_MAX_FRAMES = 8;
+
+/**
+ * FrameResource
+ * One T for each frame in flight, for data that a stage keeps and mustn't overwrite while an older frame still uses it (e.g. upload
+ * buffers, per-frame scratch). Each frame gets the instance picked by its ID, and no two frames in flight share an ID, so stages that
+ * process several frames at once, and later stages that read what an earlier one wrote, can use them without locks or copies.
+ * A frame gets the same instance every time it goes round the pipeline, so whatever it left there last time is still there.
+ *
+ * Instances are stored inline, a cache line apart so frames on different threads don't contend, so MAX_FRAMES must be at least the
+ * number of frames the pipeline was initialised with. Call Init() from a stage's Init() with GetNumSimultaneousFrames().
+ * With FRAME_RESOURCE_CHECK_ACCESS, each instance remembers the last frame number it was used for, and asserts if it's used by a frame
+ * that isn't in flight or by an older frame than that, which happens when frames from different pipelines share it.
+ */
+template<typename T, size_t MAX_FRAMES = FRAME_RESOURCE_MAX_FRAMES>
+class FrameResource
+{
+public:
+	/** Sets the number of frames in the pipeline */
+	void Init(size_t numFrames)
+	{
+		ASSERT(numFrames > 0 && numFrames <= MAX_FRAMES);
+		m_numFrames = numFrames;
+	}
+
+	/** Returns the frame's instance */
+	template<typename DATA>
+	T& Get(const FrameData<DATA>& frame)
+	{
+		Slot& slot = GetSlot(frame.m_myId);
+#if FRAME_RESOURCE_CHECK_ACCESS
+		CheckAccess(slot, frame.m_frameNumber);
+#endif
+		return slot.m_resource;
+	}
+
+	/** Returns the instance for a frame ID. Only for setting up or clearing every instance while no frames are in flight. */
+	T& GetById(int frameId) { return GetSlot(frameId).m_resource; }
+
+	size_t GetNumFrames() const { return m_numFrames; }
+
+private:
+	struct alignas(CACHE_LINE_SIZE) Slot
+	{
+		T m_resource{};
+#if FRAME_RESOURCE_CHECK_ACCESS
+		/** Highest frame number the instance has been used for */
+		std::atomic<int64_t> m_lastFrameNumber = -1;
+#endif
+	};
+
+	Slot& GetSlot(int frameId)
+	{
+		ASSERT(frameId >= 0 && (size_t)frameId < m_numFrames);
+		return m_slots[frameId];
+	}
+
+#if FRAME_RESOURCE_CHECK_ACCESS
+	static void CheckAccess(Slot& slot, int64_t frameNumber)
+	{
+		ASSERT(frameNumber >= 0);
+		// Stages on parallel branches may use a frame's instance at the same time
+		int64_t lastFrameNumber = slot.m_lastFrameNumber.load(std::memory_order_relaxed);
+		while (lastFrameNumber < frameNumber && !slot.m_lastFrameNumber.compare_exchange_weak(lastFrameNumber, frameNumber, std::memory_order_relaxed))
+		{
+		}
+		ASSERT(lastFrameNumber <= frameNumber);
+	}
+#endif
+
+	std::array<Slot, MAX_FRAMES> m_slots;
+	size_t m_numFrames = 0;
+};
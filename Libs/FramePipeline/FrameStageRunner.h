@@ -1,13 +1,39 @@
 #pragma once
 #include <Jobs/JobDecl.h>
 #include <Jobs/Jobs.h>
+#include "FrameReclaimer.h"
+#include "FrameTelemetry.h"
+#include <Concurrency/MPMCQueue.h>
 #include <array>
 #include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 template<typename DATA>
 struct FrameData;
 
-/** Base class for pipeline stages. A frame can be queued here and processed in order before being sent to the next stage. */
+/** How many frames a stage may process at once, and the order it sends them on in */
+enum class StageConcurrency : uint8_t
+{
+	/** One frame at a time, sent on in the order they arrived. For stages that keep state between frames. */
+	SERIAL,
+	/** Several frames at once, sent on in the order they entered the pipeline. For stages that only touch their own frame's data. */
+	ORDERED,
+	/** Several frames at once, sent on as soon as each finishes. Only for stages whose later stages don't care about frame order. */
+	UNORDERED,
+};
+
+/**
+ * Base class for pipeline stages. A frame can be queued here and processed before being sent to the next stages.
+ * By default a stage processes one frame at a time. Stages that don't keep state between frames can call SetConcurrency() to overlap
+ * several frames, so a stage that takes longer than the others doesn't limit the frame rate on its own.
+ * A stage may send frames to several stages, which then process the same frame at the same time, so they must only touch their own
+ * parts of its data. A stage that frames are sent to from several stages (a join) waits for the frame to arrive from all of them.
+ * Under load, the pipeline may drop frames (see FrameOverloadPolicy). Skippable stages pass dropped frames straight on without running them.
+ */
 template<typename DATA>
 class FrameStageRunner
 {
@@ -16,117 +42,200 @@ public:
 	FrameStageRunner(const char* name);
 	FrameStageRunner(const FrameStageRunner<DATA>&) = delete;
 	FrameStageRunner& operator=(const FrameStageRunner<DATA>&) = delete;
-	~FrameStageRunner() = default;
+	virtual ~FrameStageRunner() = default;
 
 	/** Initialises the Frame Queue to allow up-to-N frames */
 	void InitFrameQueue(size_t simultaneousFrames);
 
 	/** Overridable initialisation that runs on app start-up */
 	virtual void Init() { }
-
-	/** Sets the stage runner that frames are sent to after this stage. Only set once on initialisation. */
-	void SetNextStage(FrameStageRunner<DATA>* nextStage) { m_nextStage = nextStage; }
-	/** Queues the frame to be run at some point in the future. */
-	void QueueFrame(FrameData<DATA>& frame);
-
-protected:
 	/**
-	 * Abstract method for executing whatever the stage wants.
-	 * NOTE: jobs that need to complete before this frame can finish MUST run with JOBFLAG_ISCHILD
+	 * Runs Init() if it hasn't run yet. FramePipeline::Init() calls this, but stages that don't need GetNumSimultaneousFrames() can be
+	 * initialised earlier, on whichever thread they need, e.g. side by side as tasks in an InitGraph.
 	 */
-	virtual void RunJobInner() = 0;
-
-private:
-	enum class StateEnum : char
+	void InitStage()
 	{
-		AWAITING_FRAME,
-		LOADING_FRAME,
-		PROCESSING_FRAME,
-	};
+		if (!m_initialised.exchange(true))
+		{
+			Init();
+		}
+	}
 
-	struct State
+	/**
+	 * Sets how many frames this stage may process at once (maxFrames is ignored for SERIAL stages). Only set once on initialisation,
+	 * before the pipeline is initialised.
+	 */
+	void SetConcurrency(StageConcurrency concurrency, int maxFrames = 1)
 	{
-		StateEnum m_state;
-		uint64_t m_count;
+		m_concurrency = concurrency;
+		m_maxActiveFrames = concurrency == StageConcurrency::SERIAL ? 1 : maxFrames;
+		_ASSERT(m_maxActiveFrames > 0);
+	}
+	StageConcurrency GetConcurrency() const { return m_concurrency; }
+	/** Returns the number of frames this stage may process at once */
+	int GetMaxActiveFrames() const { return m_maxActiveFrames; }
+	/** Returns the number of frames in the pipeline, for sizing per-frame data (see FrameResource). Set before Init() is called. */
+	size_t GetNumSimultaneousFrames() const { return m_numSimultaneousFrames; }
 
-		bool operator==(const State& rhs)
-		{
-			return m_state == rhs.m_state && m_count == rhs.m_count;
-		}
-	};
+	/**
+	 * Lets frames skip this stage when they're dropped under load, for stages whose work is wasted on a frame that will be superseded
+	 * (e.g. rendering). Before running a frame, a skippable stage asks the pipeline whether to drop it. Stages that keep state between
+	 * frames, like a simulation, mustn't be skippable. Only set once on initialisation.
+	 */
+	void SetSkippable(bool skippable) { m_skippable = skippable; }
+	bool IsSkippable() const { return m_skippable; }
 
-	template<typename DATA>
-	struct FrameNode;
+	/** Sets this stage's position in the pipeline, for recording frame timings. Only set once on initialisation. */
+	void SetStageIndex(int stageIndex) { m_stageIndex = stageIndex; }
+	const char* GetName() const { return m_name; }
 
-	template<typename DATA>
-	struct FrameNodePtr
+	/** Adds a stage runner that frames are sent to after this stage. Only call on initialisation, before InitFrameQueue(). */
+	void AddNextStage(FrameStageRunner<DATA>* nextStage)
 	{
-		FrameNode<DATA>* m_ptr;
-		uint64_t m_count;
-		int m_index;
+		m_nextStages.push_back(nextStage);
+		nextStage->m_numPreviousStages++;
+	}
+	/** Returns the number of stages that send frames to this one */
+	int GetNumPreviousStages() const { return m_numPreviousStages; }
+	/** Sets the pipeline's reclaimer, and whether frames enter or leave the pipeline at this stage. Only set once on initialisation. */
+	void SetFrameReclaimer(FrameReclaimer* reclaimer, bool beginsFrames, bool endsFrames)
+	{
+		m_reclaimer = reclaimer;
+		m_beginsFrames = beginsFrames;
+		m_endsFrames = endsFrames;
+	}
+	/** Sets a function that's given each frame leaving the pipeline, instead of sending it on to the next stage. Only set once on initialisation. */
+	void SetFrameEndedCallback(std::function<void(FrameData<DATA>&)> callback) { m_frameEndedCallback = std::move(callback); }
+	/** Sets a function that decides whether to drop a frame under load. Only set once on initialisation. */
+	void SetDropFrameCheck(std::function<bool(FrameData<DATA>&)> check) { m_dropFrameCheck = std::move(check); }
+	/** Queues the frame to be run at some point in the future. */
+	void QueueFrame(FrameData<DATA>& frame);
 
-		bool operator==(const FrameNodePtr& rhs)
-		{
-			return m_ptr == rhs.m_ptr && m_count == rhs.m_count;
-		}
-	};
+	/** Returns the number of frames waiting for this stage that haven't been dropped. More than a frame or so means it can't keep up. */
+	int GetNumQueuedFrames() const { return m_numQueuedFrames.load(std::memory_order_relaxed); }
+	/** Returns the number of dropped frames that skipped this stage */
+	int64_t GetNumFramesSkipped() const { return m_numFramesSkipped.load(std::memory_order_relaxed); }
 
-	template<typename DATA>
-	struct FrameNode
+	/** Returns the number of frames this stage has processed since TakeProcessingTime() was last called */
+	int64_t GetNumFramesProcessed() const { return m_numFramesProcessed.load(std::memory_order_relaxed); }
+	/** Gets the total time this stage has spent processing frames, and the number of frames it processed, since this was last called. Only measured in a FramePipeline. */
+	void TakeProcessingTime(std::chrono::nanoseconds& timeOut, int64_t& numFramesOut)
 	{
-		FrameNode() { }
-		FrameNode(const FrameNode<DATA>&) { }
-		FrameNode& operator=(const FrameNode<DATA>&) { };
-		~FrameNode() = default;
-		FrameData<DATA>* m_frame;
-		std::atomic<FrameNodePtr<DATA>> m_next;
-	};
+		timeOut = std::chrono::nanoseconds(m_processingTimeNS.exchange(0, std::memory_order_relaxed));
+		numFramesOut = m_numFramesProcessed.exchange(0, std::memory_order_relaxed);
+	}
+
+protected:
+	/**
+	 * Abstract method for executing whatever the stage wants with the given frame.
+	 * Stages that process several frames at once may have this called for each of them at the same time.
+	 * NOTE: jobs that need to complete before this frame can finish MUST run with JOBFLAG_ISCHILD
+	 */
+	virtual void RunJobInner(FrameData<DATA>& frame) = 0;
+
+	/**
+	 * Drops the frame if the pipeline is overloaded, and returns whether it has been dropped (here or by an earlier stage).
+	 * For stages that can't be skipped, but can leave out work that's only needed if the frame is shown (e.g. render data extraction).
+	 * Only frames waiting for later stages count as back-pressure here, as this stage runs the frame whether or not it's dropped.
+	 */
+	bool DropFrameIfOverloaded(FrameData<DATA>& frame);
 
-	struct FrameQueue
+private:
+	/** A frame being processed by this stage, given to its jobs. The frame may be in other stages at the same time, on parallel branches. */
+	struct ActiveFrame
 	{
-		std::atomic<FrameNodePtr<DATA>> m_head;
-		std::atomic<FrameNodePtr<DATA>> m_tail;
+		FrameStageRunner<DATA>* m_stage = nullptr;
+		FrameData<DATA>* m_frame = nullptr;
+		/** Whether the frame was counted in m_numQueuedFrames when it was queued */
+		bool m_countedAsQueued = false;
+		/** Whether the frame is skipping this stage */
+		bool m_skipped = false;
+		/** Debug - Is this stage processing the frame? */
+		bool m_active = false;
 	};
 
+	/** Returns this stage's timings in the frame, or nullptr if the pipeline isn't recording them */
+	FrameStageTiming* GetStageTiming(FrameData<DATA>& frame);
+	/** Starts queued frames until the queue is empty or every slot is in use */
+	void TryStartFrames();
 	/** Start the next frame */
 	void StartFrame(FrameData<DATA>& frame);
-	/** Calls the overridable RunJobInner, and creates the FinishFrame job for when the stage has finished */
-	void RunJob(JobCounterPtr& jobFinished);
-	/** The first job called when processing a frame */
-	DECLARE_TEMPLATE_CLASS_JOB(DATA, FrameStageRunner, StartFrameJob);
-	/** Runs just after a frame has finished processing, to reset m_thisFrame and attempt to start the next frame. */
-	DECLARE_TEMPLATE_CLASS_JOB(DATA, FrameStageRunner, FinishFrameJob);
-
-	/** Thread-safe enqueues a frame into the lock-free linkedlist */
-	void EnqueueFrame(FrameData<DATA>& frame);
-	/** Thread-safe dequeues a frame from the lock-free linkedlist */
-	bool DequeueFrame(FrameData<DATA>** frameOut);
-	/** Allocates a frame node from the free list */
-	FrameNodePtr<DATA> AllocateFrameNode();
-	/** Releases a frame node back to the free list */
-	void DeallocateFrameNode(int index);
+	/** The first job called when processing a frame. Takes the ActiveFrame. */
+	static void StartFrameJob(void* data);
+	/** Runs just after a frame has finished processing, to send it on and attempt to start the next frame. Takes the ActiveFrame. */
+	static void FinishFrameJob(void* data);
+	/** Sends a finished frame to the next stages, leaving the pipeline first if this is the last stage */
+	void SendFrame(FrameData<DATA>& frame);
+	/** Holds a finished frame until every frame that entered the pipeline before it has been sent on, then sends them in order */
+	void SendFrameInOrder(FrameData<DATA>& frame);
 
-protected:
-	/** Atomic state for handling transitions between frames */
-	std::atomic<State> m_state;
 
-	/** Quick accessor for the currently active frame data */
+protected:
+	/**
+	 * Quick accessor for the currently active frame data, for jobs that a SERIAL stage creates.
+	 * Stages that process several frames at once must pass the frame from RunJobInner to their jobs instead.
+	 */
 	FrameData<DATA>* m_frameData = nullptr;
 
+	/** Returns the pipeline's reclaimer, for retiring data that frames in flight may still be using */
+	FrameReclaimer& GetFrameReclaimer() { return *m_reclaimer; }
+
 private:
-	/** Lock-free concurrent queue of frames to run */
-	FrameQueue m_queue;
-	/** Free list for allocating FrameNodes */
-	std::vector<FrameNode<DATA>> m_freeList;
-	std::vector<char> m_freeListInUse;
-	/** Stage to send completed frames to */
-	FrameStageRunner* m_nextStage = nullptr;
+	/**
+	 * Lock-free ring of frames to run. A frame can only be queued in one stage at a time, so a ring with room for every frame in the
+	 * pipeline never fills, and queueing a frame never allocates or waits for another thread.
+	 */
+	std::unique_ptr<MPMCQueue<FrameData<DATA>*>> m_queue;
+	/** Stages to send completed frames to */
+	std::vector<FrameStageRunner*> m_nextStages;
+	/** Number of stages that send frames to this one */
+	int m_numPreviousStages = 0;
+	/** Join stages only: number of previous stages each frame has arrived from, indexed by the frame's ID */
+	std::unique_ptr<std::atomic<int>[]> m_numArrivals;
+	/** Frames being processed by this stage, indexed by the frame's ID */
+	std::vector<ActiveFrame> m_activeFrames;
+	/** The pipeline's reclaimer */
+	FrameReclaimer* m_reclaimer = nullptr;
+	/** Position of this stage in the pipeline, or -1 if it isn't in one */
+	int m_stageIndex = -1;
+	/** Whether frames enter the pipeline at this stage */
+	bool m_beginsFrames = false;
+	/** Whether frames leave the pipeline after this stage */
+	bool m_endsFrames = false;
+	/** Given frames that leave the pipeline, if set */
+	std::function<void(FrameData<DATA>&)> m_frameEndedCallback;
+	/** Whether dropped frames skip this stage */
+	bool m_skippable = false;
+	/** Decides whether to drop a frame under load, if set */
+	std::function<bool(FrameData<DATA>&)> m_dropFrameCheck;
+	/** Number of frames waiting in m_queue that haven't been dropped */
+	std::atomic<int> m_numQueuedFrames = 0;
+	/** Number of dropped frames that skipped this stage */
+	std::atomic<int64_t> m_numFramesSkipped = 0;
 	/** Number of simultaneous frames that the parent pipeline allows */
 	size_t m_numSimultaneousFrames = 0;
+	/** Whether Init() has run */
+	std::atomic<bool> m_initialised = false;
+
+	StageConcurrency m_concurrency = StageConcurrency::SERIAL;
+	/** Number of frames this stage may process at once */
+	int m_maxActiveFrames = 1;
+	/** Number of slots claimed, by frames being processed or threads trying to start one */
+	std::atomic<int> m_numActiveFrames = 0;
+
+	/** ORDERED stages only: finished frames waiting for older frames to be sent on, indexed by frame number modulo m_numSimultaneousFrames */
+	std::vector<FrameData<DATA>*> m_reorderBuffer;
+	/** ORDERED stages only: number of the next frame to send on */
+	int64_t m_nextFrameToSend = 0;
+	std::mutex m_reorderMutex;
+
+	/** Time spent processing frames, and the number of frames processed, since TakeProcessingTime() was last called */
+	std::atomic<long long> m_processingTimeNS = 0;
+	std::atomic<int64_t> m_numFramesProcessed = 0;
 
 	// Debug
-	const char* m_name;
-	std::atomic<int> m_framesBeingExecuted = 0; // Should never be more than 1
+	const char* m_name = "";
+	std::atomic<int> m_framesBeingExecuted = 0; // Should never be more than m_maxActiveFrames
 };
 
 #include "FrameStageRunner.inl"
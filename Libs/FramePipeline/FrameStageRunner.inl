@@ -17,230 +17,258 @@ template<typename DATA>
 void FrameStageRunner<DATA>::InitFrameQueue(size_t simultaneousFrames)
 {
 	m_numSimultaneousFrames = simultaneousFrames;
-	m_freeList.resize(m_numSimultaneousFrames);
-	m_freeListInUse.resize(m_numSimultaneousFrames);
-	FrameNodePtr<DATA> nodePtr = AllocateFrameNode();
-	FrameNode<DATA>& node = *nodePtr.m_ptr;
-	node.m_next.store({ nullptr, 0, -1 });
-	m_queue.m_head = m_queue.m_tail = nodePtr;
-
+	m_reorderBuffer.resize(m_numSimultaneousFrames, nullptr);
+	m_activeFrames.resize(m_numSimultaneousFrames);
+	for (ActiveFrame& activeFrame : m_activeFrames)
+	{
+		activeFrame.m_stage = this;
+	}
+	if (m_numPreviousStages > 1)
+	{
+		m_numArrivals = std::make_unique<std::atomic<int>[]>(m_numSimultaneousFrames);
+		for (size_t i = 0; i < m_numSimultaneousFrames; i++)
+		{
+			m_numArrivals[i] = 0;
+		}
+	}
+	// The ring's size must be a power of two, and at least 2
+	size_t queueSize = 2;
+	while (queueSize < m_numSimultaneousFrames)
+	{
+		queueSize *= 2;
+	}
+	m_queue = std::make_unique<MPMCQueue<FrameData<DATA>*>>(queueSize);
 }
 
-// This should only ever be called by one thread at a time
 template<typename DATA>
 void FrameStageRunner<DATA>::QueueFrame(FrameData<DATA>& frame)
 {
-	// Add frame to queue
-	EnqueueFrame(frame);
+	// A join stage only queues the frame once it has arrived from every previous stage.
+	// Acquire-release, so the last branch to arrive sees what the others wrote to the frame.
+	if (m_numPreviousStages > 1)
+	{
+		std::atomic<int>& numArrivals = m_numArrivals[frame.m_myId];
+		if (numArrivals.fetch_add(1, std::memory_order_acq_rel) + 1 < m_numPreviousStages)
+		{
+			return;
+		}
+		// The frame can't arrive again until it has been through this stage
+		numArrivals.store(0, std::memory_order_relaxed);
+	}
+
+	if (FrameStageTiming* timing = GetStageTiming(frame))
+	{
+		timing->m_queuedTime = std::chrono::high_resolution_clock::now();
+	}
+	// Only frames that still need work count towards back-pressure. A frame isn't dropped while it's queued, so it's uncounted the same way.
+	ActiveFrame& activeFrame = m_activeFrames[frame.m_myId];
+	activeFrame.m_countedAsQueued = !frame.m_dropped;
+	if (activeFrame.m_countedAsQueued)
+	{
+		m_numQueuedFrames.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// Add frame to queue. It can't be full, as it has room for every frame in the pipeline.
+	bool queued = m_queue->TryPush(&frame);
+	ASSERT(queued);
+	// Make the frame visible before checking for a free slot, so a stage giving its slot back at the same time can't miss it
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	// And attempt to start it, if there's a free slot
+	TryStartFrames();
+}
+
+template<typename DATA>
+FrameStageTiming* FrameStageRunner<DATA>::GetStageTiming(FrameData<DATA>& frame)
+{
+	if (m_stageIndex < 0 || m_stageIndex >= (int)frame.m_stageTimings.size())
+	{
+		return nullptr;
+	}
+	return &frame.m_stageTimings[m_stageIndex];
+}
 
-	// Try to start the next frame
-	FrameData<DATA>* nextFrame = nullptr;
+template<typename DATA>
+bool FrameStageRunner<DATA>::DropFrameIfOverloaded(FrameData<DATA>& frame)
+{
+	if (!frame.m_dropped && m_dropFrameCheck && m_dropFrameCheck(frame))
+	{
+		frame.m_dropped = true;
+	}
+	return frame.m_dropped;
+}
+
+template<typename DATA>
+void FrameStageRunner<DATA>::TryStartFrames()
+{
 	while (true)
 	{
-		State currentState = m_state;
-		if (currentState.m_state == StateEnum::PROCESSING_FRAME)
+		// Try to claim a slot
+		int numActive = m_numActiveFrames.load();
+		if (numActive >= m_maxActiveFrames)
 		{
-			// Already processing a frame
-			break;
+			// Every slot is in use. Whoever frees one will check the queue again.
+			return;
+		}
+		if (!m_numActiveFrames.compare_exchange_weak(numActive, numActive + 1))
+		{
+			continue;
 		}
-		if (currentState.m_state == StateEnum::AWAITING_FRAME)
+
+		// Dequeue the next frame and move on
+		FrameData<DATA>* nextFrame = nullptr;
+		if (m_queue->TryPop(nextFrame))
 		{
-			// Check state is consistent
-			if (currentState == m_state)
+			if (m_activeFrames[nextFrame->m_myId].m_countedAsQueued)
 			{
-				// Try to acquire the state
-				if (std::atomic_compare_exchange_strong(&m_state, &currentState, { StateEnum::LOADING_FRAME, currentState.m_count + 1 }))
-				{
-					// Dequeue the next frame and move on
-					DequeueFrame(&nextFrame);
-					if (nextFrame)
-					{
-						m_state = { StateEnum::PROCESSING_FRAME, currentState.m_count + 1 };
-					}
-					else
-					{
-						// Nothing to dequeue
-						m_state = { StateEnum::AWAITING_FRAME, currentState.m_count + 1 };
-						break;
-					}
-				}
+				m_numQueuedFrames.fetch_sub(1, std::memory_order_relaxed);
 			}
+			StartFrame(*nextFrame);
+			continue;
+		}
+
+		// Nothing to dequeue, so give the slot back.
+		// A frame queued after the dequeue above may have seen every slot in use and left it to us, so check the queue again.
+		m_numActiveFrames--;
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (m_queue->IsEmpty())
+		{
+			return;
 		}
-	}
-	// And attempt to start the next frame
-	if (nextFrame)
-	{
-		StartFrame(*nextFrame);
 	}
 }
 
 template<typename DATA>
 void FrameStageRunner<DATA>::StartFrame(FrameData<DATA>& frame)
 {
-	m_frameData = &frame;
+	if (m_concurrency == StageConcurrency::SERIAL)
+	{
+		m_frameData = &frame;
+	}
 
 	// Debugging
-	m_framesBeingExecuted++;
-	ASSERT(m_framesBeingExecuted.load() < 2);
-	ASSERT(m_frameData->m_active == false);
+	int framesBeingExecuted = ++m_framesBeingExecuted;
+	ASSERT(framesBeingExecuted <= m_maxActiveFrames);
+	ActiveFrame& activeFrame = m_activeFrames[frame.m_myId];
+	ASSERT(activeFrame.m_active == false);
 
 	// Set this frame data active
-	m_frameData->m_active = true;
+	activeFrame.m_active = true;
+	activeFrame.m_frame = &frame;
+	if (FrameStageTiming* timing = GetStageTiming(frame))
+	{
+		timing->m_startTime = std::chrono::high_resolution_clock::now();
+	}
+	if (m_beginsFrames)
+	{
+		frame.m_frameNumber = m_reclaimer->BeginFrame();
+		frame.m_beginTime = std::chrono::high_resolution_clock::now();
+		frame.m_dropped = false;
+	}
+	activeFrame.m_skipped = m_skippable && DropFrameIfOverloaded(frame);
 
 	// Create the start and end jobs for this frame
 	JobCounterPtr jobCounter = Jobs::GetNewJobCounter();
-	Jobs::CreateJobAndCount(StartFrameJob, this, JOBFLAG_NONE, jobCounter);
-	Jobs::CreateJobWithDependency(FinishFrameJob, this, JOBFLAG_NONE, jobCounter);
+	Jobs::CreateJobAndCount(StartFrameJob, &activeFrame, JOBFLAG_NONE, jobCounter);
+	Jobs::CreateJobWithDependency(FinishFrameJob, &activeFrame, JOBFLAG_NONE, jobCounter);
 }
 
 template<typename DATA>
-DEFINE_TEMPLATE_CLASS_JOB(DATA, FrameStageRunner, StartFrameJob)
+void FrameStageRunner<DATA>::StartFrameJob(void* data)
 {
-	RunJobInner();
-}
-
-template<typename DATA>
-DEFINE_TEMPLATE_CLASS_JOB(DATA, FrameStageRunner, FinishFrameJob)
-{
-	// Queue frame in next stage
-	ASSERT(m_nextStage != nullptr);
-	m_frameData->m_active = false;
-	m_nextStage->QueueFrame(*m_frameData);
-	m_framesBeingExecuted--;
-
-	// Attempt to start our next queued frame if we have one
-	// Transition to LOADING_FRAME in case another thread queues something after the Dequeue below returns nullptr
-	m_state = { StateEnum::LOADING_FRAME, 0 };
-	FrameData<DATA>* nextFrame = nullptr;
-	DequeueFrame(&nextFrame);
-	if (nextFrame)
+	ActiveFrame& activeFrame = *static_cast<ActiveFrame*>(data);
+	FrameData<DATA>& frame = *activeFrame.m_frame;
+	// Time processing from here rather than from StartFrame(), so waiting for a thread doesn't count towards the stage's time
+	if (FrameStageTiming* timing = activeFrame.m_stage->GetStageTiming(frame))
 	{
-		m_state = { StateEnum::PROCESSING_FRAME, 0 };
-		StartFrame(*nextFrame);
+		timing->m_runTime = std::chrono::high_resolution_clock::now();
 	}
-	else
+	if (!activeFrame.m_skipped)
 	{
-		m_state = { StateEnum::AWAITING_FRAME, 0 };
+		activeFrame.m_stage->RunJobInner(frame);
 	}
 }
 
 template<typename DATA>
-FrameStageRunner<DATA>::FrameNodePtr<DATA> FrameStageRunner<DATA>::AllocateFrameNode()
+void FrameStageRunner<DATA>::FinishFrameJob(void* data)
 {
-	constexpr char IN_USE = 1;
-	constexpr char NOT_IN_USE = 0;
+	ActiveFrame& activeFrame = *static_cast<ActiveFrame*>(data);
+	FrameData<DATA>& frame = *activeFrame.m_frame;
+	FrameStageRunner<DATA>* stage = activeFrame.m_stage;
+	ASSERT(!stage->m_nextStages.empty());
+	activeFrame.m_active = false;
+	stage->m_framesBeingExecuted--;
+	if (activeFrame.m_skipped)
+	{
+		stage->m_numFramesSkipped.fetch_add(1, std::memory_order_relaxed);
+	}
+	if (FrameStageTiming* timing = stage->GetStageTiming(frame))
+	{
+		timing->m_finishTime = std::chrono::high_resolution_clock::now();
+		// Skipped frames aren't measured, as they would make the stage look quicker than it is
+		if (!activeFrame.m_skipped)
+		{
+			auto processingTime = timing->m_finishTime - timing->m_runTime;
+			stage->m_processingTimeNS.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(processingTime).count(), std::memory_order_relaxed);
+			stage->m_numFramesProcessed.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
 
-	int index = 0;
-	// Lock until we get a node
-	while (_InterlockedCompareExchange8(&m_freeListInUse[index], IN_USE, NOT_IN_USE) == IN_USE)
+	// Queue frame in next stage
+	if (stage->m_concurrency == StageConcurrency::ORDERED)
 	{
-		index = (index + 1) % m_numSimultaneousFrames;
+		stage->SendFrameInOrder(frame);
+	}
+	else
+	{
+		stage->SendFrame(frame);
 	}
-	// Return the node
-	return { &m_freeList[index], 0, index };
-}
 
-template<typename DATA>
-void FrameStageRunner<DATA>::DeallocateFrameNode(int index)
-{
-	constexpr char IN_USE = 1;
-	constexpr char NOT_IN_USE = 0;
-	m_freeListInUse[index] = NOT_IN_USE;
+	// Free our slot, and attempt to start our next queued frame if we have one
+	stage->m_numActiveFrames--;
+	stage->TryStartFrames();
 }
 
 template<typename DATA>
-void FrameStageRunner<DATA>::EnqueueFrame(FrameData<DATA>& frame)
+void FrameStageRunner<DATA>::SendFrame(FrameData<DATA>& frame)
 {
-	// Allocate node from free list
-	FrameNodePtr<DATA> nodePtr = AllocateFrameNode();
-	FrameNode<DATA>& node = *nodePtr.m_ptr;
-	node.m_frame = &frame;
-	node.m_next.store({ nullptr, 0 });
-
-	while (true)
+	if (m_endsFrames)
 	{
-		// Load tail
-		FrameNodePtr<DATA> tail = m_queue.m_tail;
-		FrameNodePtr<DATA> next = tail.m_ptr->m_next;
-		// Check tail is consistent
-		if (tail == m_queue.m_tail)
+		// Free shared data that only this frame and older ones could see
+		m_reclaimer->EndFrame(frame.m_frameNumber);
+		if (m_frameEndedCallback)
 		{
-			// Was tail pointing to the last node?
-			if (next.m_ptr == nullptr)
-			{
-				// Try to link the new node to the end of the list
-				if (std::atomic_compare_exchange_strong(
-					&(tail.m_ptr->m_next),
-					&next,
-					{ &node, next.m_count + 1, nodePtr.m_index }))
-				{
-					// Enqueue successful - Try to point tail to the inserted node
-					std::atomic_compare_exchange_strong(
-						&(m_queue.m_tail),
-						&tail,
-						{ &node, tail.m_count + 1, nodePtr.m_index });
-
-					break;
-				}
-			}
-			else
-			{
-				// Tail wasn't pointing to the last node - try and correct it
-				std::atomic_compare_exchange_strong(
-					&(m_queue.m_tail),
-					&tail,
-					{ next.m_ptr, tail.m_count + 1, next.m_index });
-			}
+			m_frameEndedCallback(frame);
+			return;
 		}
 	}
+	// Once the frame is queued in the last of these, every branch may have finished with it, so it mustn't be touched after
+	for (FrameStageRunner<DATA>* nextStage : m_nextStages)
+	{
+		nextStage->QueueFrame(frame);
+	}
 }
 
 template<typename DATA>
-bool FrameStageRunner<DATA>::DequeueFrame(FrameData<DATA>** frameOut)
+void FrameStageRunner<DATA>::SendFrameInOrder(FrameData<DATA>& frame)
 {
+	// Frames waiting here haven't been sent on, so none of them can have re-entered the pipeline.
+	// That keeps every frame number in the buffer within m_numSimultaneousFrames of the next one to send, so their indices can't collide.
+	std::lock_guard<std::mutex> lock(m_reorderMutex);
+	ASSERT(frame.m_frameNumber >= m_nextFrameToSend && frame.m_frameNumber < m_nextFrameToSend + (int64_t)m_numSimultaneousFrames);
+	m_reorderBuffer[frame.m_frameNumber % m_numSimultaneousFrames] = &frame;
+
+	// Send on every frame that's no longer waiting for an older one
 	while (true)
 	{
-		// Load relevant pointers
-		FrameNodePtr<DATA> head = m_queue.m_head;
-		FrameNodePtr<DATA> tail = m_queue.m_tail;
-		FrameNodePtr<DATA> next = head.m_ptr->m_next;
-		// Is head consistent?
-		if (head == m_queue.m_head)
+		FrameData<DATA>*& nextFrame = m_reorderBuffer[m_nextFrameToSend % m_numSimultaneousFrames];
+		if (nextFrame == nullptr)
 		{
-			// Is queue empty?
-			if (head.m_ptr == tail.m_ptr)
-			{
-				if (next.m_ptr == nullptr)
-				{
-					// Queue is empty
-					*frameOut = nullptr;
-					return false;
-				}
-				// Tail wasn't pointing to last node - try to correct it
-				std::atomic_compare_exchange_strong(
-					&(m_queue.m_tail),
-					&tail,
-					{ next.m_ptr, tail.m_count + 1, next.m_index });
-			}
-			else
-			{
-				// Read value from next before moving on
-				*frameOut = next.m_ptr->m_frame;
-				// Try to move head to next node
-				if (std::atomic_compare_exchange_strong(
-					&(m_queue.m_head),
-					&head,
-					{ next.m_ptr, head.m_count + 1, next.m_index }))
-				{
-					// Dequeue successful - Free head
-					if (head.m_index >= 0)
-					{
-						DeallocateFrameNode(head.m_index);
-					}
-					break;
-				}
-			}
+			break;
 		}
+		FrameData<DATA>& frameToSend = *nextFrame;
+		nextFrame = nullptr;
+		m_nextFrameToSend++;
+		SendFrame(frameToSend);
 	}
-	return true;
 }
@@ -0,0 +1,293 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/** When one stage of the pipeline got a frame, started processing it, and sent it on */
+struct FrameStageTiming
+{
+	/** When the frame was queued in the stage */
+	std::chrono::high_resolution_clock::time_point m_queuedTime;
+	/** When the stage took the frame from its queue, and created the jobs to process it */
+	std::chrono::high_resolution_clock::time_point m_startTime;
+	/** When a thread started running the stage's job */
+	std::chrono::high_resolution_clock::time_point m_runTime;
+	/** When the stage finished processing the frame */
+	std::chrono::high_resolution_clock::time_point m_finishTime;
+};
+
+/** Timings of one trip of a frame through the pipeline */
+struct FrameTimings
+{
+	int64_t m_frameNumber = -1;
+	/** Timings for each stage, in pipeline order */
+	std::vector<FrameStageTiming> m_stages;
+};
+
+/** How one stage has spent its time over the frames in a FrameTelemetry's history */
+struct FrameStageStats
+{
+	const char* m_name = "";
+	/** Number of frames the stage may process at once */
+	int m_maxActiveFrames = 1;
+	/** Average time frames waited in the stage's queue for a free slot */
+	double m_averageWaitMS = 0.0;
+	double m_maxWaitMS = 0.0;
+	/** Average time between the stage starting a frame and a thread picking up its job */
+	double m_averageThreadWaitMS = 0.0;
+	/** Average time the stage took to process a frame */
+	double m_averageProcessingMS = 0.0;
+	double m_maxProcessingMS = 0.0;
+	/** Fraction of the history's duration that the stage's slots spent processing frames */
+	double m_utilisation = 0.0;
+	/** Gaps in which the stage had nothing to process, between its first frame starting and its last frame finishing */
+	int m_numBubbles = 0;
+	double m_bubbleMS = 0.0;
+};
+
+/** Summary of a FrameTelemetry's history */
+struct FrameTelemetryStats
+{
+	/** Number of frames the stats cover */
+	size_t m_numFrames = 0;
+	/** Time from the first frame entering the pipeline to the last frame leaving it */
+	double m_durationMS = 0.0;
+	/** Average time from a frame entering the pipeline to leaving it */
+	double m_averageLatencyMS = 0.0;
+	/** The stage that limits the frame rate (the longest average processing time per slot), or -1 if there are no frames */
+	int m_bottleneckStage = -1;
+	std::vector<FrameStageStats> m_stages;
+};
+
+/**
+ * FrameTelemetry
+ * Keeps the timings of the most recent frames to leave a FramePipeline, for working out where frames spend their time.
+ * For each stage, a frame first waits in the stage's queue for a free slot, then for a thread to run its job, then is processed.
+ * A stage with nothing to process is in a bubble. Bubbles in the other stages are expected, but bubbles in the bottleneck mean
+ * there aren't enough frames in flight, or earlier stages are holding it up.
+ *
+ * Recording reuses the history's memory, so it doesn't allocate once the history is full. Any thread may record or read.
+ */
+class FrameTelemetry
+{
+public:
+	/** Number of frames kept by default */
+	static constexpr size_t DEFAULT_HISTORY_SIZE = 256;
+	/** Shortest idle gap counted as a bubble, so job scheduling overheads between frames don't count */
+	static constexpr std::chrono::microseconds MIN_BUBBLE_TIME = std::chrono::microseconds(100);
+
+	/** Sets up the history for stages with the given names and slot counts. Only call once, before recording. */
+	void Init(const std::vector<const char*>& stageNames, const std::vector<int>& stageMaxActiveFrames, size_t historySize = DEFAULT_HISTORY_SIZE)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stageNames = stageNames;
+		m_stageMaxActiveFrames = stageMaxActiveFrames;
+		m_history.resize(historySize);
+		for (FrameTimings& timings : m_history)
+		{
+			timings.m_stages.resize(stageNames.size());
+		}
+		m_numRecorded = 0;
+		m_epoch = std::chrono::high_resolution_clock::now();
+	}
+
+	/** Adds a frame's timings to the history, replacing the oldest frame once it's full */
+	void Record(int64_t frameNumber, const std::vector<FrameStageTiming>& stageTimings)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_history.empty())
+		{
+			return;
+		}
+		FrameTimings& timings = m_history[m_numRecorded % m_history.size()];
+		timings.m_frameNumber = frameNumber;
+		std::copy_n(stageTimings.begin(), std::min(stageTimings.size(), timings.m_stages.size()), timings.m_stages.begin());
+		m_numRecorded++;
+	}
+
+	/** Returns the frames in the history, oldest first */
+	std::vector<FrameTimings> GetFrames()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return GetFramesLocked();
+	}
+
+	/** Works out how each stage spent its time over the frames in the history */
+	FrameTelemetryStats GetStats()
+	{
+		std::vector<FrameTimings> frames = GetFrames();
+		FrameTelemetryStats stats;
+		stats.m_numFrames = frames.size();
+		stats.m_stages.resize(m_stageNames.size());
+		if (frames.empty() || m_stageNames.empty())
+		{
+			return stats;
+		}
+
+		// The history runs from the first frame entering the pipeline to the last one leaving it
+		auto historyStart = frames.front().m_stages.front().m_queuedTime;
+		auto historyEnd = frames.front().m_stages.back().m_finishTime;
+		double totalLatencyMS = 0.0;
+		for (const FrameTimings& frame : frames)
+		{
+			historyStart = std::min(historyStart, frame.m_stages.front().m_queuedTime);
+			historyEnd = std::max(historyEnd, frame.m_stages.back().m_finishTime);
+			totalLatencyMS += ToMS(frame.m_stages.back().m_finishTime - frame.m_stages.front().m_queuedTime);
+		}
+		stats.m_durationMS = ToMS(historyEnd - historyStart);
+		stats.m_averageLatencyMS = totalLatencyMS / (double)frames.size();
+
+		double bottleneckMS = -1.0;
+		std::vector<std::pair<std::chrono::high_resolution_clock::time_point, std::chrono::high_resolution_clock::time_point>> busyTimes;
+		for (size_t stage = 0; stage < m_stageNames.size(); stage++)
+		{
+			FrameStageStats& stageStats = stats.m_stages[stage];
+			stageStats.m_name = m_stageNames[stage];
+			stageStats.m_maxActiveFrames = m_stageMaxActiveFrames[stage];
+
+			double totalWaitMS = 0.0;
+			double totalThreadWaitMS = 0.0;
+			double totalProcessingMS = 0.0;
+			busyTimes.clear();
+			for (const FrameTimings& frame : frames)
+			{
+				const FrameStageTiming& timing = frame.m_stages[stage];
+				double waitMS = ToMS(timing.m_startTime - timing.m_queuedTime);
+				double processingMS = ToMS(timing.m_finishTime - timing.m_runTime);
+				totalWaitMS += waitMS;
+				totalThreadWaitMS += ToMS(timing.m_runTime - timing.m_startTime);
+				totalProcessingMS += processingMS;
+				stageStats.m_maxWaitMS = std::max(stageStats.m_maxWaitMS, waitMS);
+				stageStats.m_maxProcessingMS = std::max(stageStats.m_maxProcessingMS, processingMS);
+				busyTimes.push_back({ timing.m_runTime, timing.m_finishTime });
+			}
+			stageStats.m_averageWaitMS = totalWaitMS / (double)frames.size();
+			stageStats.m_averageThreadWaitMS = totalThreadWaitMS / (double)frames.size();
+			stageStats.m_averageProcessingMS = totalProcessingMS / (double)frames.size();
+			if (stats.m_durationMS > 0.0)
+			{
+				stageStats.m_utilisation = totalProcessingMS / (stats.m_durationMS * (double)stageStats.m_maxActiveFrames);
+			}
+
+			// Merge the times the stage was processing frames, and count the gaps between them
+			std::sort(busyTimes.begin(), busyTimes.end());
+			auto busyUntil = busyTimes.front().second;
+			for (size_t i = 1; i < busyTimes.size(); i++)
+			{
+				if (busyTimes[i].first - busyUntil >= MIN_BUBBLE_TIME)
+				{
+					stageStats.m_numBubbles++;
+					stageStats.m_bubbleMS += ToMS(busyTimes[i].first - busyUntil);
+				}
+				busyUntil = std::max(busyUntil, busyTimes[i].second);
+			}
+
+			double processingPerSlotMS = stageStats.m_averageProcessingMS / (double)stageStats.m_maxActiveFrames;
+			if (processingPerSlotMS > bottleneckMS)
+			{
+				bottleneckMS = processingPerSlotMS;
+				stats.m_bottleneckStage = (int)stage;
+			}
+		}
+		return stats;
+	}
+
+	/** Writes the history to a CSV file, with a row per frame per stage. Times are in microseconds since Init(). */
+	bool WriteCSV(const std::string& path)
+	{
+		std::vector<FrameTimings> frames = GetFrames();
+		std::ofstream file(path);
+		if (!file)
+		{
+			return false;
+		}
+		file << "frame,stage,queued_us,started_us,running_us,finished_us,wait_us,thread_wait_us,processing_us\n";
+		for (const FrameTimings& frame : frames)
+		{
+			for (size_t stage = 0; stage < frame.m_stages.size(); stage++)
+			{
+				const FrameStageTiming& timing = frame.m_stages[stage];
+				file << frame.m_frameNumber << "," << m_stageNames[stage] << "," << ToEpochUS(timing.m_queuedTime) << "," << ToEpochUS(timing.m_startTime)
+					<< "," << ToEpochUS(timing.m_runTime) << "," << ToEpochUS(timing.m_finishTime) << "," << ToUS(timing.m_startTime - timing.m_queuedTime)
+					<< "," << ToUS(timing.m_runTime - timing.m_startTime) << "," << ToUS(timing.m_finishTime - timing.m_runTime) << "\n";
+			}
+		}
+		return (bool)file;
+	}
+
+	/** Writes the stats and the history to a JSON file. Each frame has a [queued, started, running, finished] time per stage, in microseconds since Init(). */
+	bool WriteJSON(const std::string& path)
+	{
+		FrameTelemetryStats stats = GetStats();
+		std::vector<FrameTimings> frames = GetFrames();
+		std::ofstream file(path);
+		if (!file)
+		{
+			return false;
+		}
+		file << "{\n";
+		file << "\t\"num_frames\": " << stats.m_numFrames << ",\n";
+		file << "\t\"duration_ms\": " << stats.m_durationMS << ",\n";
+		file << "\t\"average_latency_ms\": " << stats.m_averageLatencyMS << ",\n";
+		file << "\t\"bottleneck_stage\": " << stats.m_bottleneckStage << ",\n";
+		file << "\t\"stages\": [\n";
+		for (size_t stage = 0; stage < stats.m_stages.size(); stage++)
+		{
+			const FrameStageStats& stageStats = stats.m_stages[stage];
+			file << "\t\t{ \"name\": \"" << stageStats.m_name << "\", \"max_active_frames\": " << stageStats.m_maxActiveFrames
+				<< ", \"average_wait_ms\": " << stageStats.m_averageWaitMS << ", \"max_wait_ms\": " << stageStats.m_maxWaitMS
+				<< ", \"average_thread_wait_ms\": " << stageStats.m_averageThreadWaitMS
+				<< ", \"average_processing_ms\": " << stageStats.m_averageProcessingMS << ", \"max_processing_ms\": " << stageStats.m_maxProcessingMS
+				<< ", \"utilisation\": " << stageStats.m_utilisation << ", \"num_bubbles\": " << stageStats.m_numBubbles << ", \"bubble_ms\": " << stageStats.m_bubbleMS
+				<< " }" << (stage + 1 < stats.m_stages.size() ? "," : "") << "\n";
+		}
+		file << "\t],\n";
+		file << "\t\"frames\": [\n";
+		for (size_t i = 0; i < frames.size(); i++)
+		{
+			file << "\t\t{ \"frame\": " << frames[i].m_frameNumber << ", \"stages\": [";
+			for (size_t stage = 0; stage < frames[i].m_stages.size(); stage++)
+			{
+				const FrameStageTiming& timing = frames[i].m_stages[stage];
+				file << (stage > 0 ? ", " : " ") << "[" << ToEpochUS(timing.m_queuedTime) << ", " << ToEpochUS(timing.m_startTime) << ", " << ToEpochUS(timing.m_runTime)
+					<< ", " << ToEpochUS(timing.m_finishTime) << "]";
+			}
+			file << " ] }" << (i + 1 < frames.size() ? "," : "") << "\n";
+		}
+		file << "\t]\n";
+		file << "}\n";
+		return (bool)file;
+	}
+
+private:
+	std::vector<FrameTimings> GetFramesLocked() const
+	{
+		size_t numFrames = std::min(m_numRecorded, m_history.size());
+		std::vector<FrameTimings> frames;
+		frames.reserve(numFrames);
+		for (size_t i = m_numRecorded - numFrames; i < m_numRecorded; i++)
+		{
+			frames.push_back(m_history[i % m_history.size()]);
+		}
+		return frames;
+	}
+
+	static double ToMS(std::chrono::high_resolution_clock::duration duration) { return std::chrono::duration<double, std::milli>(duration).count(); }
+	static long long ToUS(std::chrono::high_resolution_clock::duration duration) { return std::chrono::duration_cast<std::chrono::microseconds>(duration).count(); }
+	long long ToEpochUS(std::chrono::high_resolution_clock::time_point time) const { return ToUS(time - m_epoch); }
+
+private:
+	std::vector<const char*> m_stageNames;
+	std::vector<int> m_stageMaxActiveFrames;
+	/** Ring buffer of the most recent frames */
+	std::vector<FrameTimings> m_history;
+	/** Number of frames recorded since Init(). The next frame goes in m_history[m_numRecorded % m_history.size()]. */
+	size_t m_numRecorded = 0;
+	/** Time that written timestamps are relative to */
+	std::chrono::high_resolution_clock::time_point m_epoch;
+	std::mutex m_mutex;
+};
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "Mesh.h"
+#include <Memory/ScratchStack.h>
 #include <glm/vec2.hpp>
 #include <glm/ext/matrix_transform.hpp>
 #include <algorithm>
@@ -16,6 +17,8 @@ struct ObjLoadDelimiters : std::ctype<char> {
 		static mask rc[table_size];
 		rc['/'] = std::ctype_base::space;
 		rc['\n'] = std::ctype_base::space;
+		// Files read as binary keep Windows line endings
+		rc['\r'] = std::ctype_base::space;
 		rc[' '] = std::ctype_base::space;
 		return &rc[0];
 	}
@@ -38,15 +41,27 @@ bool Mesh::Load(const char* modelPath)
 		return false;
 	}
 	std::cout << "Loading model: " << modelPath << std::endl;
+	return Parse(modelFile);
+}
 
-	/** Set up temporary containers */
+bool Mesh::Load(const std::vector<char>& fileData, const char* modelPath)
+{
+	std::cout << "Loading model: " << modelPath << std::endl;
+	std::istringstream modelFile(std::string(fileData.begin(), fileData.end()));
+	return Parse(modelFile);
+}
 
-	std::vector<glm::vec3> tempVerts;
-	std::vector<glm::vec2> tempUVs;
-	std::vector<glm::vec3> tempNormals;
-	std::vector<glm::vec3> tempTangents;
-	std::vector<glm::vec3> tempBitangents;
-	std::vector<int> vertIndices, uvIndices, normalIndices;
+bool Mesh::Parse(std::istream& modelFile)
+{
+	/** Set up temporary containers, which are freed all at once when this returns */
+
+	ScratchScope scratchScope;
+	ScratchVector<glm::vec3> tempVerts;
+	ScratchVector<glm::vec2> tempUVs;
+	ScratchVector<glm::vec3> tempNormals;
+	ScratchVector<glm::vec3> tempTangents;
+	ScratchVector<glm::vec3> tempBitangents;
+	ScratchVector<int> vertIndices, uvIndices, normalIndices;
 	std::string line;
 	uint8_t faceAttributeCount = 0;
 
@@ -151,7 +166,6 @@ bool Mesh::Load(const char* modelPath)
 			}
 		}
 	}
-	modelFile.close();
 
 	/** Convert to usable mesh data */
 
@@ -1,6 +1,7 @@
 #pragma once
 #include <glm/vec3.hpp>
 #include <glm/mat4x4.hpp>
+#include <istream>
 #include <vector>
 
 /** Vertex data for a 3D model */
@@ -8,10 +9,16 @@ struct Mesh
 {
 	/** Load a mesh from a .obj file */
 	bool Load(const char* filename);
+	/** Load a mesh from the contents of a .obj file that has already been read. filename is only used for logging. */
+	bool Load(const std::vector<char>& fileData, const char* filename);
 	/** Set the vertices in this mesh and rotate them using the rotation matrix */
 	bool Set(const std::vector<glm::vec3>& vertices, glm::mat4x4& rotation);
 
 	std::vector<glm::vec3> m_vertices;
 	uint32_t m_numFaces = 0;
+
+private:
+	/** Parse .obj data from a stream */
+	bool Parse(std::istream& modelFile);
 };
 
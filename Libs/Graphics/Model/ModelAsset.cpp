@@ -2,6 +2,7 @@
 #include "ModelAsset.h"
 #include "Assert.h"
 #include <Jobs/Jobs.h>
+#include <Memory/PoolAllocator.h>
 #include <GL/glew.h>
 
 void ModelAsset::Load(const char* filename)
@@ -9,14 +10,25 @@ void ModelAsset::Load(const char* filename)
 	ASSERT(m_state == LoadState::UNLOADED);
 	m_state = LoadState::LOADING;
 	m_filename = filename;
-	Jobs::CreateJob(ModelAsset::LoadFromFile, this, JOBFLAG_DISKACCESS);
+	m_fileRequest.m_path = m_filename;
+	m_fileRequest.m_continuation = ModelAsset::LoadFromFile;
+	m_fileRequest.m_continuationData = this;
+	IOService::Submit(m_fileRequest);
 }
 
-// TODO: Split mesh loading in two: Read from disk, and process
 DEFINE_CLASS_JOB(ModelAsset, LoadFromFile)
 {
-	m_mesh = std::make_shared<Mesh>();
-	if (m_mesh->Load(m_filename.c_str()))
+	if (!m_fileRequest.m_succeeded)
+	{
+		std::cout << "Error opening file: " << m_filename << std::endl;
+		m_state = LoadState::FAILED;
+		return;
+	}
+	m_mesh = MakePoolShared<Mesh>();
+	bool loaded = m_mesh->Load(m_fileRequest.m_buffer, m_filename.c_str());
+	// The file contents aren't needed once parsed
+	m_fileRequest.m_buffer = std::vector<char>();
+	if (loaded)
 	{
 		m_state = LoadState::LOADED;
 	}
@@ -42,6 +54,17 @@ void ModelAsset::Upload()
 	std::cout << "Uploaded model: " << m_filename << std::endl;
 }
 
+void ModelAsset::Unload()
+{
+	if (m_state != LoadState::UPLOADED)
+	{
+		return;
+	}
+	glDeleteBuffers(1, &m_vertexBufferID);
+	glDeleteVertexArrays(1, &m_vertexArrayID);
+	m_state = LoadState::LOADED;
+}
+
 void ModelAsset::PrepareForRendering() const
 {
 	glBindVertexArray(m_vertexArrayID);
@@ -1,6 +1,7 @@
 #pragma once
 #include "../GraphicsAsset.h"
 #include "Mesh.h"
+#include <Jobs/IOService.h>
 #include <Jobs/JobDecl.h>
 #include <memory>
 #include <string>
@@ -8,17 +9,19 @@
 
 /**
  * A model that can be asynchronously loaded or set, and uploaded to the graphics card.
- * Loading happens in a job, during which other systems can poll GetLoadState() to check when that has completed.
+ * The file is read by the IOService and parsed in a job, during which other systems can poll GetLoadState() to check when that has completed.
  */
 class ModelAsset
 {
 public:
-	/** Kick off a load job to load this asset from a file. Poll GetLoadState() periodically to check the status. */
+	/** Kick off a read of this asset's file, which is parsed in a job once read. Poll GetLoadState() periodically to check the status. */
 	void Load(const char* filename);
 	/** Sets this model's data from pre-loaded data. */
 	void Set(std::shared_ptr<Mesh>& mesh) { m_mesh = mesh; m_state = LoadState::LOADED; }
 	/** Uploads the mesh to VRAM. Only call from the main thread. Only valid if GetLoadState() == LOADED. */
 	void Upload();
+	/** Frees the mesh's VRAM, if it was uploaded. Only call from the main thread. */
+	void Unload();
 
 	void PrepareForRendering() const;
 
@@ -39,6 +42,8 @@ private:
 	LoadState m_state = LoadState::UNLOADED;
 	/** Name of file to read */
 	std::string m_filename;
+	/** Read of the file, which runs LoadFromFile once complete */
+	IORequest m_fileRequest;
 	/** Mesh data. Only valid if m_state >= LOADED */
 	std::shared_ptr<Mesh> m_mesh;
 
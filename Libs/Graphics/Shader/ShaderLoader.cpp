@@ -2,7 +2,6 @@
 #include "ShaderLoader.h"
 #include "Assert.h"
 #include <Jobs/Jobs.h>
-#include <fstream>
 #include <sstream>
 
 
@@ -11,12 +10,17 @@ void ShaderLoader::Load(const char* filename)
 	ASSERT(m_state == LoadState::UNLOADED);
 	m_state = LoadState::LOADING;
 	m_filename = filename;
-	Jobs::CreateJob(ShaderLoader::LoadFromFile, this, JOBFLAG_DISKACCESS);
+	m_fileRequest.m_path = m_filename;
+	// Shaders are small and something is usually about to compile them
+	m_fileRequest.m_priority = IOPriority::HIGH;
+	m_fileRequest.m_continuation = ShaderLoader::LoadFromFile;
+	m_fileRequest.m_continuationData = this;
+	IOService::Submit(m_fileRequest);
 }
 
 DEFINE_CLASS_JOB(ShaderLoader, LoadFromFile)
 {
-	if (LoadShaderFromFile())
+	if (LoadShaderFromBuffer())
 	{
 		m_state = LoadState::LOADED;
 	}
@@ -67,28 +71,35 @@ bool ShaderLoader::Compile(GLenum shaderType)
 	return true;
 }
 
-bool ShaderLoader::LoadShaderFromFile()
+bool ShaderLoader::LoadShaderFromBuffer()
 {
-	std::ifstream shaderStream(m_filename, std::ios::in);
-	if (shaderStream.is_open())
+	if (!m_fileRequest.m_succeeded)
 	{
-		std::string line;
-		while (getline(shaderStream, line))
+		std::cout << "Could not open shader source from " << m_filename << std::endl;
+		return false;
+	}
+
+	std::istringstream shaderStream(std::string(m_fileRequest.m_buffer.begin(), m_fileRequest.m_buffer.end()));
+	// Each line gains a '\n' but may lose a '\r', so this is normally the final size
+	m_shaderSource.reserve(m_fileRequest.m_buffer.size() + 1);
+	// The file contents aren't needed once copied into the stream
+	m_fileRequest.m_buffer = std::vector<char>();
+	std::string line;
+	while (getline(shaderStream, line))
+	{
+		// The file is read as binary, so it keeps Windows line endings
+		if (!line.empty() && line.back() == '\r')
 		{
-			m_shaderSource += "\n" + line;
+			line.pop_back();
+		}
+		m_shaderSource += '\n';
+		m_shaderSource.append(line);
 
-			// Extract any uniforms from the shader
-			CreateUniformFromLine(line);
+		// Extract any uniforms from the shader
+		CreateUniformFromLine(line);
 
-		}
-		shaderStream.close();
-		return true;
-	}
-	else
-	{
-		std::cout << "Could not open shader source from " << m_filename << std::endl;
-		return false;
 	}
+	return true;
 }
 
 void ShaderLoader::CreateUniformFromLine(std::string& line)
@@ -1,6 +1,8 @@
 #pragma once
 #include "../GraphicsAsset.h"
+#include <Jobs/IOService.h>
 #include <Jobs/JobDecl.h>
+#include <Memory/PoolAllocator.h>
 #include <stdint.h>
 #include <string>
 #include <vector>
@@ -17,7 +19,7 @@ struct ShaderUniform
 class ShaderLoader
 {
 public:
-	/** Kick off a load job to load this asset from a file. Poll GetLoadState() periodically to check the status. */
+	/** Kick off a read of this asset's file, which is processed in a job once read. Poll GetLoadState() periodically to check the status. */
 	void Load(const char* filename);
 	/** Compiles this shader. shaderType is GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, etc. */
 	bool Compile(GLenum shaderType);
@@ -33,7 +35,7 @@ public:
 private:
 	DECLARE_CLASS_JOB(ShaderLoader, LoadFromFile);
 
-	bool LoadShaderFromFile();
+	bool LoadShaderFromBuffer();
 	void CreateUniformFromLine(std::string& line);
 
 private:
@@ -41,8 +43,10 @@ private:
 	LoadState m_state = LoadState::UNLOADED;
 	/** Name of file to read */
 	std::string m_filename;
+	/** Read of the file, which runs LoadFromFile once complete */
+	IORequest m_fileRequest;
 	/** Shader source data. Only valid if m_state == LOADED. */
-	std::string m_shaderSource;
+	PoolString m_shaderSource;
 
 	/** Uniforms for this shader */
 	std::vector<ShaderUniform> m_uniforms;
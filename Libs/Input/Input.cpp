@@ -6,6 +6,15 @@ bool Input::m_isWarping = false;
 
 Input::Input()
 {
+	// Nothing is held until told otherwise. Headless runs rely on this to be repeatable.
+	m_keysDown.fill(false);
+	m_keysUp.fill(false);
+	m_keysHeld.fill(false);
+	m_mouseButtonDown.fill(false);
+	m_mouseButtonUp.fill(false);
+	m_mouseButtonHeld.fill(false);
+	m_mousePos = glm::vec2(0, 0);
+	m_lastMouseOffset = glm::vec2(0, 0);
 }
 
 Input::~Input()
@@ -0,0 +1,128 @@
+#include "pch.h"
+#include "InputScript.h"
+#include "Input.h"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+bool InputScript::Load(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		return false;
+	}
+
+	m_events.clear();
+	m_nextEvent = 0;
+	std::string line;
+	while (std::getline(file, line))
+	{
+		line = line.substr(0, line.find('#'));
+		std::istringstream stream(line);
+		Event event;
+		std::string type;
+		if (!(stream >> event.m_frameNumber >> type))
+		{
+			// Blank line or comment
+			continue;
+		}
+
+		if (type == "key" || type == "mouse")
+		{
+			std::string code;
+			std::string action;
+			stream >> code >> action;
+			event.m_type = type == "key" ? EventType::KEY : EventType::MOUSE_BUTTON;
+			event.m_code = type == "key" ? ParseKey(code) : std::atoi(code.c_str());
+			event.m_action = ParseAction(action);
+			if (!stream || event.m_code < 0 || event.m_action < 0)
+			{
+				return false;
+			}
+			int maxCode = type == "key" ? GLFW_KEY_LAST : GLFW_MOUSE_BUTTON_LAST;
+			if (event.m_code >= maxCode)
+			{
+				return false;
+			}
+		}
+		else if (type == "move")
+		{
+			event.m_type = EventType::MOUSE_MOVE;
+			if (!(stream >> event.m_x >> event.m_y))
+			{
+				return false;
+			}
+		}
+		else
+		{
+			return false;
+		}
+		m_events.push_back(event);
+	}
+
+	std::stable_sort(m_events.begin(), m_events.end(), [](const Event& a, const Event& b) { return a.m_frameNumber < b.m_frameNumber; });
+	return true;
+}
+
+void InputScript::Apply(int64_t frameNumber, Input& input)
+{
+	for (; m_nextEvent < m_events.size() && m_events[m_nextEvent].m_frameNumber <= frameNumber; m_nextEvent++)
+	{
+		const Event& event = m_events[m_nextEvent];
+		switch (event.m_type)
+		{
+		case EventType::KEY:
+			input.KeyListener(nullptr, event.m_code, 0, event.m_action, 0);
+			break;
+		case EventType::MOUSE_BUTTON:
+			input.MouseButtonListener(nullptr, event.m_code, event.m_action, 0);
+			break;
+		case EventType::MOUSE_MOVE:
+			input.MousePosListener(nullptr, event.m_x, event.m_y);
+			break;
+		}
+	}
+}
+
+int InputScript::ParseKey(const std::string& name)
+{
+	if (name.size() == 1 && name[0] >= 'A' && name[0] <= 'Z')
+	{
+		return GLFW_KEY_A + (name[0] - 'A');
+	}
+	if (name.size() == 1 && name[0] >= 'a' && name[0] <= 'z')
+	{
+		return GLFW_KEY_A + (name[0] - 'a');
+	}
+	if (name.size() == 1 && name[0] >= '0' && name[0] <= '9')
+	{
+		return GLFW_KEY_0 + (name[0] - '0');
+	}
+	if (name == "SPACE") return GLFW_KEY_SPACE;
+	if (name == "ESCAPE") return GLFW_KEY_ESCAPE;
+	if (name == "ENTER") return GLFW_KEY_ENTER;
+	if (name == "TAB") return GLFW_KEY_TAB;
+	if (name == "LEFT") return GLFW_KEY_LEFT;
+	if (name == "RIGHT") return GLFW_KEY_RIGHT;
+	if (name == "UP") return GLFW_KEY_UP;
+	if (name == "DOWN") return GLFW_KEY_DOWN;
+
+	// Anything else must be a key code
+	char* end = nullptr;
+	long code = std::strtol(name.c_str(), &end, 10);
+	if (name.empty() || *end != '\0')
+	{
+		return -1;
+	}
+	return (int)code;
+}
+
+int InputScript::ParseAction(const std::string& name)
+{
+	if (name == "press") return GLFW_PRESS;
+	if (name == "repeat") return GLFW_REPEAT;
+	if (name == "release") return GLFW_RELEASE;
+	return -1;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Input;
+
+/**
+ * InputScript
+ * Input events loaded from a text file and replayed into an Input on the frames they're given for, so the game can run without a window.
+ * One event per line, with # starting a comment:
+ *   <frame> key <key> press|repeat|release     Key is a letter, digit, SPACE, ESCAPE, ENTER, TAB, LEFT/RIGHT/UP/DOWN, or a GLFW key code
+ *   <frame> mouse <button> press|release       Button is a GLFW mouse button index
+ *   <frame> move <x> <y>                       Moves the mouse to the given position
+ */
+class InputScript
+{
+public:
+	/** Loads events from a file. Returns false if it could not be read, or a line could not be parsed. */
+	bool Load(const std::string& path);
+
+	/**
+	 * Sends every event for the given frame to the input handler. Call between Input::RefreshInputs() and Input::ExtractInputState().
+	 * Frames must be given in increasing order.
+	 */
+	void Apply(int64_t frameNumber, Input& input);
+
+	/** Returns the number of events loaded */
+	size_t GetNumEvents() const { return m_events.size(); }
+
+private:
+	enum class EventType : uint8_t
+	{
+		KEY,
+		MOUSE_BUTTON,
+		MOUSE_MOVE,
+	};
+
+	struct Event
+	{
+		int64_t m_frameNumber = 0;
+		EventType m_type = EventType::KEY;
+		/** Key or mouse button, and GLFW action */
+		int m_code = 0;
+		int m_action = 0;
+		/** Mouse position */
+		double m_x = 0.0;
+		double m_y = 0.0;
+	};
+
+	/** Returns the GLFW key code for a key name, or -1 if there isn't one */
+	static int ParseKey(const std::string& name);
+	/** Returns the GLFW action for an action name, or -1 if there isn't one */
+	static int ParseAction(const std::string& name);
+
+private:
+	/** Events sorted by frame, keeping the order of events on the same frame */
+	std::vector<Event> m_events;
+	/** Index of the next event to apply */
+	size_t m_nextEvent = 0;
+};
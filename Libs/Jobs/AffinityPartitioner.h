@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Remembers which thread executed each chunk of a ParallelFor, so that the next ParallelFor over the same data can send
+ * each chunk back to that thread, where its data is likely to still be in cache. Chunks are sent to the thread's
+ * JobMailbox, so other threads can still take them if that thread is busy.
+ *
+ * Pass the same AffinityPartitioner to every ParallelFor that iterates over the same data with the same chunk size.
+ * A partitioner must only be used by one ParallelFor at a time.
+ */
+class AffinityPartitioner
+{
+public:
+	static constexpr uint8_t NO_AFFINITY = 0xFF;
+
+	/** Sets up the partitioner for a ParallelFor with the given number of chunks. Recorded affinities are forgotten if the number of chunks has changed. */
+	void Prepare(size_t numChunks)
+	{
+		if (m_chunkThreads.size() != numChunks)
+		{
+			m_chunkThreads.assign(numChunks, NO_AFFINITY);
+		}
+	}
+
+	/** Returns the thread that last executed the given chunk, or NO_AFFINITY if it has not been executed yet */
+	uint8_t GetThread(size_t chunkIndex) const { return m_chunkThreads[chunkIndex]; }
+	/** Records the thread that executed the given chunk. Each chunk is only written by the thread executing it. */
+	void RecordThread(size_t chunkIndex, uint8_t threadIndex) { m_chunkThreads[chunkIndex] = threadIndex; }
+	/** Forgets all recorded affinities */
+	void Reset() { m_chunkThreads.assign(m_chunkThreads.size(), NO_AFFINITY); }
+
+private:
+	/** Per chunk, the index of the thread that last executed it */
+	std::vector<uint8_t> m_chunkThreads;
+};
@@ -0,0 +1,195 @@
+#pragma once
+#include "Jobs.h"
+#include <Concurrency/CacheLine.h>
+#include <Memory/PoolAllocator.h>
+#include <algorithm>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+/**
+ * AppendBuffer
+ * Collects items emitted by many jobs at once, when the number of items isn't known up-front (e.g. culling, or finding collision pairs).
+ *
+ * Each job thread appends to its own list of chunks, so appending is a plain store and increment with no atomics or locks.
+ * Chunks come from the thread's MemoryPool cache, and are kept by Clear() so a buffer that is reused every frame stops allocating.
+ * Once every job has finished appending, CompactTo() copies the items into one contiguous array, a chunk per job.
+ *
+ * Items from one thread stay in the order they were appended, but the order between threads is not defined.
+ * Only append from job threads. Clear(), GetSize() and CompactTo() must not run while anything is appending.
+ */
+template<typename T>
+class AppendBuffer
+{
+	/** Header at the start of each chunk, followed by its items */
+	struct Chunk
+	{
+		Chunk* m_next = nullptr;
+		size_t m_count = 0;
+
+		T* GetItems() { return reinterpret_cast<T*>(reinterpret_cast<char*>(this) + ITEMS_OFFSET); }
+	};
+	static constexpr size_t ITEMS_OFFSET = (sizeof(Chunk) + alignof(T) - 1) & ~(alignof(T) - 1);
+	static_assert(alignof(T) <= MemoryPool::MIN_ALIGNMENT, "MemoryPool doesn't support this alignment");
+
+public:
+	/** Size of each chunk, including its header. The biggest size the MemoryPool serves from its thread caches. */
+	static constexpr size_t CHUNK_SIZE = MemoryPool::MAX_SMALL_SIZE;
+	static constexpr size_t ITEMS_PER_CHUNK = (CHUNK_SIZE - ITEMS_OFFSET) / sizeof(T);
+	static_assert(ITEMS_PER_CHUNK >= 16, "Items are too big to share AppendBuffer chunks");
+
+	AppendBuffer() = default;
+	AppendBuffer(const AppendBuffer&) = delete;
+	AppendBuffer& operator=(const AppendBuffer&) = delete;
+	~AppendBuffer()
+	{
+		DestroyItems();
+		for (ThreadChunks& chunks : m_threadChunks)
+		{
+			Chunk* chunk = chunks.m_first;
+			while (chunk != nullptr)
+			{
+				Chunk* next = chunk->m_next;
+				MemoryPool::Free(chunk);
+				chunk = next;
+			}
+		}
+	}
+
+	/** Constructs an item at the end of this thread's list. Only call from job threads. */
+	template<typename... Args>
+	T& Emplace(Args&&... args)
+	{
+		_ASSERT(Jobs::GetThisThreadIndex() < m_threadChunks.size());
+		ThreadChunks& chunks = m_threadChunks[Jobs::GetThisThreadIndex()];
+		Chunk* chunk = chunks.m_current;
+		if (chunk == nullptr || chunk->m_count == ITEMS_PER_CHUNK)
+		{
+			chunk = NextChunk(chunks);
+		}
+		T* item = new (chunk->GetItems() + chunk->m_count) T(std::forward<Args>(args)...);
+		chunk->m_count++;
+		return *item;
+	}
+
+	/** Appends an item to the end of this thread's list. Only call from job threads. */
+	void Push(const T& item) { Emplace(item); }
+
+	/** Removes every item, keeping the chunks for reuse. Also sets the buffer up for the job system's current number of threads, so call before appending. */
+	void Clear()
+	{
+		DestroyItems();
+		if (m_threadChunks.size() < Jobs::GetNumThreads())
+		{
+			m_threadChunks.resize(Jobs::GetNumThreads());
+		}
+	}
+
+	/** Returns the number of items appended since the last Clear() */
+	size_t GetSize() const
+	{
+		size_t size = 0;
+		for (const ThreadChunks& chunks : m_threadChunks)
+		{
+			for (Chunk* chunk = chunks.m_first; chunk != nullptr && chunk->m_count > 0; chunk = chunk->m_next)
+			{
+				size += chunk->m_count;
+			}
+		}
+		return size;
+	}
+
+	/** Resizes out (a vector-like container of T) to hold every item, and copies them in with a job per chunk. Only call from job threads. */
+	template<typename Container>
+	void CompactTo(Container& out)
+	{
+		// Work out where each chunk's items go
+		PoolVector<ChunkCopy> copies;
+		size_t size = 0;
+		for (ThreadChunks& chunks : m_threadChunks)
+		{
+			for (Chunk* chunk = chunks.m_first; chunk != nullptr && chunk->m_count > 0; chunk = chunk->m_next)
+			{
+				copies.push_back({ chunk, size });
+				size += chunk->m_count;
+			}
+		}
+
+		out.resize(size);
+		if (copies.empty())
+		{
+			return;
+		}
+		T* outItems = out.data();
+		Jobs::ParallelFor<ChunkCopy>(copies.data(), copies.size(), 1, [outItems](ChunkCopy* copy, size_t count, size_t startIndex)
+			{
+				for (size_t i = 0; i < count; i++)
+				{
+					std::copy_n(copy[i].m_chunk->GetItems(), copy[i].m_chunk->m_count, outItems + copy[i].m_outIndex);
+				}
+			});
+	}
+
+private:
+	/** One thread's chunks, on its own cache line so threads appending at once don't contend */
+	struct alignas(CACHE_LINE_SIZE) ThreadChunks
+	{
+		Chunk* m_first = nullptr;
+		/** Chunk being appended to. Chunks after it are empty, kept from before the last Clear(). */
+		Chunk* m_current = nullptr;
+	};
+
+	/** A chunk to copy, and where its items go in the compacted array */
+	struct ChunkCopy
+	{
+		Chunk* m_chunk;
+		size_t m_outIndex;
+	};
+
+	/** Destroys every item, and rewinds each thread to its first chunk */
+	void DestroyItems()
+	{
+		for (ThreadChunks& chunks : m_threadChunks)
+		{
+			for (Chunk* chunk = chunks.m_first; chunk != nullptr && chunk->m_count > 0; chunk = chunk->m_next)
+			{
+				if constexpr (!std::is_trivially_destructible_v<T>)
+				{
+					for (size_t i = 0; i < chunk->m_count; i++)
+					{
+						chunk->GetItems()[i].~T();
+					}
+				}
+				chunk->m_count = 0;
+			}
+			chunks.m_current = chunks.m_first;
+		}
+	}
+
+	/** Moves on to the thread's next chunk, allocating one if it has none left */
+	Chunk* NextChunk(ThreadChunks& chunks)
+	{
+		if (chunks.m_current != nullptr && chunks.m_current->m_next != nullptr)
+		{
+			chunks.m_current = chunks.m_current->m_next;
+			return chunks.m_current;
+		}
+
+		void* memory = MemoryPool::Allocate(CHUNK_SIZE);
+		_ASSERT(memory != nullptr);
+		Chunk* chunk = new (memory) Chunk();
+		if (chunks.m_current == nullptr)
+		{
+			chunks.m_first = chunk;
+		}
+		else
+		{
+			chunks.m_current->m_next = chunk;
+		}
+		chunks.m_current = chunk;
+		return chunk;
+	}
+
+private:
+	std::vector<ThreadChunks> m_threadChunks;
+};
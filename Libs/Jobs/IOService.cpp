@@ -0,0 +1,153 @@
+#include "pch.h"
+#include "IOService.h"
+#include "Jobs.h"
+#include <fstream>
+
+std::priority_queue<IOService::QueuedRequest> IOService::m_queue;
+uint64_t IOService::m_nextSequence = 0;
+std::mutex IOService::m_queueMutex;
+std::condition_variable IOService::m_queueCondition;
+std::vector<std::thread> IOService::m_threads;
+bool IOService::m_running = false;
+
+void IOService::Init(int numThreads)
+{
+	_ASSERT(m_threads.empty());
+	m_running = true;
+	for (int i = 0; i < numThreads; i++)
+	{
+		m_threads.emplace_back(std::thread(IOService::IOThread));
+	}
+}
+
+void IOService::Shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		m_running = false;
+	}
+	m_queueCondition.notify_all();
+	for (auto& thread : m_threads)
+	{
+		if (thread.joinable())
+		{
+			thread.join();
+		}
+	}
+	m_threads.clear();
+}
+
+void IOService::Submit(IORequest& request)
+{
+	IORequest* requests[] = { &request };
+	SubmitInner(requests, 1, nullptr);
+}
+
+void IOService::SubmitAndCount(IORequest& request, JobCounterPtr& jobCounter)
+{
+	IORequest* requests[] = { &request };
+	SubmitInner(requests, 1, &jobCounter);
+}
+
+void IOService::SubmitBatch(IORequest* const* requests, size_t count)
+{
+	SubmitInner(requests, count, nullptr);
+}
+
+void IOService::SubmitBatchAndCount(IORequest* const* requests, size_t count, JobCounterPtr& jobCounter)
+{
+	SubmitInner(requests, count, &jobCounter);
+}
+
+size_t IOService::GetNumQueuedRequests()
+{
+	std::lock_guard<std::mutex> lock(m_queueMutex);
+	return m_queue.size();
+}
+
+void IOService::SubmitInner(IORequest* const* requests, size_t count, JobCounterPtr* jobCounter)
+{
+	// Continuations are created here on the job thread, as I/O threads can't allocate jobs
+	for (size_t i = 0; i < count; i++)
+	{
+		IORequest& request = *requests[i];
+		_ASSERT(request.m_continuation != nullptr);
+		request.m_buffer.clear();
+		request.m_succeeded = false;
+		request.m_submittingThread = Jobs::GetThisThreadIndex();
+		request.m_continuationJob = jobCounter
+			? Jobs::CreateUnqueuedJobAndCount(request.m_continuation, request.m_continuationData, request.m_continuationFlags, *jobCounter)
+			: Jobs::CreateUnqueuedJob(request.m_continuation, request.m_continuationData, request.m_continuationFlags);
+	}
+
+	// Queue the whole batch under one lock, and wake as many I/O threads as it can use
+	bool queued = false;
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		if (m_running)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				m_queue.push({ requests[i], m_nextSequence++ });
+			}
+			queued = true;
+		}
+	}
+	if (!queued)
+	{
+		// Shut down, so nothing would read them - fail them now, so anything counting on their continuations isn't left waiting
+		for (size_t i = 0; i < count; i++)
+		{
+			Jobs::PostJob(std::move(requests[i]->m_continuationJob), requests[i]->m_submittingThread);
+		}
+		return;
+	}
+	if (count == 1)
+	{
+		m_queueCondition.notify_one();
+	}
+	else
+	{
+		m_queueCondition.notify_all();
+	}
+}
+
+void IOService::IOThread()
+{
+	while (true)
+	{
+		IORequest* request = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(m_queueMutex);
+			m_queueCondition.wait(lock, []() { return !m_running || !m_queue.empty(); });
+			if (m_queue.empty())
+			{
+				// Stopped, and every queued read has completed
+				return;
+			}
+			request = m_queue.top().m_request;
+			m_queue.pop();
+		}
+
+		request->m_succeeded = ReadFile(*request);
+		// Posting the continuation publishes the buffer to whichever job thread runs it
+		Jobs::PostJob(std::move(request->m_continuationJob), request->m_submittingThread);
+	}
+}
+
+bool IOService::ReadFile(IORequest& request)
+{
+	std::ifstream file(request.m_path, std::ios::in | std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+	{
+		return false;
+	}
+	std::streamoff size = file.tellg();
+	if (size < 0)
+	{
+		return false;
+	}
+	request.m_buffer.resize((size_t)size);
+	file.seekg(0, std::ios::beg);
+	return size == 0 || (bool)file.read(request.m_buffer.data(), size);
+}
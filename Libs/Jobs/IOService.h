@@ -0,0 +1,104 @@
+#pragma once
+#include "Job.h"
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+/** Order in which queued reads are started. A queued read always starts before any queued read of a lower priority. */
+enum class IOPriority : uint8_t
+{
+	/** Something is waiting on this read right now */
+	HIGH,
+	NORMAL,
+	/** Speculative or background loading */
+	LOW,
+};
+
+/**
+ * A request to read a whole file.
+ * The request must stay alive until its continuation job has run. The continuation is passed m_continuationData, and can read the
+ * result from the request once it runs.
+ */
+struct IORequest
+{
+	/** File to read */
+	std::string m_path;
+	IOPriority m_priority = IOPriority::NORMAL;
+	/** Job to run once the read has completed or failed */
+	JobFunc m_continuation = nullptr;
+	void* m_continuationData = nullptr;
+	/** Flags for the continuation job. It cannot be a main thread job. */
+	uint8_t m_continuationFlags = JOBFLAG_NONE;
+
+	/** Contents of the file. Only valid once the continuation runs. */
+	std::vector<char> m_buffer;
+	/** Whether the file was read. Only valid once the continuation runs. */
+	bool m_succeeded = false;
+
+private:
+	friend class IOService;
+	/** Continuation job, created when the request is submitted and posted when the read completes */
+	JobPtr m_continuationJob;
+	/** Job thread that submitted the request, which the continuation is posted back to */
+	uint8_t m_submittingThread = 0;
+};
+
+/**
+ * IOService
+ * Reads files on a small pool of dedicated I/O threads, so that blocking reads never occupy a job thread.
+ * Requests are submitted from jobs, singly or in batches, and are started in priority order. When a read completes, its
+ * continuation job is posted back to the thread that submitted it.
+ * Init() must be called before submitting requests. Shutdown() must be called before the job system stops, as reads that complete
+ * after that would post their continuations to a job system that has gone. Requests submitted after Shutdown() fail straight away.
+ */
+class IOService
+{
+public:
+	/** Starts the I/O threads */
+	static void Init(int numThreads);
+	/** Finishes any queued reads and stops the I/O threads. May be called from a job, and more than once. */
+	static void Shutdown();
+
+	/** Queues a read. Must be called from a job thread. */
+	static void Submit(IORequest& request);
+	/** Queues a read whose continuation will add to jobCounter when submitted, and decrement it when complete. Must be called from a job thread. */
+	static void SubmitAndCount(IORequest& request, JobCounterPtr& jobCounter);
+	/** Queues a number of reads at once. Must be called from a job thread. */
+	static void SubmitBatch(IORequest* const* requests, size_t count);
+	/** Queues a number of reads at once, whose continuations will add to jobCounter when submitted, and decrement it when complete */
+	static void SubmitBatchAndCount(IORequest* const* requests, size_t count, JobCounterPtr& jobCounter);
+
+	/** Returns the number of reads that have been submitted but not yet started */
+	static size_t GetNumQueuedRequests();
+
+private:
+	/** A submitted request, ordered by priority and then by submission order */
+	struct QueuedRequest
+	{
+		IORequest* m_request;
+		uint64_t m_sequence;
+		/** std::priority_queue pops the largest element first, so a request is "less" than the requests that should start before it */
+		bool operator<(const QueuedRequest& other) const
+		{
+			return m_request->m_priority != other.m_request->m_priority ? m_request->m_priority > other.m_request->m_priority : m_sequence > other.m_sequence;
+		}
+	};
+
+	/** Shared implementation of the Submit methods */
+	static void SubmitInner(IORequest* const* requests, size_t count, JobCounterPtr* jobCounter);
+	/** Main method per I/O thread */
+	static void IOThread();
+	/** Reads the request's file into its buffer. Returns false if it could not be read. */
+	static bool ReadFile(IORequest& request);
+
+	static std::priority_queue<QueuedRequest> m_queue;
+	static uint64_t m_nextSequence;
+	static std::mutex m_queueMutex;
+	static std::condition_variable m_queueCondition;
+	static std::vector<std::thread> m_threads;
+	static bool m_running;
+};
@@ -0,0 +1,197 @@
+#include "pch.h"
+#include "InitGraph.h"
+#include "Jobs.h"
+#include <algorithm>
+#include <fstream>
+
+int InitGraph::AddTask(const char* name, TaskFunc func, const std::vector<int>& dependencies, uint8_t flags)
+{
+	_ASSERT(!m_started);
+
+	int id = (int)m_tasks.size();
+	std::unique_ptr<Task> task = std::make_unique<Task>();
+	task->m_graph = this;
+	task->m_name = name;
+	task->m_func = std::move(func);
+	task->m_flags = flags;
+	task->m_dependencies = dependencies;
+	task->m_numDependenciesLeft = (int)dependencies.size();
+	for (int dependency : dependencies)
+	{
+		// Only depending on earlier tasks keeps the graph free of cycles
+		_ASSERT(dependency >= 0 && dependency < id);
+		m_tasks[dependency]->m_dependents.push_back(id);
+	}
+	m_tasks.push_back(std::move(task));
+	return id;
+}
+
+void InitGraph::Start(JobFunc onComplete, void* onCompleteData, uint8_t onCompleteFlags)
+{
+	_ASSERT(!m_started);
+	m_started = true;
+	m_onComplete = onComplete;
+	m_onCompleteData = onCompleteData;
+	m_onCompleteFlags = onCompleteFlags;
+	m_startTime = std::chrono::high_resolution_clock::now();
+	m_numTasksLeft.store((int)m_tasks.size(), std::memory_order_relaxed);
+
+	if (m_tasks.empty())
+	{
+		Jobs::CreateJob(m_onComplete, m_onCompleteData, m_onCompleteFlags);
+		return;
+	}
+	// Tasks may finish and start their dependents while this is still going, so find the roots first
+	std::vector<Task*> roots;
+	for (std::unique_ptr<Task>& task : m_tasks)
+	{
+		if (task->m_dependencies.empty())
+		{
+			roots.push_back(task.get());
+		}
+	}
+	for (Task* task : roots)
+	{
+		StartTask(*task);
+	}
+}
+
+void InitGraph::StartTask(Task& task)
+{
+	Jobs::CreateJob(TaskJob, &task, task.m_flags);
+}
+
+void InitGraph::TaskJob(void* data)
+{
+	Task& task = *static_cast<Task*>(data);
+	InitGraph& graph = *task.m_graph;
+
+	if (!graph.IsCancelled())
+	{
+		task.m_threadIndex = Jobs::GetThisThreadIndex();
+		task.m_startTime = std::chrono::high_resolution_clock::now();
+		task.m_func();
+		task.m_endTime = std::chrono::high_resolution_clock::now();
+		task.m_ran = true;
+	}
+
+	// Dependents are started even when cancelled, so every task is accounted for and the graph still completes
+	for (int dependent : task.m_dependents)
+	{
+		Task& dependentTask = *graph.m_tasks[dependent];
+		if (dependentTask.m_numDependenciesLeft.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			StartTask(dependentTask);
+		}
+	}
+	if (graph.m_numTasksLeft.fetch_sub(1, std::memory_order_acq_rel) == 1 && !graph.IsCancelled())
+	{
+		Jobs::CreateJob(graph.m_onComplete, graph.m_onCompleteData, graph.m_onCompleteFlags);
+	}
+}
+
+double InitGraph::ToMS(std::chrono::high_resolution_clock::time_point time) const
+{
+	return std::chrono::duration<double, std::milli>(time - m_startTime).count();
+}
+
+double InitGraph::GetElapsedMS() const
+{
+	_ASSERT(m_started);
+	return ToMS(std::chrono::high_resolution_clock::now());
+}
+
+void InitGraph::Mark(const char* name)
+{
+	double timeMS = GetElapsedMS();
+	std::lock_guard<std::mutex> lock(m_marksMutex);
+	m_marks.push_back({ name, timeMS });
+}
+
+std::vector<InitTaskTiming> InitGraph::GetTaskTimings() const
+{
+	_ASSERT(IsComplete());
+	std::vector<InitTaskTiming> timings;
+	for (const std::unique_ptr<Task>& task : m_tasks)
+	{
+		if (!task->m_ran)
+		{
+			continue;
+		}
+		InitTaskTiming timing;
+		timing.m_name = task->m_name;
+		timing.m_mainThread = (task->m_flags & JOBFLAG_MAINTHREAD) != 0;
+		timing.m_threadIndex = task->m_threadIndex;
+		timing.m_startMS = ToMS(task->m_startTime);
+		timing.m_endMS = ToMS(task->m_endTime);
+		for (int dependency : task->m_dependencies)
+		{
+			timing.m_dependencies.push_back(m_tasks[dependency]->m_name);
+		}
+		timings.push_back(std::move(timing));
+	}
+	return timings;
+}
+
+std::vector<InitMark> InitGraph::GetMarks() const
+{
+	std::lock_guard<std::mutex> lock(m_marksMutex);
+	return m_marks;
+}
+
+void InitGraph::PrintTimeline(std::ostream& out) const
+{
+	std::vector<InitTaskTiming> timings = GetTaskTimings();
+	std::sort(timings.begin(), timings.end(), [](const InitTaskTiming& a, const InitTaskTiming& b) { return a.m_startMS < b.m_startMS; });
+
+	double totalMS = 0.0;
+	double taskMS = 0.0;
+	out << "Start-up timeline:" << std::endl;
+	for (const InitTaskTiming& timing : timings)
+	{
+		out << "\t" << timing.m_name << ": " << timing.m_startMS << " - " << timing.m_endMS << "ms on thread " << (int)timing.m_threadIndex
+			<< (timing.m_mainThread ? " (main thread)" : "") << std::endl;
+		totalMS = std::max(totalMS, timing.m_endMS);
+		taskMS += timing.m_endMS - timing.m_startMS;
+	}
+	for (const InitMark& mark : GetMarks())
+	{
+		out << "\t" << mark.m_name << ": " << mark.m_timeMS << "ms" << std::endl;
+	}
+	out << "Start-up tasks took " << totalMS << "ms, " << taskMS << "ms if run one after another" << std::endl;
+}
+
+bool InitGraph::WriteTimelineJSON(const std::string& path) const
+{
+	std::ofstream file(path);
+	if (!file)
+	{
+		return false;
+	}
+
+	std::vector<InitTaskTiming> timings = GetTaskTimings();
+	std::vector<InitMark> marks = GetMarks();
+	file << "{\n";
+	file << "\t\"tasks\": [\n";
+	for (size_t i = 0; i < timings.size(); i++)
+	{
+		const InitTaskTiming& timing = timings[i];
+		file << "\t\t{ \"name\": \"" << timing.m_name << "\", \"main_thread\": " << (timing.m_mainThread ? "true" : "false")
+			<< ", \"thread\": " << (int)timing.m_threadIndex << ", \"start_ms\": " << timing.m_startMS << ", \"end_ms\": " << timing.m_endMS
+			<< ", \"dependencies\": [";
+		for (size_t dependency = 0; dependency < timing.m_dependencies.size(); dependency++)
+		{
+			file << (dependency > 0 ? ", " : "") << "\"" << timing.m_dependencies[dependency] << "\"";
+		}
+		file << "] }" << (i + 1 < timings.size() ? "," : "") << "\n";
+	}
+	file << "\t],\n";
+	file << "\t\"marks\": [\n";
+	for (size_t i = 0; i < marks.size(); i++)
+	{
+		file << "\t\t{ \"name\": \"" << marks[i].m_name << "\", \"time_ms\": " << marks[i].m_timeMS << " }" << (i + 1 < marks.size() ? "," : "") << "\n";
+	}
+	file << "\t]\n";
+	file << "}\n";
+	return true;
+}
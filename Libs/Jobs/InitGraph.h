@@ -0,0 +1,118 @@
+#pragma once
+#include "Job.h"
+#include "JobDecl.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/** When a start-up task ran, relative to InitGraph::Start() */
+struct InitTaskTiming
+{
+	std::string m_name;
+	/** Whether the task had to run on the main thread */
+	bool m_mainThread = false;
+	/** Thread the task ran on */
+	uint8_t m_threadIndex = 0;
+	double m_startMS = 0.0;
+	double m_endMS = 0.0;
+	/** Names of the tasks it waited for */
+	std::vector<std::string> m_dependencies;
+};
+
+/** A point in start-up worth tracking that isn't a task, e.g. the first frame being shown */
+struct InitMark
+{
+	std::string m_name;
+	double m_timeMS = 0.0;
+};
+
+/**
+ * A graph of start-up tasks (creating the window, loading the scene, compiling shaders...), each run as a job as soon as the tasks it
+ * depends on have finished, so independent systems start side by side rather than one after another. Tasks that must run on the main
+ * thread (e.g. anything touching the window or the GL context) are created with JOBFLAG_MAINTHREAD, and run there in dependency order.
+ *
+ * Dependencies must be tasks that were added earlier, so the graph can't have cycles. Start() returns straight away, and the completion
+ * job is created once every task has finished. A task that fails calls Cancel(), so tasks that haven't started yet are skipped and the
+ * completion job never runs.
+ *
+ * Each task's start and end time and thread are recorded, along with any marks added afterwards, for tracking how long start-up takes.
+ */
+class InitGraph
+{
+public:
+	using TaskFunc = std::function<void()>;
+
+	InitGraph() = default;
+	InitGraph(const InitGraph&) = delete;
+	InitGraph& operator=(const InitGraph&) = delete;
+
+	/** Adds a task that runs once every task in dependencies has finished. flags are JobFlags to create its job with. Returns its ID, for later tasks to depend on. */
+	int AddTask(const char* name, TaskFunc func, const std::vector<int>& dependencies = {}, uint8_t flags = JOBFLAG_NONE);
+	/** Starts every task without dependencies. Once they've all finished, a job is created running onComplete with onCompleteFlags. */
+	void Start(JobFunc onComplete, void* onCompleteData, uint8_t onCompleteFlags);
+	/** Skips every task that hasn't started yet, and the completion job. Tasks that are running carry on. */
+	void Cancel() { m_cancelled.store(true, std::memory_order_relaxed); }
+	bool IsCancelled() const { return m_cancelled.load(std::memory_order_relaxed); }
+	/** Returns whether every task has finished */
+	bool IsComplete() const { return m_numTasksLeft.load(std::memory_order_acquire) == 0; }
+
+	/** Returns the time since Start(), in milliseconds */
+	double GetElapsedMS() const;
+	/** Records a point in start-up on the timeline, at the current time. May be called from any thread, once the graph has started. */
+	void Mark(const char* name);
+
+	/** Returns when each task ran, in the order they were added. Only call once the graph is complete. */
+	std::vector<InitTaskTiming> GetTaskTimings() const;
+	/** Returns the marks, in the order they were added */
+	std::vector<InitMark> GetMarks() const;
+
+	/** Prints each task in the order they started, with the total time taken and how much of it was spent running tasks side by side */
+	void PrintTimeline(std::ostream& out) const;
+	/** Writes the tasks and marks to a JSON file, with times in milliseconds since Start(). Only call once the graph is complete. */
+	bool WriteTimelineJSON(const std::string& path) const;
+
+private:
+	struct Task
+	{
+		InitGraph* m_graph = nullptr;
+		std::string m_name;
+		TaskFunc m_func;
+		uint8_t m_flags = JOBFLAG_NONE;
+		std::vector<int> m_dependencies;
+		/** Tasks that depend on this one */
+		std::vector<int> m_dependents;
+		/** Number of dependencies that haven't finished yet. The last one to finish creates this task's job. */
+		std::atomic<int> m_numDependenciesLeft = 0;
+		/** Whether the task ran, rather than being skipped after Cancel() */
+		bool m_ran = false;
+		uint8_t m_threadIndex = 0;
+		std::chrono::high_resolution_clock::time_point m_startTime;
+		std::chrono::high_resolution_clock::time_point m_endTime;
+	};
+
+	/** Runs a task, then starts any tasks that were only waiting for it. Takes the Task. */
+	static void TaskJob(void* data);
+	/** Creates the job for a task whose dependencies have all finished */
+	static void StartTask(Task& task);
+
+	double ToMS(std::chrono::high_resolution_clock::time_point time) const;
+
+	std::vector<std::unique_ptr<Task>> m_tasks;
+	/** Number of tasks that haven't finished or been skipped */
+	std::atomic<int> m_numTasksLeft = 0;
+	std::atomic<bool> m_cancelled = false;
+	bool m_started = false;
+	std::chrono::high_resolution_clock::time_point m_startTime;
+
+	JobFunc m_onComplete = nullptr;
+	void* m_onCompleteData = nullptr;
+	uint8_t m_onCompleteFlags = JOBFLAG_NONE;
+
+	std::vector<InitMark> m_marks;
+	mutable std::mutex m_marksMutex;
+};
@@ -1,4 +1,5 @@
 #pragma once
+#include <array>
 #include <atomic>
 
 typedef void(*JobFunc)(void*);
@@ -9,19 +10,72 @@ enum JobFlag
 	JOBFLAG_NONE = 0,
 	/** Job needs to run on the main thread */
 	JOBFLAG_MAINTHREAD = 1 << 0,
-	/** Job requires disk read/write access */
-	JOBFLAG_DISKACCESS = 1 << 1,
 	/** Job must complete before the job that created it is considered finished */
 	JOBFLAG_ISCHILD = 1 << 2,
 	/** For debugging, use this to mark jobs */
 	JOBFLAG_DEBUG = 1 << 7,
 };
 
-/** Counter for handling job dependencies */
+/**
+ * Counter for handling job dependencies.
+ * A "wide" counter spreads its jobs across several leaf counters on separate cache lines, and m_numJobs instead counts how many leaves still have jobs.
+ * This way, many threads completing jobs at once only rarely touch the same cache line. Use it for counters with a large number of jobs.
+ */
 struct JobCounter
 {
-	std::atomic<int> m_numJobs = 0;
-	std::atomic<int> m_numDependants = 0;
+	/** Number of leaves a wide counter spreads its jobs across */
+	static constexpr int NUM_LEAVES = 8;
+
+	/** Adds a job to this counter. Returns the leaf the job was added to, which must be passed to RemoveJob() when the job completes. */
+	int AddJob(unsigned int leafHint)
+	{
+		if (!m_isWide)
+		{
+			++m_numJobs;
+			return -1;
+		}
+		int leaf = leafHint % NUM_LEAVES;
+		// Only the first job in a leaf needs to touch the root
+		if (m_leaves[leaf].m_numJobs.fetch_add(1) == 0)
+		{
+			++m_numJobs;
+		}
+		return leaf;
+	}
+
+	/** Removes a completed job from the leaf returned by AddJob() */
+	void RemoveJob(int leaf)
+	{
+		if (leaf < 0)
+		{
+			--m_numJobs;
+			return;
+		}
+		// Only the last job in a leaf needs to touch the root
+		if (m_leaves[leaf].m_numJobs.fetch_sub(1) == 1)
+		{
+			--m_numJobs;
+		}
+	}
+
+	/** Returns true if any counted job has not yet completed */
+	inline bool HasJobs() const { return m_numJobs > 0; }
+
+	/** Number of jobs remaining, or for wide counters, the number of leaves with jobs remaining. Zero once all jobs have completed. */
+	alignas(64) std::atomic<int> m_numJobs = 0;
+	/** Number of jobs waiting on this counter. Kept on a separate cache line to m_numJobs so that waiting jobs don't contend with completing jobs. */
+	alignas(64) std::atomic<int> m_numDependants = 0;
+	/** Whether jobs are spread across m_leaves */
+	bool m_isWide = false;
+
+	struct alignas(64) Leaf
+	{
+		std::atomic<int> m_numJobs = 0;
+	};
+	/** Per-leaf job counts. Only used by wide counters. */
+	std::array<Leaf, NUM_LEAVES> m_leaves;
+	/** ID of this counter in the current job recording, or 0 if it was allocated while not recording */
+	uint32_t m_recordId = 0;
 };
 
 /** Pointer to a dependency counter. */
@@ -51,6 +105,8 @@ struct Job
 	Job* m_parent = nullptr;
 	/** Optional pointer to counter that will be decremented when the job completes */
 	JobCounterPtr m_decCounter;
+	/** The leaf of m_decCounter that this job was added to */
+	int8_t m_decCounterLeaf = -1;
 	/** Optional pointer to counter that must be zero before this job is executed */
 	JobCounterPtr m_waitCounter;
 	/** Pointer to job data */
@@ -59,10 +115,16 @@ struct Job
 	uint8_t m_flags = 0;
 	/** Count of the number of children this job has created that haven't yet finished. */
 	std::atomic<int> m_children = 0;
+	/** ID of this job in the current job recording, or 0 if it was created while not recording */
+	uint32_t m_recordId = 0;
+	/** Recording ID of the job that created this job */
+	uint32_t m_creatorRecordId = 0;
+	/** Recording time this job was created at */
+	int64_t m_recordCreateNS = 0;
+	/** Recording time this job started executing at */
+	int64_t m_recordStartNS = 0;
 	/** Returns true if this job has completed */
 	inline bool IsComplete() const { return m_func == nullptr && m_children == 0; }
-	/** Returns true if this job asked for disk reads */
-	inline bool NeedsDiskActivity() const { return (m_flags & JOBFLAG_DISKACCESS) != 0; }
 	// TODO: Pad to cache line?
 };
 
@@ -73,7 +135,7 @@ struct JobPtr
 	JobPtr(Job& job, int index, int thread) : m_job(&job), m_index(index), m_parentThread(thread) { }
 
 	inline bool IsValid() const { return m_index >= 0; }
-	inline bool HasDependencies() const { return m_job && m_job->m_waitCounter.IsValid() && m_job->m_waitCounter.m_counter->m_numJobs > 0; }
+	inline bool HasDependencies() const { return m_job && m_job->m_waitCounter.IsValid() && m_job->m_waitCounter.m_counter->HasJobs(); }
 	inline bool HasChildren() const { return m_job && m_job->m_children > 0; }
 
 	/** Returns the Job. Make sure it is valid before calling this. */
@@ -0,0 +1,40 @@
+#pragma once
+#include "Job.h"
+#include <Concurrency/MPMCQueue.h>
+
+/**
+ * JobMailbox
+ * A bounded queue of jobs that any thread may push to or take from.
+ * Each thread owns a mailbox, which it checks before its own JobStack. This lets a job be sent to a specific thread,
+ * for example one that is likely to still have the job's data in its cache, while idle threads may still take it if the
+ * owning thread is busy.
+ * NOTE: Size MUST be a power-of-two
+ */
+class JobMailbox
+{
+public:
+	JobMailbox(int size)
+		: m_queue(size)
+	{ }
+
+	/** Posts a job to this mailbox. May be called from any thread. Returns false if the mailbox is full. */
+	bool Push(const JobPtr& job) { return m_queue.TryPush(job); }
+
+	/** Takes the oldest job from this mailbox. May be called from any thread. Returns an invalid JobPtr if the mailbox is empty. */
+	JobPtr Take()
+	{
+		JobPtr job;
+		m_queue.TryPop(job);
+		return job;
+	}
+
+	/** Returns true if the mailbox appears empty. The result may be stale by the time it is used. */
+	bool IsEmpty() const { return m_queue.IsEmpty(); }
+	/** Returns the approximate number of jobs in the mailbox. The result may be stale by the time it is used. */
+	uint64_t GetApproxSize() const { return m_queue.GetApproxSize(); }
+
+private:
+	JobMailbox();
+
+	MPMCQueue<JobPtr> m_queue;
+};
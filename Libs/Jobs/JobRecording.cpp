@@ -0,0 +1,78 @@
+#include "pch.h"
+#include "JobRecording.h"
+#include <fstream>
+#include <sstream>
+
+bool JobRecording::Save(const std::string& path) const
+{
+	std::ofstream file(path);
+	if (!file)
+	{
+		return false;
+	}
+
+	file << "# Job recording\n";
+	file << "# job id func flags thread createNS startNS endNS exclusiveNS creatorId parentId decCounterId waitCounterId\n";
+	file << "# join jobId counterId\n";
+	file << "threads " << m_numThreads << "\n";
+	for (const JobRecord& job : m_jobs)
+	{
+		file << "job " << job.m_id << " " << std::hex << job.m_func << std::dec << " " << (int)job.m_flags << " " << (int)job.m_thread
+			<< " " << job.m_createNS << " " << job.m_startNS << " " << job.m_endNS << " " << job.m_exclusiveNS
+			<< " " << job.m_creatorId << " " << job.m_parentId << " " << job.m_decCounterId << " " << job.m_waitCounterId << "\n";
+	}
+	for (const JobJoinRecord& join : m_joins)
+	{
+		file << "join " << join.m_jobId << " " << join.m_counterId << "\n";
+	}
+	return (bool)file;
+}
+
+bool JobRecording::Load(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		return false;
+	}
+
+	m_numThreads = 0;
+	m_jobs.clear();
+	m_joins.clear();
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::istringstream stream(line);
+		std::string type;
+		stream >> type;
+		if (type == "threads")
+		{
+			stream >> m_numThreads;
+		}
+		else if (type == "job")
+		{
+			JobRecord job;
+			int flags = 0;
+			int thread = 0;
+			stream >> job.m_id >> std::hex >> job.m_func >> std::dec >> flags >> thread
+				>> job.m_createNS >> job.m_startNS >> job.m_endNS >> job.m_exclusiveNS
+				>> job.m_creatorId >> job.m_parentId >> job.m_decCounterId >> job.m_waitCounterId;
+			job.m_flags = (uint8_t)flags;
+			job.m_thread = (uint8_t)thread;
+			if (stream)
+			{
+				m_jobs.push_back(job);
+			}
+		}
+		else if (type == "join")
+		{
+			JobJoinRecord join;
+			stream >> join.m_jobId >> join.m_counterId;
+			if (stream)
+			{
+				m_joins.push_back(join);
+			}
+		}
+	}
+	return true;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * A job executed while recording. Times are in nanoseconds since recording began.
+ * IDs are unique within a recording. An ID of 0 means none, or an object created before recording began.
+ */
+struct JobRecord
+{
+	uint32_t m_id = 0;
+	/** Address of the job function, to identify which jobs run the same code */
+	uint64_t m_func = 0;
+	/** JobFlags the job was created with */
+	uint8_t m_flags = 0;
+	/** Thread that executed the job */
+	uint8_t m_thread = 0;
+	int64_t m_createNS = 0;
+	int64_t m_startNS = 0;
+	int64_t m_endNS = 0;
+	/** Time spent executing the job itself, excluding nested jobs and waiting in JoinUntilCompleted */
+	int64_t m_exclusiveNS = 0;
+	/** Job that was executing when this job was created */
+	uint32_t m_creatorId = 0;
+	/** Job that this job is a child of (JOBFLAG_ISCHILD) */
+	uint32_t m_parentId = 0;
+	/** Counter this job was counted on */
+	uint32_t m_decCounterId = 0;
+	/** Counter this job waited on before starting */
+	uint32_t m_waitCounterId = 0;
+};
+
+/** A job waiting in JoinUntilCompleted for every job counted on a counter */
+struct JobJoinRecord
+{
+	uint32_t m_jobId = 0;
+	uint32_t m_counterId = 0;
+};
+
+/** The jobs executed during one recording */
+struct JobRecording
+{
+	/** Number of threads the recording was made with */
+	int m_numThreads = 0;
+	std::vector<JobRecord> m_jobs;
+	std::vector<JobJoinRecord> m_joins;
+
+	/** Writes the recording as text, one job or join per line. Returns false if the file could not be written. */
+	bool Save(const std::string& path) const;
+	/** Reads a recording written by Save(). Returns false if the file could not be read. */
+	bool Load(const std::string& path);
+};
@@ -113,6 +113,13 @@ public:
         return (m_top > (m_bottom + 1)) && (m_numSteals * POPS_PER_STEAL < m_numPops);
     }
 
+    /** Returns the approximate number of jobs in the stack. May be called from any thread, but the result may be stale. */
+    int64_t GetApproxSize() const
+    {
+        int64_t size = m_top - m_bottom;
+        return size > 0 ? size : 0;
+    }
+
 private:
     JobStack();
 
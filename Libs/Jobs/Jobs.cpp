@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "Jobs.h"
+#include <Memory/ScratchStack.h>
 #include <iostream>
 #include <cstdio>
 
@@ -22,10 +23,13 @@ thread_local uint32_t Jobs::m_jobBufferHead = 0;
 
 std::vector<std::array<std::unique_ptr<std::atomic<bool>>, Jobs::MAX_COUNTERS_PER_THREAD>> Jobs::m_counterInUse;	// per-thread, accessed from other threads
 thread_local uint32_t Jobs::m_counterBufferHead = 0;
+thread_local uint32_t Jobs::m_counterLeafRotation = 0;
 // Job queue per thread
 std::vector<JobStack> Jobs::m_jobQueues;
 // Job queues per thread, for execution on the main thread only. The main thread will steal these jobs.
 std::vector<JobStack> Jobs::m_mainThreadJobQueues;
+// Mailbox per thread, for jobs that should preferably run on that thread
+std::vector<std::unique_ptr<JobMailbox>> Jobs::m_mailboxes;
 // Threads
 std::vector<std::thread> Jobs::m_threads;
 thread_local uint8_t Jobs::m_thisThreadIndex;
@@ -33,13 +37,25 @@ uint8_t Jobs::m_maxThreadIndex;
 thread_local Job* Jobs::m_activeJob;
 // Misc
 bool Jobs::m_running = true;
+std::atomic<int> Jobs::m_numRunningThreads = 0;
+// Elastic thread count
+std::atomic<int> Jobs::m_numActiveThreads = 0;
+ElasticThreadPolicy Jobs::m_elasticPolicy;
+std::chrono::time_point<std::chrono::high_resolution_clock> Jobs::m_lastElasticUpdateTime;
+std::mutex Jobs::m_parkMutex;
+std::condition_variable Jobs::m_parkCondition;
+std::vector<std::unique_ptr<Jobs::ElasticLoopCounters>> Jobs::m_elasticLoopCounters;
 Job Jobs::m_nullJob;
-char Jobs::m_diskJobInProgress = false;
-thread_local bool Jobs::m_thisThreadCanReadDisk;
+// Job recording
+std::atomic<bool> Jobs::m_recording = false;
+std::atomic<uint32_t> Jobs::m_nextRecordId = 0;
+std::chrono::time_point<std::chrono::high_resolution_clock> Jobs::m_recordingStartTime;
+std::vector<std::unique_ptr<Jobs::JobRecordBuffer>> Jobs::m_jobRecordBuffers;
+thread_local int64_t Jobs::m_recordExcludedNS = 0;
 #if JOBS_COLLECT_METRICS
-size_t Jobs::m_mainThreadIndex;
 std::vector<std::unique_ptr<std::atomic<int>>> Jobs::m_numStolenJobsExecutedPerThread;
 std::vector<std::unique_ptr<std::atomic<int>>> Jobs::m_numOwnJobsExecutedPerThread;
+std::vector<std::unique_ptr<std::atomic<int>>> Jobs::m_numMailboxJobsExecutedPerThread;
 std::vector<std::unique_ptr<std::atomic<int>>> Jobs::m_numExecutedLoopsPerThread;
 std::vector<std::unique_ptr<std::atomic<int>>> Jobs::m_numStarvedLoopsPerThread;
 std::vector<std::unique_ptr<std::atomic<int>>> Jobs::m_numJobsCreatedPerThread;
@@ -61,12 +77,19 @@ void Jobs::Init(int numThreads, JobFunc mainJob, void* mainJobData)
 	// Set up job system
 	m_running = true;
 	m_maxThreadIndex = numThreads - 1;
-
-	// Initialise shared vectors
+	m_numActiveThreads = numThreads;
+	m_numRunningThreads = numThreads;
+	m_lastElasticUpdateTime = std::chrono::high_resolution_clock::now();
+
+	// Initialise shared vectors, dropping the queues and threads of any previous run
+	m_jobQueues.clear();
+	m_mainThreadJobQueues.clear();
+	m_threads.clear();
 	m_jobInUse.resize(numThreads);
 	m_counterInUse.resize(numThreads);
 	m_jobQueues.reserve(numThreads);
 	m_mainThreadJobQueues.reserve(numThreads);
+	m_mailboxes.reserve(numThreads);
 	m_threads.reserve(numThreads);
 
 	for (int thread = 0; thread < numThreads; thread++)
@@ -82,10 +105,10 @@ void Jobs::Init(int numThreads, JobFunc mainJob, void* mainJobData)
 	}
 
 #if JOBS_COLLECT_METRICS
-	m_mainThreadIndex = m_maxThreadIndex;
 	m_lastMetricResetTime = std::chrono::high_resolution_clock::now();
 	m_numStolenJobsExecutedPerThread.resize(numThreads);
 	m_numOwnJobsExecutedPerThread.resize(numThreads);
+	m_numMailboxJobsExecutedPerThread.resize(numThreads);
 	m_numExecutedLoopsPerThread.resize(numThreads);
 	m_numStarvedLoopsPerThread.resize(numThreads);
 	m_numJobsCreatedPerThread.resize(numThreads);
@@ -97,6 +120,7 @@ void Jobs::Init(int numThreads, JobFunc mainJob, void* mainJobData)
 	{
 		m_numStolenJobsExecutedPerThread[i] = std::make_unique<std::atomic<int>>(0);
 		m_numOwnJobsExecutedPerThread[i] = std::make_unique<std::atomic<int>>(0);
+		m_numMailboxJobsExecutedPerThread[i] = std::make_unique<std::atomic<int>>(0);
 		m_numExecutedLoopsPerThread[i] = std::make_unique<std::atomic<int>>(0);
 		m_numStarvedLoopsPerThread[i] = std::make_unique<std::atomic<int>>(0);
 		m_numJobsCreatedPerThread[i] = std::make_unique<std::atomic<int>>(0);
@@ -107,8 +131,19 @@ void Jobs::Init(int numThreads, JobFunc mainJob, void* mainJobData)
 	}
 #endif
 
-	// Allocate job queues
-	for (uint8_t i = 0; i < m_maxThreadIndex; ++i)
+	// Allocate mailboxes for every thread up-front, since any thread may post to any other
+	m_mailboxes.clear();
+	m_elasticLoopCounters.clear();
+	m_jobRecordBuffers.clear();
+	for (int i = 0; i < numThreads; ++i)
+	{
+		m_mailboxes.emplace_back(std::make_unique<JobMailbox>(MAX_JOBS_PER_THREAD));
+		m_elasticLoopCounters.emplace_back(std::make_unique<ElasticLoopCounters>());
+		m_jobRecordBuffers.emplace_back(std::make_unique<JobRecordBuffer>());
+	}
+
+	// Allocate job queues, including this thread's, before any thread can look at them
+	for (int i = 0; i < numThreads; ++i)
 	{
 		m_jobQueues.emplace_back(MAX_JOBS_PER_THREAD);
 		m_mainThreadJobQueues.emplace_back(MAX_JOBS_PER_THREAD);
@@ -120,11 +155,7 @@ void Jobs::Init(int numThreads, JobFunc mainJob, void* mainJobData)
 		m_threads.emplace_back(std::thread(Jobs::WorkerThread, i));
 	}
 
-	// The main thread can only perform disk reads if it is the only thread
-	m_thisThreadCanReadDisk = (numThreads == 1);
 	// Turn this thread into the final job thread
-	m_jobQueues.emplace_back(MAX_JOBS_PER_THREAD);
-	m_mainThreadJobQueues.emplace_back(MAX_JOBS_PER_THREAD);
 	MainThread(m_maxThreadIndex, mainJob, mainJobData);
 
 	// Wait for all threads to finish
@@ -140,15 +171,35 @@ void Jobs::Init(int numThreads, JobFunc mainJob, void* mainJobData)
 void Jobs::WorkerThread(uint8_t threadIndex)
 {
 	m_thisThreadIndex = threadIndex;
-	m_thisThreadCanReadDisk = true;
 	m_activeJob = &m_nullJob;
 	std::cout << "Initialising thread " << (int)m_thisThreadIndex << std::endl;
 
 	while (m_running)
 	{
+		if (!IsThreadActive(m_thisThreadIndex))
+		{
+			// This thread has been retired - finish its own jobs so they aren't stranded, then sleep until it is needed again.
+			// Any jobs that can't run yet stay in this thread's queue, where other threads will steal them.
+			JobPtr jobPtr = GetJobFromThisThread(m_jobQueues, false);
+			if (!jobPtr.IsValid())
+			{
+				jobPtr = GetJobFromMailbox(m_thisThreadIndex);
+			}
+			if (jobPtr.IsValid())
+			{
+				ExecuteOuter(std::move(jobPtr));
+			}
+			else
+			{
+				ParkThread();
+			}
+			continue;
+		}
+
 		JobPtr jobPtr = GetJob();
 		ExecuteOuter(std::move(jobPtr));
 	}
+	WaitForThreadsToStop();
 
 	// This thread has completed
 	std::cout << "Thread " << (int)m_thisThreadIndex << " complete" << std::endl;
@@ -168,6 +219,8 @@ void Jobs::MainThread(uint8_t threadIndex, JobFunc mainJob, void* mainJobData)
 
 	while (m_running)
 	{
+		UpdateElasticThreads();
+
 		// Get the next job to run (prioritise main thread jobs)
 		JobPtr jobPtr = GetMainThreadJob();
 		if (!jobPtr.IsValid())
@@ -177,22 +230,111 @@ void Jobs::MainThread(uint8_t threadIndex, JobFunc mainJob, void* mainJobData)
 		}
 		ExecuteOuter(std::move(jobPtr));
 	}
+	WaitForThreadsToStop();
 
 	// This thread has completed
 	std::cout << "Thread " << (int)m_thisThreadIndex << " complete" << std::endl;
 }
 
+void Jobs::WaitForThreadsToStop()
+{
+	// Jobs left in the queues are never run, but other threads may still be looking at them until they see the job system has stopped
+	m_numRunningThreads--;
+	while (m_numRunningThreads > 0)
+	{
+		std::this_thread::yield();
+	}
+}
+
+void Jobs::Stop()
+{
+	std::lock_guard<std::mutex> lock(m_parkMutex);
+	m_running = false;
+	// Wake retired threads so they can exit
+	m_parkCondition.notify_all();
+}
+
+void Jobs::SetNumActiveThreads(int numThreads)
+{
+	numThreads = std::max(1, std::min(numThreads, (int)m_maxThreadIndex + 1));
+	std::lock_guard<std::mutex> lock(m_parkMutex);
+	if (numThreads != m_numActiveThreads)
+	{
+		LOG("Setting active threads to %d", numThreads);
+		m_numActiveThreads = numThreads;
+		m_parkCondition.notify_all();
+	}
+}
+
+void Jobs::ParkThread()
+{
+	std::unique_lock<std::mutex> lock(m_parkMutex);
+	m_parkCondition.wait(lock, []() { return !m_running || IsThreadActive(m_thisThreadIndex); });
+}
+
+void Jobs::UpdateElasticThreads()
+{
+	if (!m_elasticPolicy.m_enabled)
+	{
+		return;
+	}
+	auto now = std::chrono::high_resolution_clock::now();
+	if (now - m_lastElasticUpdateTime < m_elasticPolicy.m_updateInterval)
+	{
+		return;
+	}
+	m_lastElasticUpdateTime = now;
+
+	// Measure starvation across active threads, and the amount of queued work across all threads
+	int numActive = m_numActiveThreads;
+	long long executedLoops = 0;
+	long long starvedLoops = 0;
+	long long queueDepth = 0;
+	for (int thread = 0; thread <= m_maxThreadIndex; thread++)
+	{
+		ElasticLoopCounters& counters = *m_elasticLoopCounters[thread];
+		int executed = counters.m_numExecutedLoops.exchange(0, std::memory_order_relaxed);
+		int starved = counters.m_numStarvedLoops.exchange(0, std::memory_order_relaxed);
+		if (IsThreadActive(thread))
+		{
+			executedLoops += executed;
+			starvedLoops += starved;
+		}
+		queueDepth += m_jobQueues[thread].GetApproxSize() + (long long)m_mailboxes[thread]->GetApproxSize();
+	}
+	long long totalLoops = executedLoops + starvedLoops;
+	if (totalLoops == 0)
+	{
+		return;
+	}
+	float starvationRatio = (float)starvedLoops / (float)totalLoops;
+
+	// Jobs waiting on a counter or for their children are pushed back into the queues, so queued jobs are only work the threads can't
+	// keep up with when the threads aren't starving. Threads that are starving are looking past jobs that can't run yet.
+	bool starving = starvationRatio > m_elasticPolicy.m_shrinkStarvationRatio;
+	if (starvationRatio < m_elasticPolicy.m_growStarvationRatio || (!starving && queueDepth > (long long)m_elasticPolicy.m_growQueueDepthPerThread * numActive))
+	{
+		SetNumActiveThreads(numActive + 1);
+	}
+	else if (starving && numActive > m_elasticPolicy.m_minThreads)
+	{
+		SetNumActiveThreads(numActive - 1);
+	}
+}
+
 void Jobs::ExecuteOuter(JobPtr&& jobPtr)
 {
 	if (!jobPtr.IsValid())
 	{
 		// Didn't get a job - yield for a bit
 		_YIELD_PROCESSOR();
+		m_elasticLoopCounters[m_thisThreadIndex]->m_numStarvedLoops.fetch_add(1, std::memory_order_relaxed);
 	#if JOBS_COLLECT_METRICS
 		(*m_numStarvedLoopsPerThread[m_thisThreadIndex])++;
 	#endif
 		return;
 	}
+	m_elasticLoopCounters[m_thisThreadIndex]->m_numExecutedLoops.fetch_add(1, std::memory_order_relaxed);
 #if JOBS_COLLECT_METRICS
 	(*m_numExecutedLoopsPerThread[m_thisThreadIndex])++;
 #endif
@@ -207,13 +349,6 @@ void Jobs::ExecuteOuter(JobPtr&& jobPtr)
 		return;
 	}
 
-	// Release disk access
-	if (job.NeedsDiskActivity())
-	{
-		_ASSERT(m_diskJobInProgress);
-		m_diskJobInProgress = false;
-	}
-
 	// Decrement parent's children counter
 	if (job.m_parent != nullptr)
 	{
@@ -225,7 +360,7 @@ void Jobs::ExecuteOuter(JobPtr&& jobPtr)
 	if (job.m_decCounter.IsValid())
 	{
 		_ASSERT(job.m_decCounter.Get().m_numJobs > 0);
-		job.m_decCounter.Get().m_numJobs--;
+		job.m_decCounter.Get().RemoveJob(job.m_decCounterLeaf);
 	}
 
 	// Decrement dependent counter
@@ -256,9 +391,26 @@ void Jobs::Execute(Job& job)
 		auto timeSinceLastJob = jobStartTimeNS - m_lastJobFinishTimePerThreadNS[m_thisThreadIndex];
 		m_timeNotInJobsPerThreadNS[m_thisThreadIndex]->fetch_add(timeSinceLastJob.count());
 #endif
-
-		// Execute job!
+		// Nested jobs and joins add to this, so their time isn't counted as part of this job
+		int64_t outerExcludedNS = m_recordExcludedNS;
+		m_recordExcludedNS = 0;
+		// If recording begins while this job runs, it is treated as starting when recording began
+		job.m_recordStartNS = job.m_recordId != 0 ? GetRecordingTimeNS() : 0;
+
+		// Execute job! Anything it allocates from the scratch stack is freed when it returns.
+		ScratchStack& scratch = ScratchStack::Get();
+		ScratchStack::Marker scratchMarker = scratch.GetMarker();
 		job.m_func(job.m_data);
+		scratch.Release(scratchMarker);
+
+		int64_t recordDurationNS = 0;
+		if (job.m_recordId != 0)
+		{
+			int64_t recordEndNS = GetRecordingTimeNS();
+			recordDurationNS = recordEndNS - job.m_recordStartNS;
+			RecordJob(job, job.m_recordStartNS, recordEndNS, recordDurationNS - m_recordExcludedNS);
+		}
+		m_recordExcludedNS = outerExcludedNS + recordDurationNS;
 
 #if JOBS_COLLECT_METRICS
 		m_lastJobFinishTimePerThreadNS[m_thisThreadIndex] = std::chrono::high_resolution_clock::now();
@@ -290,6 +442,57 @@ void Jobs::PushJob(JobPtr&& jobPtr, bool mainThread)
 	}
 }
 
+void Jobs::CreateJobWithAffinityAndCount(JobFunc func, void* data, uint8_t flags, JobCounterPtr& jobCounter, uint8_t threadIndex)
+{
+	// Mailbox jobs can be taken by any thread, so they can't be tied to the main thread
+	_ASSERT(!BIT_IS_SET(flags, JOBFLAG_MAINTHREAD));
+	JobPtr jobPtr = AllocateJob(func, data, flags);
+	AddJobToCounter(*jobPtr.m_job, jobCounter);
+
+	if (threadIndex == m_thisThreadIndex || threadIndex > m_maxThreadIndex || !IsThreadActive(threadIndex) || !m_mailboxes[threadIndex]->Push(jobPtr))
+	{
+		// Mailbox is full (or the thread isn't running) - fall back to our own queue
+		PushJob(std::move(jobPtr), false);
+		return;
+	}
+#if JOBS_COLLECT_METRICS
+	(*m_numJobsCreatedPerThread[m_thisThreadIndex])++;
+#endif
+}
+
+JobPtr Jobs::CreateUnqueuedJob(JobFunc func, void* data, uint8_t flags)
+{
+	// Unqueued jobs are posted to mailboxes, which can be taken by any thread
+	_ASSERT(!BIT_IS_SET(flags, JOBFLAG_MAINTHREAD));
+	JobPtr jobPtr = AllocateJob(func, data, flags);
+#if JOBS_COLLECT_METRICS
+	(*m_numJobsCreatedPerThread[m_thisThreadIndex])++;
+#endif
+	return jobPtr;
+}
+
+JobPtr Jobs::CreateUnqueuedJobAndCount(JobFunc func, void* data, uint8_t flags, JobCounterPtr& jobCounter)
+{
+	JobPtr jobPtr = CreateUnqueuedJob(func, data, flags);
+	AddJobToCounter(*jobPtr.m_job, jobCounter);
+	return jobPtr;
+}
+
+void Jobs::PostJob(JobPtr&& jobPtr, uint8_t threadIndex)
+{
+	// This may not be a job thread, so it can't fall back to a JobStack like CreateJobWithAffinityAndCount() - keep trying mailboxes instead
+	if (threadIndex > m_maxThreadIndex || !IsThreadActive(threadIndex))
+	{
+		// The main thread is always active
+		threadIndex = m_maxThreadIndex;
+	}
+	while (!m_mailboxes[threadIndex]->Push(jobPtr))
+	{
+		threadIndex = threadIndex < m_maxThreadIndex ? (threadIndex + 1) : 0;
+		_YIELD_PROCESSOR();
+	}
+}
+
 void Jobs::CreateJob(JobFunc func, void* data, uint8_t flags)
 {
 	JobPtr jobPtr = AllocateJob(func, data, flags);
@@ -307,8 +510,7 @@ void Jobs::CreateJobWithDependency(JobFunc func, void* data, uint8_t flags, JobC
 void Jobs::CreateJobAndCount(JobFunc func, void* data, uint8_t flags, JobCounterPtr& jobCounter)
 {
 	JobPtr jobPtr = AllocateJob(func, data, flags);
-	jobPtr.m_job->m_decCounter = jobCounter;
-	++(jobCounter.m_counter->m_numJobs);
+	AddJobToCounter(*jobPtr.m_job, jobCounter);
 	PushJob(std::move(jobPtr), BIT_IS_SET(flags, JOBFLAG_MAINTHREAD));
 }
 
@@ -316,17 +518,45 @@ void Jobs::CreateJobWithDependencyAndCount(JobFunc func, void* data, uint8_t fla
 {
 	JobPtr jobPtr = AllocateJob(func, data, flags);
 	jobPtr.m_job->m_waitCounter = dependencyCounter;
-	jobPtr.m_job->m_decCounter = jobCounter;
-	++(jobCounter.m_counter->m_numJobs);
+	AddJobToCounter(*jobPtr.m_job, jobCounter);
 	++(dependencyCounter.m_counter->m_numDependants);
 	PushJob(std::move(jobPtr), BIT_IS_SET(flags, JOBFLAG_MAINTHREAD));
 }
 
 void Jobs::JoinUntilCompleted(const JobCounterPtr& dependencyCounter)
 {
-	while (dependencyCounter.Get().m_numJobs > 0)
+	// The time spent waiting here is recorded as a join rather than as part of the active job
+	if (m_recording.load(std::memory_order_acquire))
+	{
+		RecordActiveJob();
+	}
+	bool record = m_activeJob->m_recordId != 0 && dependencyCounter.Get().m_recordId != 0;
+	int64_t joinStartNS = 0;
+	int64_t excludedBeforeJoinNS = m_recordExcludedNS;
+	if (record)
+	{
+		RecordJoin(m_activeJob->m_recordId, dependencyCounter.Get().m_recordId);
+		joinStartNS = GetRecordingTimeNS();
+	}
+
+	while (dependencyCounter.Get().HasJobs())
 	{
-		ExecuteOuter(std::move(GetJobFromThisThread(m_jobQueues, true)));
+		JobPtr job = GetJobFromThisThread(m_jobQueues, true);
+		// Jobs we are waiting on may have been posted to mailboxes, so help with those to avoid waiting on threads that are busy
+		if (!job.IsValid())
+		{
+			job = GetJobFromMailbox(m_thisThreadIndex);
+		}
+		if (!job.IsValid())
+		{
+			job = GetJobFromOtherMailbox();
+		}
+		ExecuteOuter(std::move(job));
+	}
+
+	if (record)
+	{
+		m_recordExcludedNS = excludedBeforeJoinNS + (GetRecordingTimeNS() - joinStartNS);
 	}
 	DeallocateCounter(dependencyCounter);
 }
@@ -355,10 +585,26 @@ JobPtr Jobs::AllocateJob(JobFunc func, void* data, uint8_t flags)
 	m_jobInUse[m_thisThreadIndex][m_jobBufferHead]->store(true);
 	JobPtr job(m_jobs[m_jobBufferHead], m_jobBufferHead, m_thisThreadIndex);
 
-	// Set up new job
+	// Set up new job. Jobs left in the queues when a previous run stopped were never deallocated, so clear what DeallocateJob() would have.
 	job.Get().m_func = func;
 	job.Get().m_data = data;
 	job.Get().m_flags = flags;
+	job.Get().m_children = 0;
+	job.Get().m_parent = nullptr;
+	job.Get().m_decCounter = JobCounterPtr();
+	job.Get().m_decCounterLeaf = -1;
+	job.Get().m_waitCounter = JobCounterPtr();
+	if (m_recording.load(std::memory_order_acquire))
+	{
+		RecordActiveJob();
+		job.Get().m_recordId = ++m_nextRecordId;
+		job.Get().m_creatorRecordId = m_activeJob->m_recordId;
+		job.Get().m_recordCreateNS = GetRecordingTimeNS();
+	}
+	else
+	{
+		job.Get().m_recordId = 0;
+	}
 	// Don't track children for a job that calls itself
 	bool isChild = BIT_IS_SET(flags, JOBFLAG_ISCHILD);
 	if (isChild && m_activeJob != &m_nullJob && (m_activeJob->m_func != func || m_activeJob->m_data != data))
@@ -376,6 +622,7 @@ void Jobs::DeallocateJob(JobPtr& job)
 	int index = job.m_index;
 	job.m_index = -1;
 	job.m_job->m_decCounter = JobCounterPtr();
+	job.m_job->m_decCounterLeaf = -1;
 	job.m_job->m_waitCounter = JobCounterPtr();
 	job.m_job->m_parent = nullptr;
 	_ASSERT(m_jobInUse[job.m_parentThread][index]->load() == true);
@@ -384,7 +631,18 @@ void Jobs::DeallocateJob(JobPtr& job)
 
 JobPtr Jobs::GetJob()
 {
-	return GetJobInner(m_jobQueues);
+	// Jobs posted to this thread come first, as their data is likely to be in this thread's cache
+	JobPtr job = GetJobFromMailbox(m_thisThreadIndex);
+	if (!job.IsValid())
+	{
+		job = GetJobInner(m_jobQueues);
+	}
+	if (!job.IsValid())
+	{
+		// Nothing else to do - help out with jobs posted to other threads
+		job = GetJobFromOtherMailbox();
+	}
+	return job;
 }
 
 JobPtr Jobs::GetMainThreadJob()
@@ -418,20 +676,8 @@ JobPtr Jobs::GetJobFromThisThread(std::vector<JobStack>& queues, bool popOnly)
 		// Check that this job satisfies all the conditions needed to execute (not waiting for dependencies or children)
 		if (!job.HasDependencies() && !job.HasChildren())
 		{
-			// This job can run - If it needs disk access, see if we can acquire it
-			if (job.m_job->NeedsDiskActivity())
-			{
-				if (m_thisThreadCanReadDisk && _InterlockedCompareExchange8(&m_diskJobInProgress, CHAR_TRUE, CHAR_FALSE) == CHAR_FALSE)
-				{
-					// We can execute this job
-					break;
-				}
-			}
-			else
-			{
-				// We can execute this job
-				break;
-			}
+			// We can execute this job
+			break;
 		}
 
 		// We can't execute this job yet - put it aside and pick the next job
@@ -468,17 +714,39 @@ JobPtr Jobs::GetJobFromOtherThread(int threadIndex, std::vector<JobStack>& queue
 		queues[m_thisThreadIndex].Push(std::move(job));
 		job = JobPtr();
 	}
-	else if (job.m_job->NeedsDiskActivity())
+#if JOBS_COLLECT_METRICS
+	if (job.IsValid())
 	{
-		if (!m_thisThreadCanReadDisk || _InterlockedCompareExchange8(&m_diskJobInProgress, CHAR_TRUE, CHAR_FALSE) == CHAR_TRUE)
-		{
-			// This job requires disk access but we can't get disk access right now. Put it back (on this thread now)
-			queues[m_thisThreadIndex].Push(std::move(job));
-			job = JobPtr();
-		}
+		(*m_numStolenJobsExecutedPerThread[m_thisThreadIndex])++;
+	}
+#endif
+	return job;
+}
+
+JobPtr Jobs::GetJobFromMailbox(int threadIndex)
+{
+	JobMailbox& mailbox = *m_mailboxes[threadIndex];
+	if (mailbox.IsEmpty())
+	{
+		return JobPtr();
+	}
+	JobPtr job = mailbox.Take();
+	if (!job.IsValid())
+	{
+		return job;
+	}
+	if (job.HasDependencies() || job.HasChildren())
+	{
+		// Job is still waiting for dependencies or waiting for children to finish - Put it back (on this thread's queue now)
+		m_jobQueues[m_thisThreadIndex].Push(std::move(job));
+		return JobPtr();
 	}
 #if JOBS_COLLECT_METRICS
-	if (job.IsValid())
+	if (threadIndex == m_thisThreadIndex)
+	{
+		(*m_numMailboxJobsExecutedPerThread[m_thisThreadIndex])++;
+	}
+	else
 	{
 		(*m_numStolenJobsExecutedPerThread[m_thisThreadIndex])++;
 	}
@@ -486,6 +754,23 @@ JobPtr Jobs::GetJobFromOtherThread(int threadIndex, std::vector<JobStack>& queue
 	return job;
 }
 
+JobPtr Jobs::GetJobFromOtherMailbox()
+{
+	int threadIndex = m_thisThreadIndex;
+	JobPtr job;
+	do
+	{
+		threadIndex = threadIndex < m_maxThreadIndex ? (threadIndex + 1) : 0;
+		if (threadIndex == m_thisThreadIndex)
+		{
+			break;
+		}
+		job = GetJobFromMailbox(threadIndex);
+	}
+	while (!job.IsValid());
+	return job;
+}
+
 JobPtr Jobs::GetJobInner(std::vector<JobStack>& queues)
 {
 	int threadIndex = m_thisThreadIndex;
@@ -511,7 +796,13 @@ JobPtr Jobs::GetJobInner(std::vector<JobStack>& queues)
 	return job;
 }
 
-JobCounterPtr Jobs::AllocateCounter()
+void Jobs::AddJobToCounter(Job& job, JobCounterPtr& jobCounter)
+{
+	job.m_decCounter = jobCounter;
+	job.m_decCounterLeaf = (int8_t)jobCounter.Get().AddJob(m_counterLeafRotation++);
+}
+
+JobCounterPtr Jobs::AllocateCounter(bool isWide)
 {
 	// Search the job ring-buffer to find the first available job
 	m_counterBufferHead = (m_counterBufferHead + 1) & MAX_COUNTERS_PER_THREAD_MASK;
@@ -533,8 +824,16 @@ JobCounterPtr Jobs::AllocateCounter()
 		}
 	}
 	// Reset the counter
-	m_counters[m_counterBufferHead].m_numJobs = 0;
-	m_counters[m_counterBufferHead].m_numDependants = 0;
+	JobCounter& counter = m_counters[m_counterBufferHead];
+	counter.m_numJobs = 0;
+	counter.m_numDependants = 0;
+	counter.m_isWide = isWide;
+	counter.m_recordId = m_recording.load(std::memory_order_acquire) ? ++m_nextRecordId : 0;
+	for (auto& leaf : counter.m_leaves)
+	{
+		_ASSERT(leaf.m_numJobs == 0);
+		leaf.m_numJobs = 0;
+	}
 	// Assert to soft-check that this is thread-safe
 	_ASSERT(m_counterInUse[m_thisThreadIndex][m_counterBufferHead]->load() == false);
 	m_counterInUse[m_thisThreadIndex][m_counterBufferHead]->store(true);
@@ -549,4 +848,94 @@ void Jobs::DeallocateCounter(const JobCounterPtr& counter)
 	_ASSERT(counter.m_counter->m_numDependants == 0 && counter.m_counter->m_numJobs == 0);
 	_ASSERT(m_counterInUse[counter.m_parentThread][counter.m_index]->load() == true);
 	m_counterInUse[counter.m_parentThread][counter.m_index]->store(false);
+}
+
+void Jobs::BeginRecording()
+{
+	for (std::unique_ptr<JobRecordBuffer>& buffer : m_jobRecordBuffers)
+	{
+		std::lock_guard<std::mutex> lock(buffer->m_mutex);
+		buffer->m_jobs.clear();
+		buffer->m_joins.clear();
+	}
+	m_recordingStartTime = std::chrono::high_resolution_clock::now();
+	m_recording.store(true, std::memory_order_release);
+}
+
+bool Jobs::EndRecording(const std::string& path)
+{
+	// The job ending the recording won't finish until afterwards, so record it as ending now
+	if (m_activeJob->m_recordId != 0)
+	{
+		int64_t endNS = GetRecordingTimeNS();
+		RecordJob(*m_activeJob, m_activeJob->m_recordStartNS, endNS, endNS - m_activeJob->m_recordStartNS - m_recordExcludedNS);
+	}
+	m_recording = false;
+
+	JobRecording recording;
+	recording.m_numThreads = (int)m_jobRecordBuffers.size();
+	for (std::unique_ptr<JobRecordBuffer>& buffer : m_jobRecordBuffers)
+	{
+		std::lock_guard<std::mutex> lock(buffer->m_mutex);
+		recording.m_jobs.insert(recording.m_jobs.end(), buffer->m_jobs.begin(), buffer->m_jobs.end());
+		recording.m_joins.insert(recording.m_joins.end(), buffer->m_joins.begin(), buffer->m_joins.end());
+		buffer->m_jobs.clear();
+		buffer->m_joins.clear();
+	}
+	return recording.Save(path);
+}
+
+int64_t Jobs::GetRecordingTimeNS()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - m_recordingStartTime).count();
+}
+
+void Jobs::RecordActiveJob()
+{
+	if (m_activeJob != &m_nullJob && m_activeJob->m_recordId == 0)
+	{
+		m_activeJob->m_recordId = ++m_nextRecordId;
+		m_activeJob->m_creatorRecordId = 0;
+		m_activeJob->m_recordCreateNS = 0;
+		m_activeJob->m_recordStartNS = 0;
+	}
+}
+
+void Jobs::RecordJob(const Job& job, int64_t startNS, int64_t endNS, int64_t exclusiveNS)
+{
+	if (!m_recording.load(std::memory_order_relaxed))
+	{
+		// Recording ended while this job was running
+		return;
+	}
+
+	JobRecord record;
+	record.m_id = job.m_recordId;
+	record.m_func = (uint64_t)(uintptr_t)job.m_func;
+	record.m_flags = job.m_flags;
+	record.m_thread = m_thisThreadIndex;
+	record.m_createNS = job.m_recordCreateNS;
+	record.m_startNS = startNS;
+	record.m_endNS = endNS;
+	record.m_exclusiveNS = exclusiveNS;
+	record.m_creatorId = job.m_creatorRecordId;
+	record.m_parentId = job.m_parent != nullptr ? job.m_parent->m_recordId : 0;
+	record.m_decCounterId = job.m_decCounter.IsValid() ? job.m_decCounter.Get().m_recordId : 0;
+	record.m_waitCounterId = job.m_waitCounter.IsValid() ? job.m_waitCounter.Get().m_recordId : 0;
+
+	JobRecordBuffer& buffer = *m_jobRecordBuffers[m_thisThreadIndex];
+	std::lock_guard<std::mutex> lock(buffer.m_mutex);
+	buffer.m_jobs.push_back(record);
+}
+
+void Jobs::RecordJoin(uint32_t jobId, uint32_t counterId)
+{
+	if (!m_recording.load(std::memory_order_relaxed))
+	{
+		return;
+	}
+
+	JobRecordBuffer& buffer = *m_jobRecordBuffers[m_thisThreadIndex];
+	std::lock_guard<std::mutex> lock(buffer.m_mutex);
+	buffer.m_joins.push_back({ jobId, counterId });
 }
\ No newline at end of file
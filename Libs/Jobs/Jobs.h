@@ -1,7 +1,14 @@
 #pragma once
+#include "AffinityPartitioner.h"
 #include "Job.h"
+#include "JobMailbox.h"
+#include "JobRecording.h"
 #include "JobStack.h"
+#include <Memory/PoolAllocator.h>
 #include <array>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <thread>
 #include <vector>
 #include <functional>
@@ -32,6 +39,26 @@ struct PausedJob
 template<typename T>
 using ParallelForFunc = std::function<void(T*, size_t, size_t)>;
 
+/**
+ * Settings for automatically growing or shrinking the number of active threads with load.
+ * Every m_updateInterval, the main thread measures how often the active worker threads failed to find a job (the starvation ratio) and how many jobs are queued.
+ */
+struct ElasticThreadPolicy
+{
+	/** Whether the number of active threads is adjusted automatically */
+	bool m_enabled = false;
+	/** Minimum number of active threads, including the main thread */
+	int m_minThreads = 1;
+	/** Retire a thread if the starvation ratio is above this. Jobs may still be queued, but only ones that can't run yet. */
+	float m_shrinkStarvationRatio = 0.95f;
+	/** Activate a thread if the starvation ratio is below this */
+	float m_growStarvationRatio = 0.5f;
+	/** Activate a thread if more than this many jobs are queued per active thread, and the threads aren't starving */
+	int m_growQueueDepthPerThread = 8;
+	/** How often to re-evaluate the number of active threads */
+	std::chrono::milliseconds m_updateInterval = std::chrono::milliseconds(100);
+};
+
 class Jobs
 {
 public:
@@ -40,10 +67,20 @@ public:
 	/** Initialise job system with the given number of threads, and running mainJob on this thread. */
 	Jobs(int numThreads, JobFunc mainJob, void* mainJobData) { Init(numThreads, mainJob, mainJobData); }
 	/** Stops jobs from running */
-	static void Stop() { m_running = false; }
+	static void Stop();
 
-	/** Creates a counter for counting job dependencies.  */
-	static JobCounterPtr GetNewJobCounter() { return AllocateCounter(); }
+	/**
+	 * Sets the number of threads (including the main thread) that execute jobs, between 1 and the number of threads the system was initialised with.
+	 * Retired threads finish the jobs in their own queue and then sleep until they are needed again. Other threads can steal anything they leave behind.
+	 */
+	static void SetNumActiveThreads(int numThreads);
+	/** Returns the number of threads (including the main thread) that are currently executing jobs */
+	static int GetNumActiveThreads() { return m_numActiveThreads; }
+	/** Sets the policy for automatically adjusting the number of active threads. May be called before the job system is initialised. */
+	static void SetElasticPolicy(const ElasticThreadPolicy& policy) { m_elasticPolicy = policy; }
+
+	/** Creates a counter for counting job dependencies. Set isWide for counters that many jobs will be added to, so that they don't all contend on one cache line when completing. */
+	static JobCounterPtr GetNewJobCounter(bool isWide = false) { return AllocateCounter(isWide); }
 
 	/** Creates a job with no dependencies */
 	static void CreateJob(JobFunc func, void* data, uint8_t flags);
@@ -53,13 +90,51 @@ public:
 	static void CreateJobAndCount(JobFunc func, void* data, uint8_t flags, JobCounterPtr& jobCounter);
 	/** Create a job that will add to jobCounter when created, and decrement it when complete, but it will only execute once dependencyCounter is 0 */
 	static void CreateJobWithDependencyAndCount(JobFunc func, void* data, uint8_t flags, JobCounterPtr& dependencyCounter, JobCounterPtr& jobCounter);
+	/**
+	 * Create a job that will add to jobCounter when created, and decrement it when complete, and post it to the given thread's mailbox.
+	 * That thread will prefer it over its own jobs, but other threads may still take it if that thread is busy.
+	 * The job cannot be a main thread job.
+	 */
+	static void CreateJobWithAffinityAndCount(JobFunc func, void* data, uint8_t flags, JobCounterPtr& jobCounter, uint8_t threadIndex);
+	/**
+	 * Creates a job without queueing it, so that it won't run until it is passed to PostJob(). This lets work that finishes outside the job
+	 * system, such as a file read on an I/O thread, release a job without a job thread polling for it.
+	 * As the job is posted to a mailbox, it cannot be a main thread job.
+	 */
+	static JobPtr CreateUnqueuedJob(JobFunc func, void* data, uint8_t flags);
+	/** Creates a job without queueing it, that will add to jobCounter when created, and decrement it when complete. Pass it to PostJob() to run it. */
+	static JobPtr CreateUnqueuedJobAndCount(JobFunc func, void* data, uint8_t flags, JobCounterPtr& jobCounter);
+	/**
+	 * Posts a job from CreateUnqueuedJob() to the given thread's mailbox, or to another thread's if that one is full or retired.
+	 * May be called from any thread, including threads that aren't job threads.
+	 */
+	static void PostJob(JobPtr&& jobPtr, uint8_t threadIndex);
+	/** Returns the index of the job thread this is called from */
+	static uint8_t GetThisThreadIndex() { return m_thisThreadIndex; }
+	/** Returns the number of job threads the system was initialised with, including the main thread */
+	static size_t GetNumThreads() { return m_jobQueues.size(); }
+	/** Returns the index of the main thread, which is always the last thread */
+	static size_t GetMainThreadIndex() { return m_maxThreadIndex; }
 
-	/** Executes jobs exclusively from this thread's queue until the given counter is 0. The counter will then be deallocated automatically. */
+	/**
+	 * Executes jobs until the given counter is 0: from this thread's queue first, then its mailbox, then other threads' mailboxes, as the
+	 * jobs being waited on may have been posted there. It never steals from other threads' queues. The counter will then be deallocated automatically.
+	 */
 	static void JoinUntilCompleted(const JobCounterPtr& dependencyCounter);
 
 	static void PushJob(JobPtr&& jobPtr, bool mainThread);
 
-	bool IsRunning() { return m_running; }
+	/**
+	 * Starts recording every job that is created, with its timing and dependencies, so the job graph can be replayed in the job simulator.
+	 * Only jobs that are created and executed while recording are recorded.
+	 */
+	static void BeginRecording();
+	/** Stops recording and writes what was recorded to the given file. Returns false if the file could not be written. */
+	static bool EndRecording(const std::string& path);
+	/** Returns true while recording */
+	static bool IsRecording() { return m_recording; }
+
+	static bool IsRunning() { return m_running; }
 
 private:
 	/** Parallel-For data structure for meta job */
@@ -70,6 +145,9 @@ private:
 		size_t m_count;
 		size_t m_startIndex;
 		ParallelForFunc<T>* m_func;
+		/** Optional partitioner to record the executing thread in */
+		AffinityPartitioner* m_partitioner;
+		size_t m_chunkIndex;
 	};
 
 	/** Meta job that executes one chunk of a parallel-for */
@@ -77,27 +155,44 @@ private:
 	static void ParallelForJob(void* jobData)
 	{
 		const ParallelForJobData<T>* data = static_cast<const ParallelForJobData<T>*>(jobData);
+		if (data->m_partitioner)
+		{
+			data->m_partitioner->RecordThread(data->m_chunkIndex, m_thisThreadIndex);
+		}
 		(*data->m_func)(data->m_data, data->m_count, data->m_startIndex);
 	}
 
-public:
-	/** Creates a number of individual jobs that will process chunks of the given data as a parallel-for-loop */
+	/** Shared implementation of ParallelFor, with an optional affinity partitioner */
 	template<typename T>
-	static void ParallelFor(T* dataStart, size_t count, size_t chunkSize, ParallelForFunc<T> func)
+	static void ParallelForInner(T* dataStart, size_t count, size_t chunkSize, ParallelForFunc<T>& func, AffinityPartitioner* partitioner)
 	{
 		T* dataEnd = dataStart + count;
 		T* dataCurrent = dataStart;
-		JobCounterPtr counter = GetNewJobCounter();
+		size_t numChunks = (count + chunkSize - 1) / chunkSize;
+		JobCounterPtr counter = GetNewJobCounter(numChunks >= PARALLELFOR_WIDE_COUNTER_MIN_CHUNKS);
 		// ParallelForJobData objects must persist so the jobData pointer points at valid data
-		std::vector<ParallelForJobData<T>> jobData;
-		int dataIndex = 0;
-		jobData.reserve((count / chunkSize) + 1);
+		PoolVector<ParallelForJobData<T>> jobData;
+		size_t dataIndex = 0;
+		jobData.reserve(numChunks);
+		if (partitioner)
+		{
+			partitioner->Prepare(numChunks);
+		}
 		// Spawn multiple jobs that each operate on a different chunk of data
 		while (dataCurrent != dataEnd)
 		{
 			size_t thisChunkSize = std::min(size_t(dataEnd - dataCurrent), chunkSize);
-			jobData.push_back({dataCurrent, thisChunkSize, size_t(dataCurrent - dataStart), &func});
-			CreateJobAndCount(ParallelForJob<T>, &jobData[dataIndex], JOBFLAG_NONE | JOBFLAG_DEBUG, counter);
+			jobData.push_back({dataCurrent, thisChunkSize, size_t(dataCurrent - dataStart), &func, partitioner, dataIndex});
+			// Send the chunk back to the thread that executed it last time, if it wasn't this one
+			uint8_t affinity = partitioner ? partitioner->GetThread(dataIndex) : AffinityPartitioner::NO_AFFINITY;
+			if (affinity == AffinityPartitioner::NO_AFFINITY || affinity == m_thisThreadIndex)
+			{
+				CreateJobAndCount(ParallelForJob<T>, &jobData[dataIndex], JOBFLAG_NONE | JOBFLAG_DEBUG, counter);
+			}
+			else
+			{
+				CreateJobWithAffinityAndCount(ParallelForJob<T>, &jobData[dataIndex], JOBFLAG_NONE | JOBFLAG_DEBUG, counter, affinity);
+			}
 			dataIndex++;
 			dataCurrent += thisChunkSize;
 		}
@@ -105,6 +200,24 @@ public:
 		JoinUntilCompleted(counter);
 	}
 
+public:
+	/** Creates a number of individual jobs that will process chunks of the given data as a parallel-for-loop */
+	template<typename T>
+	static void ParallelFor(T* dataStart, size_t count, size_t chunkSize, ParallelForFunc<T> func)
+	{
+		ParallelForInner(dataStart, count, chunkSize, func, nullptr);
+	}
+
+	/**
+	 * Creates a number of individual jobs that will process chunks of the given data as a parallel-for-loop.
+	 * Each chunk is sent to the thread that executed it in the last ParallelFor using this partitioner, to make better use of that thread's cache.
+	 */
+	template<typename T>
+	static void ParallelFor(T* dataStart, size_t count, size_t chunkSize, ParallelForFunc<T> func, AffinityPartitioner& partitioner)
+	{
+		ParallelForInner(dataStart, count, chunkSize, func, &partitioner);
+	}
+
 private:
 	void Init(int numThreads, JobFunc mainJob, void* mainJobData);
 
@@ -127,15 +240,39 @@ private:
 	static JobPtr GetJobFromOtherThread(int threadIndex, std::vector<JobStack>& queues);
 	/** Returns a Job to be actioned on the main thread. */
 	static JobPtr GetMainThreadJob();
+	/** Returns a Job from the given thread's mailbox to be actioned. */
+	static JobPtr GetJobFromMailbox(int threadIndex);
+	/** Returns a Job from any other thread's mailbox to be actioned. */
+	static JobPtr GetJobFromOtherMailbox();
+
+	/** Returns true if the given thread should be executing jobs */
+	static bool IsThreadActive(int threadIndex) { return threadIndex == m_maxThreadIndex || threadIndex < m_numActiveThreads - 1; }
+	/** Sleeps this thread until it is made active again, or the job system stops */
+	static void ParkThread();
+	/** Waits for every thread to stop taking jobs, so none can still be reading this thread's jobs when it exits and frees them */
+	static void WaitForThreadsToStop();
+	/** Grows or shrinks the number of active threads according to m_elasticPolicy. Called periodically from the main thread. */
+	static void UpdateElasticThreads();
 	/** Helper method for GetJob() and GetMainThreadJob(). */
 	static JobPtr GetJobInner(std::vector<JobStack>& queues);
 	/** Returns a reference to a counter for use with job dependencies */
-	static JobCounterPtr AllocateCounter();
+	static JobCounterPtr AllocateCounter(bool isWide);
+	/** Adds the job to the counter, remembering which leaf it was added to */
+	static void AddJobToCounter(Job& job, JobCounterPtr& jobCounter);
 	/** Frees a counter from the counter buffer */
 	static void DeallocateCounter(const JobCounterPtr& counter);
 
 	static void Execute(Job& job);
 
+	/** Returns the time since recording began */
+	static int64_t GetRecordingTimeNS();
+	/** Gives the job this thread is executing a recording ID if it doesn't have one, because it started before recording began */
+	static void RecordActiveJob();
+	/** Adds a job that has just executed to the recording */
+	static void RecordJob(const Job& job, int64_t startNS, int64_t endNS, int64_t exclusiveNS);
+	/** Adds a job waiting on a counter to the recording */
+	static void RecordJoin(uint32_t jobId, uint32_t counterId);
+
 private:
 	// Maximum number of jobs per-thread. Must be a power-of-two.
 	static constexpr int MAX_JOBS_PER_THREAD = 4096;
@@ -159,11 +296,17 @@ private:
 	static thread_local std::array<JobCounter, MAX_COUNTERS_PER_THREAD>& m_counters;
 	static std::vector<std::array<std::unique_ptr<std::atomic<bool>>, MAX_COUNTERS_PER_THREAD>> m_counterInUse;	// per-thread, accessed from other threads
 	static thread_local uint32_t m_counterBufferHead;
+	// Rotates the leaf that jobs created on this thread are added to in wide counters
+	static thread_local uint32_t m_counterLeafRotation;
+	// ParallelFors with at least this many chunks use a wide counter
+	static constexpr size_t PARALLELFOR_WIDE_COUNTER_MIN_CHUNKS = 16;
 
 	// Job queue per thread
 	static std::vector<JobStack> m_jobQueues;
 	// Job queues per thread, for execution on the main thread only. The main thread will steal these jobs.
 	static std::vector<JobStack> m_mainThreadJobQueues;
+	// Mailbox per thread, for jobs that should preferably run on that thread. Any thread may post to or take from these.
+	static std::vector<std::unique_ptr<JobMailbox>> m_mailboxes;
 	// Per thread, a temporary buffer for deferring jobs that can't be executed yet. 
 	static thread_local std::array<JobPtr, MAX_JOBS_PER_THREAD>& m_deferredJobs;
 	// Threads
@@ -171,24 +314,49 @@ private:
 	static thread_local uint8_t m_thisThreadIndex;
 	static uint8_t m_maxThreadIndex;
 	static bool m_running;
+	// Number of threads that may still take jobs
+	static std::atomic<int> m_numRunningThreads;
+
+	// Elastic thread count
+	static std::atomic<int> m_numActiveThreads;
+	static ElasticThreadPolicy m_elasticPolicy;
+	static std::chrono::time_point<std::chrono::high_resolution_clock> m_lastElasticUpdateTime;
+	// Mutex and condition variable for waking retired threads
+	static std::mutex m_parkMutex;
+	static std::condition_variable m_parkCondition;
+	/** Per-thread loop counts since the last elastic update. Always collected, unlike the metrics below. */
+	struct alignas(64) ElasticLoopCounters
+	{
+		std::atomic<int> m_numExecutedLoops = 0;
+		std::atomic<int> m_numStarvedLoops = 0;
+	};
+	static std::vector<std::unique_ptr<ElasticLoopCounters>> m_elasticLoopCounters;
 	// The job currently running on this thread
 	static thread_local Job* m_activeJob;
 	// Null job, used as a placeholder activeJob to avoid some branches
 	static Job m_nullJob;
 
-	// Boolean that a thread can attempt to take for executing disk read jobs
-	static thread_local bool m_thisThreadCanReadDisk;
-	static char m_diskJobInProgress;
-	static constexpr char CHAR_TRUE = 1;
-	static constexpr char CHAR_FALSE = 0;
+	// Job recording
+	static std::atomic<bool> m_recording;
+	static std::atomic<uint32_t> m_nextRecordId;
+	static std::chrono::time_point<std::chrono::high_resolution_clock> m_recordingStartTime;
+	/** Per-thread recorded jobs. Only locked while recording, and then only by the owning thread until EndRecording(). */
+	struct JobRecordBuffer
+	{
+		std::mutex m_mutex;
+		std::vector<JobRecord> m_jobs;
+		std::vector<JobJoinRecord> m_joins;
+	};
+	static std::vector<std::unique_ptr<JobRecordBuffer>> m_jobRecordBuffers;
+	// Time this thread has spent in nested jobs and joins during the job it is executing, which is excluded from that job's recorded time
+	static thread_local int64_t m_recordExcludedNS;
 
 	// DEBUG THINGS
 #if JOBS_COLLECT_METRICS
 public:
-	static size_t GetNumThreads() { return m_jobQueues.size(); }
-	static size_t GetMainThreadIndex() { return m_mainThreadIndex; }
 	static int GetNumStolenJobs(size_t threadIndex) { return m_numStolenJobsExecutedPerThread[threadIndex]->load(); }
 	static int GetNumOwnJobs(size_t threadIndex) { return m_numOwnJobsExecutedPerThread[threadIndex]->load(); }
+	static int GetNumMailboxJobs(size_t threadIndex) { return m_numMailboxJobsExecutedPerThread[threadIndex]->load(); }
 	static int GetNumExecutedLoops(size_t threadIndex) { return m_numExecutedLoopsPerThread[threadIndex]->load(); }
 	static int GetNumStarvedLoops(size_t threadIndex) { return m_numStarvedLoopsPerThread[threadIndex]->load(); }
 	static int GetNumJobsCreated(size_t threadIndex) { return m_numJobsCreatedPerThread[threadIndex]->load(); }
@@ -202,6 +370,7 @@ public:
 		{
 			m_numStolenJobsExecutedPerThread[i]->store(0);
 			m_numOwnJobsExecutedPerThread[i]->store(0);
+			m_numMailboxJobsExecutedPerThread[i]->store(0);
 			m_numExecutedLoopsPerThread[i]->store(0);
 			m_numStarvedLoopsPerThread[i]->store(0);
 			m_numJobsCreatedPerThread[i]->store(0);
@@ -213,11 +382,12 @@ public:
 	}
 
 private:
-	static size_t m_mainThreadIndex;
 	// Number of steals each thread has performed
 	static std::vector<std::unique_ptr<std::atomic<int>>> m_numStolenJobsExecutedPerThread;
 	// Number of own-thread jobs each thread has performed
 	static std::vector<std::unique_ptr<std::atomic<int>>> m_numOwnJobsExecutedPerThread;
+	// Number of jobs from its own mailbox each thread has performed
+	static std::vector<std::unique_ptr<std::atomic<int>>> m_numMailboxJobsExecutedPerThread;
 	// Per thread, how many loops executed a job
 	static std::vector<std::unique_ptr<std::atomic<int>>> m_numExecutedLoopsPerThread;
 	// Per thread, how many loops didn't execute a job
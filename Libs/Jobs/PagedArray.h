@@ -0,0 +1,72 @@
+#pragma once
+#include "Jobs.h"
+#include <Memory/PageAllocator.h>
+#include <new>
+#include <type_traits>
+
+/**
+ * PagedArray
+ * A fixed-size array for big working sets that ParallelFors pass over every frame, e.g. every object's transform.
+ * Its memory comes straight from the OS, backed by huge pages where possible, so passes over it take fewer TLB misses.
+ *
+ * Items are constructed by a ParallelFor using the same AffinityPartitioner as the passes over the array, so each chunk's pages
+ * are first written by the thread that goes on to process that chunk. On a NUMA machine, that puts them on that thread's node.
+ * The OS places whole pages, so chunks of at least a huge page let placement follow the chunks exactly.
+ */
+template<typename T>
+class PagedArray
+{
+public:
+	PagedArray() = default;
+	PagedArray(const PagedArray&) = delete;
+	PagedArray& operator=(const PagedArray&) = delete;
+	~PagedArray() { Release(); }
+
+	/** Allocates count items, and constructs them in a ParallelFor with the given chunk size and partitioner. Only call from job threads. */
+	void Init(size_t count, size_t chunkSize, AffinityPartitioner& partitioner)
+	{
+		Release();
+		m_items = static_cast<T*>(PageAllocator::Allocate(count * sizeof(T), alignof(T), HugePageMode::PREFERRED));
+		_ASSERT(m_items != nullptr);
+		m_size = count;
+		Jobs::ParallelFor<T>(m_items, count, chunkSize, [](T* chunk, size_t chunkCount, size_t startIndex)
+			{
+				for (size_t i = 0; i < chunkCount; i++)
+				{
+					new (&chunk[i]) T();
+				}
+			}, partitioner);
+	}
+
+	T* data() { return m_items; }
+	const T* data() const { return m_items; }
+	size_t size() const { return m_size; }
+	T& operator[](size_t index) { return m_items[index]; }
+	const T& operator[](size_t index) const { return m_items[index]; }
+	T* begin() { return m_items; }
+	T* end() { return m_items + m_size; }
+
+private:
+	/** Destroys every item and frees the memory */
+	void Release()
+	{
+		if (m_items == nullptr)
+		{
+			return;
+		}
+		if constexpr (!std::is_trivially_destructible_v<T>)
+		{
+			for (size_t i = 0; i < m_size; i++)
+			{
+				m_items[i].~T();
+			}
+		}
+		PageAllocator::Free(m_items, m_size * sizeof(T), HugePageMode::PREFERRED);
+		m_items = nullptr;
+		m_size = 0;
+	}
+
+private:
+	T* m_items = nullptr;
+	size_t m_size = 0;
+};
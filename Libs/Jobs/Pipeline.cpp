@@ -0,0 +1,235 @@
+#include "pch.h"
+#include "Pipeline.h"
+#include "Jobs.h"
+
+void Pipeline::AddStage(PipelineStageMode mode, StageFunc func, uint8_t flags)
+{
+	// The input stage produces items one at a time
+	_ASSERT(!m_stages.empty() || mode != PipelineStageMode::PARALLEL);
+
+	std::unique_ptr<Stage> stage = std::make_unique<Stage>();
+	stage->m_pipeline = this;
+	stage->m_index = m_stages.size();
+	stage->m_mode = mode;
+	stage->m_func = std::move(func);
+	stage->m_flags = flags;
+	m_stages.push_back(std::move(stage));
+}
+
+void Pipeline::Run(int maxTokens)
+{
+	_ASSERT(!m_stages.empty());
+	_ASSERT(maxTokens > 0);
+
+	// Set up the tokens, all initially free
+	m_tokens.assign(maxTokens, Token());
+	m_takenFreeTokens = nullptr;
+	for (int i = 0; i < maxTokens; i++)
+	{
+		m_tokens[i].m_pipeline = this;
+		m_tokens[i].m_next = i + 1 < maxTokens ? &m_tokens[i + 1] : nullptr;
+	}
+	m_freeTokens = &m_tokens[0];
+
+	// Set up the stages. Items at an in-order stage are at most maxTokens apart in sequence, so each has its own reorder slot.
+	for (std::unique_ptr<Stage>& stage : m_stages)
+	{
+		stage->m_busy = false;
+		stage->m_nextSequence = 0;
+		stage->m_pending = nullptr;
+		stage->m_taken = nullptr;
+		if (stage->m_mode == PipelineStageMode::SERIAL_IN_ORDER)
+		{
+			stage->m_reorderSlots = std::make_unique<std::atomic<Token*>[]>(maxTokens);
+			for (int i = 0; i < maxTokens; i++)
+			{
+				stage->m_reorderSlots[i] = nullptr;
+			}
+		}
+	}
+
+	m_inputDone = false;
+	m_nextInputSequence = 0;
+	m_counter = Jobs::GetNewJobCounter();
+
+	// Start pulling items. Every job created from here on is counted before the job creating it completes, so the counter only reaches zero once every item has passed the final stage.
+	m_inputBusy = true;
+	Jobs::CreateJobAndCount(InputJob, this, m_stages[0]->m_flags, m_counter);
+	Jobs::JoinUntilCompleted(m_counter);
+
+	m_tokens.clear();
+	m_freeTokens = nullptr;
+}
+
+void Pipeline::PassToStage(Token* token, size_t stageIndex)
+{
+	if (stageIndex == m_stages.size())
+	{
+		// Item has passed the final stage
+		FreeToken(token);
+		TryStartInput();
+		return;
+	}
+
+	token->m_stage = stageIndex;
+	Stage& stage = *m_stages[stageIndex];
+	switch (stage.m_mode)
+	{
+	case PipelineStageMode::PARALLEL:
+		Jobs::CreateJobAndCount(ParallelStageJob, token, stage.m_flags, m_counter);
+		break;
+	case PipelineStageMode::SERIAL_IN_ORDER:
+		stage.m_reorderSlots[token->m_sequence % m_tokens.size()].store(token);
+		TryStartDrain(stage);
+		break;
+	case PipelineStageMode::SERIAL_OUT_OF_ORDER:
+		token->m_next = stage.m_pending.load(std::memory_order_relaxed);
+		while (!stage.m_pending.compare_exchange_weak(token->m_next, token)) { }
+		TryStartDrain(stage);
+		break;
+	}
+}
+
+void Pipeline::TryStartDrain(Stage& stage)
+{
+	if (!stage.m_busy.exchange(true))
+	{
+		Jobs::CreateJobAndCount(DrainStageJob, &stage, stage.m_flags, m_counter);
+	}
+}
+
+void Pipeline::TryStartInput()
+{
+	if (!m_inputDone.load(std::memory_order_relaxed) && !m_inputBusy.exchange(true))
+	{
+		Jobs::CreateJobAndCount(InputJob, this, m_stages[0]->m_flags, m_counter);
+	}
+}
+
+Pipeline::Token* Pipeline::TakeNextToken(Stage& stage)
+{
+	if (stage.m_mode == PipelineStageMode::SERIAL_IN_ORDER)
+	{
+		std::atomic<Token*>& slot = stage.m_reorderSlots[stage.m_nextSequence % m_tokens.size()];
+		Token* token = slot.load(std::memory_order_acquire);
+		if (token == nullptr)
+		{
+			// The next item in order hasn't arrived yet
+			return nullptr;
+		}
+		_ASSERT(token->m_sequence == stage.m_nextSequence);
+		slot.store(nullptr, std::memory_order_relaxed);
+		stage.m_nextSequence++;
+		return token;
+	}
+
+	if (stage.m_taken == nullptr)
+	{
+		// Take every pending item at once, so there is no ABA problem with other threads pushing
+		stage.m_taken = stage.m_pending.exchange(nullptr, std::memory_order_acquire);
+	}
+	Token* token = stage.m_taken;
+	if (token != nullptr)
+	{
+		stage.m_taken = token->m_next;
+	}
+	return token;
+}
+
+std::atomic<Pipeline::Token*>& Pipeline::GetArrivalSlot(Stage& stage)
+{
+	if (stage.m_mode == PipelineStageMode::SERIAL_IN_ORDER)
+	{
+		return stage.m_reorderSlots[stage.m_nextSequence % m_tokens.size()];
+	}
+	return stage.m_pending;
+}
+
+Pipeline::Token* Pipeline::TakeFreeToken()
+{
+	if (m_takenFreeTokens == nullptr)
+	{
+		m_takenFreeTokens = m_freeTokens.exchange(nullptr, std::memory_order_acquire);
+	}
+	Token* token = m_takenFreeTokens;
+	if (token != nullptr)
+	{
+		m_takenFreeTokens = token->m_next;
+	}
+	return token;
+}
+
+void Pipeline::FreeToken(Token* token)
+{
+	token->m_item = nullptr;
+	token->m_next = m_freeTokens.load(std::memory_order_relaxed);
+	while (!m_freeTokens.compare_exchange_weak(token->m_next, token)) { }
+}
+
+void Pipeline::ParallelStageJob(void* data)
+{
+	Token* token = static_cast<Token*>(data);
+	Pipeline* pipeline = token->m_pipeline;
+	token->m_item = pipeline->m_stages[token->m_stage]->m_func(token->m_item);
+	pipeline->PassToStage(token, token->m_stage + 1);
+}
+
+void Pipeline::DrainStageJob(void* data)
+{
+	Stage& stage = *static_cast<Stage*>(data);
+	Pipeline* pipeline = stage.m_pipeline;
+	while (true)
+	{
+		while (Token* token = pipeline->TakeNextToken(stage))
+		{
+			token->m_item = stage.m_func(token->m_item);
+			pipeline->PassToStage(token, stage.m_index + 1);
+		}
+
+		// An item may arrive after we last looked, but before the stage is released, in which case nobody else would drain it.
+		// The arrival and the release are both sequentially consistent, so either the arriving thread sees the stage released, or we see the item.
+		std::atomic<Token*>& arrivalSlot = pipeline->GetArrivalSlot(stage);
+		stage.m_busy = false;
+		if (arrivalSlot.load() == nullptr || stage.m_busy.exchange(true))
+		{
+			return;
+		}
+	}
+}
+
+DEFINE_CLASS_JOB(Pipeline, InputJob)
+{
+	Stage& stage = *m_stages[0];
+	while (true)
+	{
+		while (!m_inputDone.load(std::memory_order_relaxed))
+		{
+			Token* token = TakeFreeToken();
+			if (token == nullptr)
+			{
+				// All tokens are in flight - the next item to complete restarts the input
+				break;
+			}
+
+			void* item = stage.m_func(nullptr);
+			if (item == nullptr)
+			{
+				m_inputDone.store(true, std::memory_order_relaxed);
+				FreeToken(token);
+				break;
+			}
+
+			token->m_item = item;
+			token->m_sequence = m_nextInputSequence++;
+			PassToStage(token, 1);
+		}
+
+		// A token may be freed after we last looked, but before the input is released, in which case nobody else would restart the input
+		bool inputDone = m_inputDone.load(std::memory_order_relaxed);
+		m_inputBusy = false;
+		if (inputDone || m_freeTokens.load() == nullptr || m_inputBusy.exchange(true))
+		{
+			return;
+		}
+	}
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include "Job.h"
+#include "JobDecl.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/** How a pipeline stage may process its items */
+enum class PipelineStageMode
+{
+	/** One item at a time, in the order the input stage produced them */
+	SERIAL_IN_ORDER,
+	/** One item at a time, in any order */
+	SERIAL_OUT_OF_ORDER,
+	/** Any number of items at once */
+	PARALLEL,
+};
+
+/**
+ * A streaming pipeline of stages that items flow through, e.g. read -> decompress -> parse -> optimise -> upload-prep.
+ * Each item is processed in a job per stage, so different items can be in different stages at once, and parallel stages can process many items at once.
+ *
+ * The first stage is the input stage. It is called with nullptr and returns the next item, or nullptr when there are no more items. It must be serial.
+ * Every other stage is called with the item returned by the previous stage, and returns the item to pass to the next stage.
+ * At most maxTokens items are in flight at once, which bounds the memory used by items.
+ * Items are handed between stages without locks.
+ *
+ * NOTE: Run() waits by executing jobs from this thread's queue, so stages with JOBFLAG_MAINTHREAD must not be used when running from the main thread.
+ */
+class Pipeline
+{
+public:
+	/** Function run on each item in a stage. Takes the item from the previous stage, and returns the item for the next stage. */
+	using StageFunc = std::function<void*(void*)>;
+
+	Pipeline() = default;
+	Pipeline(const Pipeline&) = delete;
+	Pipeline& operator=(const Pipeline&) = delete;
+
+	/** Appends a stage to the pipeline. flags are JobFlags to create this stage's jobs with. */
+	void AddStage(PipelineStageMode mode, StageFunc func, uint8_t flags = JOBFLAG_NONE);
+	/** Runs items through the pipeline until the input stage returns nullptr, with at most maxTokens items in flight. Returns once every item has completed. */
+	void Run(int maxTokens);
+
+private:
+	struct Stage;
+
+	/** An item in flight. There are maxTokens of these, which are recycled once an item leaves the final stage. */
+	struct Token
+	{
+		Pipeline* m_pipeline = nullptr;
+		/** The item being processed */
+		void* m_item = nullptr;
+		/** Order the item was produced by the input stage */
+		uint64_t m_sequence = 0;
+		/** Index of the stage this item is in */
+		size_t m_stage = 0;
+		/** Next token in whichever list this token is in */
+		Token* m_next = nullptr;
+	};
+
+	struct Stage
+	{
+		Pipeline* m_pipeline = nullptr;
+		size_t m_index = 0;
+		PipelineStageMode m_mode = PipelineStageMode::PARALLEL;
+		StageFunc m_func;
+		uint8_t m_flags = JOBFLAG_NONE;
+		/** Serial stages: true while a job is draining this stage */
+		std::atomic<bool> m_busy = false;
+		/** SERIAL_IN_ORDER: Sequence number of the next item to process. Only accessed by the draining job. */
+		uint64_t m_nextSequence = 0;
+		/** SERIAL_IN_ORDER: Items waiting to be processed, indexed by sequence number modulo the number of tokens */
+		std::unique_ptr<std::atomic<Token*>[]> m_reorderSlots;
+		/** SERIAL_OUT_OF_ORDER: Lock-free stack of items waiting to be processed. Any thread pushes, the draining job takes the whole stack at once. */
+		std::atomic<Token*> m_pending = nullptr;
+		/** SERIAL_OUT_OF_ORDER: Items taken from m_pending that are still to be processed. Only accessed by the draining job. */
+		Token* m_taken = nullptr;
+	};
+
+	/** Sends the token to the given stage, or recycles it if it has passed the final stage */
+	void PassToStage(Token* token, size_t stageIndex);
+	/** Starts a job to drain the serial stage if one isn't running already */
+	void TryStartDrain(Stage& stage);
+	/** Starts a job to run the input stage if one isn't running already and there are free tokens */
+	void TryStartInput();
+	/** Returns the next item the serial stage can process, or nullptr if it must wait */
+	Token* TakeNextToken(Stage& stage);
+	/** Returns the atomic that the next item the serial stage can process will be stored in when it arrives. Only called by the draining job. */
+	std::atomic<Token*>& GetArrivalSlot(Stage& stage);
+	/** Returns a free token, or nullptr if all tokens are in flight. Only called by the input job. */
+	Token* TakeFreeToken();
+	/** Returns a token to the free list. May be called from any thread. */
+	void FreeToken(Token* token);
+
+	/** Runs one item through a PARALLEL stage */
+	static void ParallelStageJob(void* data);
+	/** Processes items in a serial stage until none are ready */
+	static void DrainStageJob(void* data);
+	/** Pulls items from the input stage while there are free tokens */
+	DECLARE_CLASS_JOB(Pipeline, InputJob);
+
+private:
+	std::vector<std::unique_ptr<Stage>> m_stages;
+	std::vector<Token> m_tokens;
+	/** Lock-free stack of free tokens. Any thread pushes, the input job takes the whole stack at once. */
+	std::atomic<Token*> m_freeTokens = nullptr;
+	/** Free tokens taken from m_freeTokens. Only accessed by the input job. */
+	Token* m_takenFreeTokens = nullptr;
+	/** True while a job is running the input stage */
+	std::atomic<bool> m_inputBusy = false;
+	/** True once the input stage has returned nullptr */
+	std::atomic<bool> m_inputDone = false;
+	/** Sequence number of the next item from the input stage. Only accessed by the input job. */
+	uint64_t m_nextInputSequence = 0;
+	/** Counts every job this pipeline creates, so Run() knows when all items have completed */
+	JobCounterPtr m_counter;
+};
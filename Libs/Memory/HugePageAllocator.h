@@ -0,0 +1,45 @@
+#pragma once
+#include "PageAllocator.h"
+#include <new>
+#include <vector>
+
+/**
+ * STL allocator that gets memory straight from PageAllocator, backed by huge pages where possible.
+ * Only for big, long-lived arrays: every allocation takes at least a whole page, and costs a system call.
+ * Pages are placed on the NUMA node of the thread that first writes them, so fill the container on the thread that will use it.
+ */
+template<typename T>
+struct HugePageAllocator
+{
+	using value_type = T;
+	using is_always_equal = std::true_type;
+
+	HugePageAllocator() = default;
+	template<typename U>
+	HugePageAllocator(const HugePageAllocator<U>&) { }
+
+	T* allocate(size_t count)
+	{
+		void* ptr = PageAllocator::Allocate(count * sizeof(T), alignof(T), HugePageMode::PREFERRED);
+		if (ptr == nullptr)
+		{
+			// Containers expect allocators to throw rather than return nullptr
+			throw std::bad_alloc();
+		}
+		return static_cast<T*>(ptr);
+	}
+
+	void deallocate(T* ptr, size_t count)
+	{
+		PageAllocator::Free(ptr, count * sizeof(T), HugePageMode::PREFERRED);
+	}
+
+	template<typename U>
+	bool operator==(const HugePageAllocator<U>&) const { return true; }
+	template<typename U>
+	bool operator!=(const HugePageAllocator<U>&) const { return false; }
+};
+
+/** A vector whose memory comes straight from the OS, backed by huge pages where possible */
+template<typename T>
+using HugePageVector = std::vector<T, HugePageAllocator<T>>;
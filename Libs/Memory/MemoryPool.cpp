@@ -0,0 +1,397 @@
+#include "pch.h"
+#include "MemoryPool.h"
+#include "PageAllocator.h"
+#include <new>
+
+thread_local MemoryPool::ThreadCache* MemoryPool::m_threadCache = nullptr;
+thread_local bool MemoryPool::m_threadExited = false;
+thread_local MemoryPool::ThreadCacheHolder MemoryPool::m_threadCacheHolder;
+
+MemoryPool::ThreadCache* MemoryPool::m_idleCaches = nullptr;
+MemoryPool::Span* MemoryPool::m_freeSpans = nullptr;
+size_t MemoryPool::m_numFreeSpans = 0;
+std::mutex MemoryPool::m_globalMutex;
+
+bool MemoryPool::m_useHugePages = false;
+std::atomic<size_t> MemoryPool::m_reservedBytes = 0;
+std::atomic<size_t> MemoryPool::m_numSpansInUse = 0;
+std::atomic<size_t> MemoryPool::m_largeBytes = 0;
+
+namespace
+{
+	constexpr size_t PAGE_SIZE = 4096;
+
+	size_t RoundUp(size_t size, size_t alignment)
+	{
+		return (size + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+void* MemoryPool::Allocate(size_t size)
+{
+	if (size <= MAX_SMALL_SIZE)
+	{
+		ThreadCache* cache = GetThreadCache();
+		if (cache != nullptr)
+		{
+			return AllocateSmall(*cache, GetSizeClass(size));
+		}
+		// This thread is exiting and has given up its cache
+	}
+	return AllocateLarge(size);
+}
+
+void MemoryPool::Free(void* ptr)
+{
+	if (ptr == nullptr)
+	{
+		return;
+	}
+	Span* span = GetSpan(ptr);
+	if (span->m_largeSize > 0)
+	{
+		FreeLarge(span);
+		return;
+	}
+
+	FreeBlock* block = static_cast<FreeBlock*>(ptr);
+	ThreadCache* cache = m_threadCache;
+	if (cache != span->m_owner)
+	{
+		FreeRemote(*span, block);
+		return;
+	}
+
+	block->m_next = span->m_localFrees;
+	span->m_localFrees = block;
+	_ASSERT(span->m_numUsed > 0);
+	span->m_numUsed--;
+
+	if (!span->m_inList)
+	{
+		// The span is full, or another thread has freed into it and it's waiting in the reclaim stack.
+		// If it's full, this free makes it usable again.
+		uintptr_t expected = FULL_FLAG;
+		if (span->m_remoteFrees.compare_exchange_strong(expected, 0, std::memory_order_relaxed))
+		{
+			LinkSpan(*cache, *span);
+		}
+	}
+	else if (span->m_numUsed == 0 && cache->m_spans[span->m_sizeClass] != span)
+	{
+		// Keep the span being allocated from, so alternating allocations and frees don't take spans from the pool each time
+		UnlinkSpan(*cache, *span);
+		ReleaseSpan(*span);
+	}
+}
+
+MemoryPoolStats MemoryPool::GetStats()
+{
+	MemoryPoolStats stats;
+	stats.m_reservedBytes = m_reservedBytes.load(std::memory_order_relaxed);
+	stats.m_numSpansInUse = m_numSpansInUse.load(std::memory_order_relaxed);
+	stats.m_largeBytes = m_largeBytes.load(std::memory_order_relaxed);
+	std::lock_guard<std::mutex> lock(m_globalMutex);
+	stats.m_numFreeSpans = m_numFreeSpans;
+	return stats;
+}
+
+MemoryPool::ThreadCacheHolder::~ThreadCacheHolder()
+{
+	if (m_threadCache != nullptr)
+	{
+		// The cache keeps the spans that are still in use, and ones other threads free into wait in its reclaim stack for the next owner
+		ReleaseEmptySpans(*m_threadCache);
+		std::lock_guard<std::mutex> lock(m_globalMutex);
+		m_threadCache->m_nextIdle = m_idleCaches;
+		m_idleCaches = m_threadCache;
+	}
+	m_threadCache = nullptr;
+	m_threadExited = true;
+}
+
+MemoryPool::ThreadCache* MemoryPool::GetThreadCache()
+{
+	if (m_threadCache != nullptr || m_threadExited)
+	{
+		return m_threadCache;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_globalMutex);
+		if (m_idleCaches != nullptr)
+		{
+			m_threadCache = m_idleCaches;
+			m_idleCaches = m_threadCache->m_nextIdle;
+		}
+	}
+	if (m_threadCache == nullptr)
+	{
+		// Caches are never deleted, as spans and other threads' frees may still refer to them
+		m_threadCache = new ThreadCache();
+	}
+	// Using the holder registers its destructor for when this thread exits
+	(void)&m_threadCacheHolder;
+	return m_threadCache;
+}
+
+int MemoryPool::GetSizeClass(size_t size)
+{
+	// Index by size in MIN_ALIGNMENT steps
+	static constexpr std::array<uint8_t, MAX_SMALL_SIZE / MIN_ALIGNMENT + 1> lookup = []()
+	{
+		std::array<uint8_t, MAX_SMALL_SIZE / MIN_ALIGNMENT + 1> table = {};
+		int sizeClass = 0;
+		for (size_t i = 0; i < table.size(); i++)
+		{
+			while (SIZE_CLASSES[sizeClass] < i * MIN_ALIGNMENT)
+			{
+				sizeClass++;
+			}
+			table[i] = (uint8_t)sizeClass;
+		}
+		return table;
+	}();
+	_ASSERT(size <= MAX_SMALL_SIZE);
+	return lookup[(size + MIN_ALIGNMENT - 1) / MIN_ALIGNMENT];
+}
+
+void* MemoryPool::AllocateSmall(ThreadCache& cache, int sizeClass)
+{
+	while (true)
+	{
+		Span* span = cache.m_spans[sizeClass];
+		if (span == nullptr)
+		{
+			ReclaimSpans(cache);
+			span = cache.m_spans[sizeClass];
+			if (span == nullptr)
+			{
+				span = AcquireSpan(cache, sizeClass);
+				if (span == nullptr)
+				{
+					return nullptr;
+				}
+				LinkSpan(cache, *span);
+			}
+		}
+
+		void* ptr = AllocateFromSpan(*span);
+		if (ptr != nullptr)
+		{
+			return ptr;
+		}
+
+		// Out of blocks, so stop allocating from this span until something is freed into it
+		UnlinkSpan(cache, *span);
+		// Release so that whichever thread clears the flag sees this thread's last use of the span
+		uintptr_t expected = 0;
+		if (!span->m_remoteFrees.compare_exchange_strong(expected, FULL_FLAG, std::memory_order_release, std::memory_order_relaxed))
+		{
+			// Another thread freed a block into it in the meantime
+			LinkSpan(cache, *span);
+		}
+	}
+}
+
+void* MemoryPool::AllocateLarge(size_t size)
+{
+	size_t allocatedSize = RoundUp(SPAN_HEADER_SIZE + size, PAGE_SIZE);
+	void* memory = PageAllocator::Allocate(allocatedSize, SPAN_SIZE, GetHugePageMode());
+	if (memory == nullptr)
+	{
+		return nullptr;
+	}
+	Span* span = new (memory) Span();
+	span->m_largeSize = allocatedSize;
+	m_reservedBytes.fetch_add(allocatedSize, std::memory_order_relaxed);
+	m_largeBytes.fetch_add(allocatedSize, std::memory_order_relaxed);
+	// The header is within SPAN_SIZE of the block, so GetSpan() finds it
+	return reinterpret_cast<char*>(span) + SPAN_HEADER_SIZE;
+}
+
+void MemoryPool::FreeLarge(Span* span)
+{
+	size_t allocatedSize = span->m_largeSize;
+	m_reservedBytes.fetch_sub(allocatedSize, std::memory_order_relaxed);
+	m_largeBytes.fetch_sub(allocatedSize, std::memory_order_relaxed);
+	span->~Span();
+	PageAllocator::Free(span, allocatedSize, GetHugePageMode());
+}
+
+void* MemoryPool::AllocateFromSpan(Span& span)
+{
+	if (span.m_localFrees == nullptr)
+	{
+		if (span.m_unusedStart < span.m_unusedEnd)
+		{
+			void* ptr = span.m_unusedStart;
+			span.m_unusedStart += span.m_blockSize;
+			span.m_numUsed++;
+			return ptr;
+		}
+		CollectRemoteFrees(span);
+		if (span.m_localFrees == nullptr)
+		{
+			return nullptr;
+		}
+	}
+	FreeBlock* block = span.m_localFrees;
+	span.m_localFrees = block->m_next;
+	span.m_numUsed++;
+	return block;
+}
+
+void MemoryPool::CollectRemoteFrees(Span& span)
+{
+	// Spans in a list never have FULL_FLAG set, so this only takes blocks
+	FreeBlock* blocks = reinterpret_cast<FreeBlock*>(span.m_remoteFrees.exchange(0, std::memory_order_acquire));
+	_ASSERT((reinterpret_cast<uintptr_t>(blocks) & FULL_FLAG) == 0);
+	for (FreeBlock* block = blocks; block != nullptr; )
+	{
+		FreeBlock* next = block->m_next;
+		block->m_next = span.m_localFrees;
+		span.m_localFrees = block;
+		_ASSERT(span.m_numUsed > 0);
+		span.m_numUsed--;
+		block = next;
+	}
+}
+
+void MemoryPool::FreeRemote(Span& span, FreeBlock* block)
+{
+	uintptr_t head = span.m_remoteFrees.load(std::memory_order_relaxed);
+	do
+	{
+		block->m_next = reinterpret_cast<FreeBlock*>(head & ~FULL_FLAG);
+	} while (!span.m_remoteFrees.compare_exchange_weak(head, reinterpret_cast<uintptr_t>(block), std::memory_order_acq_rel, std::memory_order_relaxed));
+
+	if ((head & FULL_FLAG) != 0)
+	{
+		// This cleared the flag, so hand the span back to its owner. The owner can't release it until it has been reclaimed.
+		PushReclaim(span);
+	}
+}
+
+void MemoryPool::ReclaimSpans(ThreadCache& cache)
+{
+	Span* span = cache.m_reclaimStack.exchange(nullptr, std::memory_order_acquire);
+	while (span != nullptr)
+	{
+		Span* next = span->m_nextReclaim;
+		LinkSpan(cache, *span);
+		span = next;
+	}
+}
+
+void MemoryPool::ReleaseEmptySpans(ThreadCache& cache)
+{
+	ReclaimSpans(cache);
+	for (Span* list : cache.m_spans)
+	{
+		for (Span* span = list; span != nullptr; )
+		{
+			Span* next = span->m_next;
+			CollectRemoteFrees(*span);
+			if (span->m_numUsed == 0)
+			{
+				UnlinkSpan(cache, *span);
+				ReleaseSpan(*span);
+			}
+			span = next;
+		}
+	}
+}
+
+void MemoryPool::PushReclaim(Span& span)
+{
+	ThreadCache& owner = *span.m_owner;
+	Span* head = owner.m_reclaimStack.load(std::memory_order_relaxed);
+	do
+	{
+		span.m_nextReclaim = head;
+	} while (!owner.m_reclaimStack.compare_exchange_weak(head, &span, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void MemoryPool::LinkSpan(ThreadCache& cache, Span& span)
+{
+	_ASSERT(!span.m_inList);
+	Span*& head = cache.m_spans[span.m_sizeClass];
+	span.m_prev = nullptr;
+	span.m_next = head;
+	if (head != nullptr)
+	{
+		head->m_prev = &span;
+	}
+	head = &span;
+	span.m_inList = true;
+}
+
+void MemoryPool::UnlinkSpan(ThreadCache& cache, Span& span)
+{
+	_ASSERT(span.m_inList);
+	if (span.m_prev != nullptr)
+	{
+		span.m_prev->m_next = span.m_next;
+	}
+	else
+	{
+		cache.m_spans[span.m_sizeClass] = span.m_next;
+	}
+	if (span.m_next != nullptr)
+	{
+		span.m_next->m_prev = span.m_prev;
+	}
+	span.m_prev = nullptr;
+	span.m_next = nullptr;
+	span.m_inList = false;
+}
+
+MemoryPool::Span* MemoryPool::AcquireSpan(ThreadCache& cache, int sizeClass)
+{
+	void* memory = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(m_globalMutex);
+		if (m_freeSpans == nullptr)
+		{
+			// Spans are never returned to the OS, only to m_freeSpans
+			const size_t chunkSize = SPANS_PER_CHUNK * SPAN_SIZE;
+			char* chunk = static_cast<char*>(PageAllocator::Allocate(chunkSize, SPAN_SIZE, GetHugePageMode()));
+			if (chunk == nullptr)
+			{
+				return nullptr;
+			}
+			m_reservedBytes.fetch_add(chunkSize, std::memory_order_relaxed);
+			for (size_t i = SPANS_PER_CHUNK; i-- > 0; )
+			{
+				Span* span = reinterpret_cast<Span*>(chunk + i * SPAN_SIZE);
+				span->m_next = m_freeSpans;
+				m_freeSpans = span;
+			}
+			m_numFreeSpans += SPANS_PER_CHUNK;
+		}
+		memory = m_freeSpans;
+		m_freeSpans = m_freeSpans->m_next;
+		m_numFreeSpans--;
+	}
+	m_numSpansInUse.fetch_add(1, std::memory_order_relaxed);
+
+	Span* span = new (memory) Span();
+	span->m_owner = &cache;
+	span->m_sizeClass = (uint8_t)sizeClass;
+	span->m_blockSize = SIZE_CLASSES[sizeClass];
+	span->m_unusedStart = reinterpret_cast<char*>(span) + SPAN_HEADER_SIZE;
+	size_t numBlocks = (SPAN_SIZE - SPAN_HEADER_SIZE) / span->m_blockSize;
+	span->m_unusedEnd = span->m_unusedStart + numBlocks * span->m_blockSize;
+	return span;
+}
+
+void MemoryPool::ReleaseSpan(Span& span)
+{
+	_ASSERT(span.m_numUsed == 0 && !span.m_inList);
+	m_numSpansInUse.fetch_sub(1, std::memory_order_relaxed);
+	std::lock_guard<std::mutex> lock(m_globalMutex);
+	span.m_next = m_freeSpans;
+	m_freeSpans = &span;
+	m_numFreeSpans++;
+}
@@ -0,0 +1,174 @@
+#pragma once
+#include "PageAllocator.h"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+/** Memory held by the MemoryPool */
+struct MemoryPoolStats
+{
+	/** Bytes allocated from the OS, including free spans */
+	size_t m_reservedBytes = 0;
+	/** Number of spans holding small allocations */
+	size_t m_numSpansInUse = 0;
+	/** Number of spans waiting to be reused */
+	size_t m_numFreeSpans = 0;
+	/** Bytes in large allocations */
+	size_t m_largeBytes = 0;
+};
+
+/**
+ * MemoryPool
+ * A general-purpose allocator with a cache per thread, so threads allocating at the same time don't contend on a lock.
+ *
+ * Small allocations are rounded up to one of a set of size classes. Each thread owns spans of SPAN_SIZE bytes per size class,
+ * and allocates from them without locking. Freeing a block on the thread that owns its span is also lock-free and local; freeing
+ * it on another thread pushes it onto the span's atomic remote free list, which the owner collects when the span runs out.
+ * Large allocations get their own pages from the OS, which is much slower, so they should be rare.
+ *
+ * Every block can find its span header by rounding its address down to SPAN_SIZE, so Free() doesn't need to know the size.
+ * When a thread exits, its cache (and the spans in it) is kept for the next thread that starts.
+ */
+class MemoryPool
+{
+public:
+	/** Size and alignment of a span. Also the alignment of large allocations, minus their header. */
+	static constexpr size_t SPAN_SIZE = 64 * 1024;
+	/** Largest allocation served from spans. Anything bigger gets its own pages. */
+	static constexpr size_t MAX_SMALL_SIZE = 8192;
+	/** Alignment of every allocation */
+	static constexpr size_t MIN_ALIGNMENT = 16;
+
+	/** Allocates size bytes, aligned to MIN_ALIGNMENT. May be called from any thread. */
+	static void* Allocate(size_t size);
+	/** Frees memory from Allocate(). May be called from any thread. */
+	static void Free(void* ptr);
+
+	/** Sets whether new spans and large allocations should try to use huge pages. Call before allocating. */
+	static void SetUseHugePages(bool useHugePages) { m_useHugePages = useHugePages; }
+	/** Returns how much memory the pool holds */
+	static MemoryPoolStats GetStats();
+
+private:
+	/** A free block, linked through its first bytes */
+	struct FreeBlock
+	{
+		FreeBlock* m_next;
+	};
+
+	struct ThreadCache;
+
+	/** Header at the start of every span and large allocation */
+	struct alignas(64) Span
+	{
+		/**
+		 * Blocks freed by other threads, as a FreeBlock* that any thread may push to and only the owner takes from.
+		 * Bit 0 is FULL_FLAG, set by the owner when the span runs out of blocks and is taken out of its list.
+		 * Whichever thread clears it is responsible for putting the span back.
+		 */
+		std::atomic<uintptr_t> m_remoteFrees = 0;
+		/** Cache that allocates from this span */
+		ThreadCache* m_owner = nullptr;
+		/** Next span in the owner's reclaim stack */
+		Span* m_nextReclaim = nullptr;
+
+		// Owner-only from here
+		/** Blocks freed by the owner */
+		FreeBlock* m_localFrees = nullptr;
+		/** Blocks that have never been allocated start here */
+		char* m_unusedStart = nullptr;
+		char* m_unusedEnd = nullptr;
+		/** Neighbours in the owner's list for this size class. m_next also links the global free spans. */
+		Span* m_prev = nullptr;
+		Span* m_next = nullptr;
+		/** Whether this span is in the owner's list for its size class */
+		bool m_inList = false;
+		uint8_t m_sizeClass = 0;
+		uint32_t m_blockSize = 0;
+		uint32_t m_numUsed = 0;
+		/** For large allocations, the number of bytes allocated from the OS. 0 for spans. */
+		size_t m_largeSize = 0;
+	};
+	static constexpr size_t SPAN_HEADER_SIZE = (sizeof(Span) + MIN_ALIGNMENT - 1) & ~(MIN_ALIGNMENT - 1);
+	static constexpr uintptr_t FULL_FLAG = 1;
+	/** Spans are allocated from the OS this many at a time */
+	static constexpr size_t SPANS_PER_CHUNK = 32;
+
+	/** Above 128 bytes, each size is at most 25% bigger than the last, to limit the memory wasted by rounding up */
+	static constexpr int NUM_SIZE_CLASSES = 32;
+	static constexpr std::array<uint32_t, NUM_SIZE_CLASSES> SIZE_CLASSES = {
+		16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 448, 512,
+		640, 768, 896, 1024, 1280, 1536, 1792, 2048, 2560, 3072, 3584, 4096, 5120, 6144, 7168, 8192 };
+
+	/** Per-thread spans for each size class */
+	struct ThreadCache
+	{
+		/** First span in each size class's list. This is the span allocations come from. */
+		std::array<Span*, NUM_SIZE_CLASSES> m_spans = {};
+		/** Full spans that other threads have freed blocks into, waiting to be put back in their lists */
+		std::atomic<Span*> m_reclaimStack = nullptr;
+		/** Next cache in m_idleCaches */
+		ThreadCache* m_nextIdle = nullptr;
+	};
+
+	/** Keeps this thread's cache for another thread when this one exits, minus its empty spans */
+	struct ThreadCacheHolder
+	{
+		~ThreadCacheHolder();
+	};
+
+	/** Returns this thread's cache, or nullptr if this thread is exiting */
+	static ThreadCache* GetThreadCache();
+	/** Returns the size class index for a small allocation */
+	static int GetSizeClass(size_t size);
+	/** Returns how to ask PageAllocator for memory */
+	static HugePageMode GetHugePageMode() { return m_useHugePages ? HugePageMode::PREFERRED : HugePageMode::NONE; }
+	/** Returns the span a block was allocated from */
+	static Span* GetSpan(void* ptr) { return reinterpret_cast<Span*>(reinterpret_cast<uintptr_t>(ptr) & ~(uintptr_t)(SPAN_SIZE - 1)); }
+
+	static void* AllocateSmall(ThreadCache& cache, int sizeClass);
+	static void* AllocateLarge(size_t size);
+	static void FreeLarge(Span* span);
+
+	/** Takes a block from the span, collecting its remote frees if needed. Returns nullptr if the span is full. Owner only. */
+	static void* AllocateFromSpan(Span& span);
+	/** Moves the span's remote frees to its local free list. Owner only. */
+	static void CollectRemoteFrees(Span& span);
+	/** Frees a block into a span owned by another thread's cache */
+	static void FreeRemote(Span& span, FreeBlock* block);
+	/** Puts spans that other threads freed into back in their lists */
+	static void ReclaimSpans(ThreadCache& cache);
+	/** Collects every span's remote frees, and returns spans with nothing allocated to the global pool */
+	static void ReleaseEmptySpans(ThreadCache& cache);
+	/** Pushes a full span onto its owner's reclaim stack */
+	static void PushReclaim(Span& span);
+
+	static void LinkSpan(ThreadCache& cache, Span& span);
+	static void UnlinkSpan(ThreadCache& cache, Span& span);
+
+	/** Takes a free span from the global pool (allocating more from the OS if needed) and sets it up for a size class */
+	static Span* AcquireSpan(ThreadCache& cache, int sizeClass);
+	/** Returns an empty span to the global pool */
+	static void ReleaseSpan(Span& span);
+
+private:
+	static thread_local ThreadCache* m_threadCache;
+	static thread_local bool m_threadExited;
+	static thread_local ThreadCacheHolder m_threadCacheHolder;
+
+	// Global state is kept in intrusive lists, so the pool still works while statics are being destroyed
+	/** Caches of threads that have exited, for reuse */
+	static ThreadCache* m_idleCaches;
+	/** Spans that no cache is using, linked through m_next */
+	static Span* m_freeSpans;
+	static size_t m_numFreeSpans;
+	/** Locks m_idleCaches, m_freeSpans, and allocating from the OS */
+	static std::mutex m_globalMutex;
+
+	static bool m_useHugePages;
+	static std::atomic<size_t> m_reservedBytes;
+	static std::atomic<size_t> m_numSpansInUse;
+	static std::atomic<size_t> m_largeBytes;
+};
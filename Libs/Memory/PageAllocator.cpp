@@ -0,0 +1,182 @@
+#include "pch.h"
+#include "PageAllocator.h"
+#include <cstdint>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	size_t RoundUp(size_t size, size_t alignment)
+	{
+		return (size + alignment - 1) & ~(alignment - 1);
+	}
+
+	/** Returns whether an allocation should try huge pages. They're only worth it for allocations that fill at least one. */
+	bool WantsHugePages(size_t size, HugePageMode hugePages)
+	{
+		size_t hugePageSize = PageAllocator::GetHugePageSize();
+		return hugePages != HugePageMode::NONE && hugePageSize > 0 && size >= hugePageSize;
+	}
+}
+
+#ifdef _WIN32
+
+void* PageAllocator::Allocate(size_t size, size_t alignment, HugePageMode hugePages)
+{
+	if (WantsHugePages(size, hugePages))
+	{
+		// Large pages are always aligned to the large page size. Windows has no reserved pool, so RESERVED is the same as PREFERRED.
+		size_t hugePageSize = GetHugePageSize();
+		if (alignment <= hugePageSize)
+		{
+			void* ptr = VirtualAlloc(nullptr, RoundUp(size, hugePageSize), MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+			if (ptr != nullptr)
+			{
+				return ptr;
+			}
+		}
+	}
+
+	// VirtualAlloc aligns to the allocation granularity (64KB). For more than that, reserve enough to find an aligned address,
+	// release it, and allocate there. Another thread may take the address in between, so retry if it does.
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	if (alignment <= info.dwAllocationGranularity)
+	{
+		return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	}
+	for (int attempt = 0; attempt < 16; attempt++)
+	{
+		void* reserved = VirtualAlloc(nullptr, size + alignment, MEM_RESERVE, PAGE_NOACCESS);
+		if (reserved == nullptr)
+		{
+			return nullptr;
+		}
+		void* aligned = reinterpret_cast<void*>(RoundUp(reinterpret_cast<uintptr_t>(reserved), alignment));
+		VirtualFree(reserved, 0, MEM_RELEASE);
+		void* ptr = VirtualAlloc(aligned, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+		if (ptr != nullptr)
+		{
+			return ptr;
+		}
+	}
+	return nullptr;
+}
+
+void PageAllocator::Free(void* ptr, size_t size, HugePageMode hugePages)
+{
+	VirtualFree(ptr, 0, MEM_RELEASE);
+}
+
+size_t PageAllocator::GetHugePageSize()
+{
+	return GetLargePageMinimum();
+}
+
+#else
+
+namespace
+{
+	size_t GetPageSize()
+	{
+		static const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+		return pageSize;
+	}
+
+	/**
+	 * Maps size bytes aligned to alignment, by mapping enough to find an aligned address and unmapping the ends.
+	 * size and alignment must be whole pages, as munmap only takes page-aligned ranges.
+	 */
+	void* MapAligned(size_t size, size_t alignment)
+	{
+		_ASSERT(size % GetPageSize() == 0 && alignment % GetPageSize() == 0);
+		if (alignment == GetPageSize())
+		{
+			// mmap is always page aligned
+			void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			return ptr != MAP_FAILED ? ptr : nullptr;
+		}
+		size_t mappedSize = size + alignment;
+		void* mapped = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (mapped == MAP_FAILED)
+		{
+			return nullptr;
+		}
+		uintptr_t start = reinterpret_cast<uintptr_t>(mapped);
+		uintptr_t aligned = RoundUp(start, alignment);
+		if (aligned > start)
+		{
+			int result = munmap(mapped, aligned - start);
+			_ASSERT(result == 0);
+		}
+		size_t tail = (start + mappedSize) - (aligned + size);
+		if (tail > 0)
+		{
+			int result = munmap(reinterpret_cast<void*>(aligned + size), tail);
+			_ASSERT(result == 0);
+		}
+		return reinterpret_cast<void*>(aligned);
+	}
+}
+
+void* PageAllocator::Allocate(size_t size, size_t alignment, HugePageMode hugePages)
+{
+	// mmap works in whole pages, so round up here so the ends MapAligned() unmaps are too
+	size = RoundUp(size, GetPageSize());
+	alignment = alignment > GetPageSize() ? alignment : GetPageSize();
+	if (!WantsHugePages(size, hugePages))
+	{
+		return MapAligned(size, alignment);
+	}
+
+	size_t hugePageSize = GetHugePageSize();
+	if (hugePages == HugePageMode::RESERVED)
+	{
+		size = RoundUp(size, hugePageSize);
+#ifdef MAP_HUGETLB
+		// Reserved huge pages are always aligned to the huge page size
+		if (alignment <= hugePageSize)
+		{
+			void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+			if (ptr != MAP_FAILED)
+			{
+				return ptr;
+			}
+		}
+#endif
+	}
+
+	// Transparent huge pages can only back huge-page-aligned ranges
+	void* ptr = MapAligned(size, alignment > hugePageSize ? alignment : hugePageSize);
+#ifdef MADV_HUGEPAGE
+	if (ptr != nullptr)
+	{
+		// A hint, so failure just means regular pages
+		madvise(ptr, size, MADV_HUGEPAGE);
+	}
+#endif
+	return ptr;
+}
+
+void PageAllocator::Free(void* ptr, size_t size, HugePageMode hugePages)
+{
+	// Allocate() rounded it up
+	size = RoundUp(size, GetPageSize());
+	if (hugePages == HugePageMode::RESERVED && WantsHugePages(size, hugePages))
+	{
+		size = RoundUp(size, GetHugePageSize());
+	}
+	int result = munmap(ptr, size);
+	_ASSERT(result == 0);
+}
+
+size_t PageAllocator::GetHugePageSize()
+{
+	return 2 * 1024 * 1024;
+}
+
+#endif
\ No newline at end of file
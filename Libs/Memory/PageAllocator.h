@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/** How PageAllocator should try to back memory with huge pages */
+enum class HugePageMode : uint8_t
+{
+	/** Regular pages only */
+	NONE,
+	/**
+	 * Huge pages if the OS will give them without any set-up, otherwise regular pages. On Linux this asks for transparent huge
+	 * pages (MADV_HUGEPAGE); on Windows it tries large pages, which need the "Lock pages in memory" privilege.
+	 */
+	PREFERRED,
+	/**
+	 * Huge pages from the pool the administrator reserved (MAP_HUGETLB on Linux), falling back to PREFERRED if there are none left.
+	 * The allocation is rounded up to a whole number of huge pages.
+	 */
+	RESERVED,
+};
+
+/**
+ * PageAllocator
+ * Allocates memory straight from the OS, in whole pages, for allocators to carve up.
+ *
+ * Pages are only given physical memory when first written, and on a NUMA machine the OS puts each page on the node of the thread
+ * that first writes it. So memory that is mostly used by one thread should be first written (e.g. constructed) on that thread.
+ * The exception is Windows large pages, which are committed up-front on the allocating thread's node.
+ */
+class PageAllocator
+{
+public:
+	/**
+	 * Allocates at least size bytes, aligned to alignment (a power of two). Returns nullptr if the OS is out of memory.
+	 * Huge pages use fewer TLB entries, so passes over big arrays take fewer TLB misses. They're only used for allocations of
+	 * at least one huge page, which are then aligned to the huge page size.
+	 */
+	static void* Allocate(size_t size, size_t alignment, HugePageMode hugePages);
+	/** Returns memory from Allocate() to the OS. size and hugePages must be the same as it was allocated with. */
+	static void Free(void* ptr, size_t size, HugePageMode hugePages = HugePageMode::NONE);
+
+	/** Returns the OS's huge page size, or 0 if it doesn't have them */
+	static size_t GetHugePageSize();
+};
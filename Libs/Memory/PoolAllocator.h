@@ -0,0 +1,58 @@
+#pragma once
+#include "MemoryPool.h"
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+/**
+ * STL allocator that allocates from the MemoryPool.
+ * All PoolAllocators are interchangeable, so memory allocated on one thread can be freed on any other.
+ */
+template<typename T>
+struct PoolAllocator
+{
+	static_assert(alignof(T) <= MemoryPool::MIN_ALIGNMENT, "MemoryPool doesn't support this alignment");
+
+	using value_type = T;
+	using is_always_equal = std::true_type;
+
+	PoolAllocator() = default;
+	template<typename U>
+	PoolAllocator(const PoolAllocator<U>&) { }
+
+	T* allocate(size_t count)
+	{
+		void* ptr = MemoryPool::Allocate(count * sizeof(T));
+		if (ptr == nullptr)
+		{
+			// Containers expect allocators to throw rather than return nullptr
+			throw std::bad_alloc();
+		}
+		return static_cast<T*>(ptr);
+	}
+
+	void deallocate(T* ptr, size_t)
+	{
+		MemoryPool::Free(ptr);
+	}
+
+	template<typename U>
+	bool operator==(const PoolAllocator<U>&) const { return true; }
+	template<typename U>
+	bool operator!=(const PoolAllocator<U>&) const { return false; }
+};
+
+/** Like std::make_shared, but allocates the object and its reference count from the MemoryPool */
+template<typename T, typename... Args>
+std::shared_ptr<T> MakePoolShared(Args&&... args)
+{
+	return std::allocate_shared<T>(PoolAllocator<T>(), std::forward<Args>(args)...);
+}
+
+/** A string whose memory comes from the MemoryPool */
+using PoolString = std::basic_string<char, std::char_traits<char>, PoolAllocator<char>>;
+
+/** A vector whose memory comes from the MemoryPool */
+template<typename T>
+using PoolVector = std::vector<T, PoolAllocator<T>>;
@@ -0,0 +1,46 @@
+#include "pch.h"
+#include "ScratchStack.h"
+#include "PageAllocator.h"
+#include <algorithm>
+
+thread_local ScratchStack ScratchStack::m_threadStack;
+
+namespace
+{
+	constexpr size_t PAGE_SIZE = 4096;
+}
+
+ScratchStack::~ScratchStack()
+{
+	Block* block = m_firstBlock;
+	while (block != nullptr)
+	{
+		Block* next = block->m_next;
+		PageAllocator::Free(block, block->m_size);
+		block = next;
+	}
+}
+
+bool ScratchStack::NextBlock(size_t size, size_t alignment)
+{
+	// Blocks above the top of the stack are free, so reuse the next one if it's big enough
+	Block*& next = m_block != nullptr ? m_block->m_next : m_firstBlock;
+	size_t neededSize = BLOCK_HEADER_SIZE + size + alignment;
+	if (next == nullptr || next->m_size < neededSize)
+	{
+		// Insert a new block here, keeping any smaller one above it
+		size_t blockSize = std::max(BLOCK_SIZE, (neededSize + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1));
+		Block* block = static_cast<Block*>(PageAllocator::Allocate(blockSize, PAGE_SIZE, HugePageMode::NONE));
+		if (block == nullptr)
+		{
+			return false;
+		}
+		block->m_next = next;
+		block->m_size = blockSize;
+		next = block;
+		m_reservedBytes += blockSize;
+	}
+	m_block = next;
+	m_offset = BLOCK_HEADER_SIZE;
+	return true;
+}
@@ -0,0 +1,153 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+/**
+ * ScratchStack
+ * A per-thread stack of temporary memory. Allocating bumps a pointer, and everything allocated since a marker is freed at once
+ * by releasing the marker, so temporaries never touch the heap.
+ *
+ * The job system releases everything a job allocated from its thread's stack when the job function returns, so scratch memory
+ * must not be kept past the end of the job, or passed to other threads. Use a ScratchScope to free memory sooner.
+ * Memory comes from blocks of BLOCK_SIZE bytes (or bigger, for big allocations) that are kept until the thread exits.
+ */
+class ScratchStack
+{
+	/** Header at the start of each block */
+	struct Block
+	{
+		/** Next block up the stack */
+		Block* m_next;
+		/** Size of the block, including this header */
+		size_t m_size;
+	};
+	static constexpr size_t BLOCK_HEADER_SIZE = 16;
+
+public:
+	/** Size of each block of scratch memory */
+	static constexpr size_t BLOCK_SIZE = 4 * 1024 * 1024;
+
+	/** Position in the stack to release back to */
+	struct Marker
+	{
+		Block* m_block = nullptr;
+		size_t m_offset = 0;
+	};
+
+	ScratchStack() = default;
+	ScratchStack(const ScratchStack&) = delete;
+	ScratchStack& operator=(const ScratchStack&) = delete;
+	~ScratchStack();
+
+	/** Returns this thread's stack */
+	static ScratchStack& Get() { return m_threadStack; }
+
+	/** Allocates size bytes aligned to alignment (a power of two). Returns nullptr if out of memory. */
+	void* Allocate(size_t size, size_t alignment)
+	{
+		if (m_block != nullptr)
+		{
+			const uintptr_t base = reinterpret_cast<uintptr_t>(m_block);
+			size_t alignedOffset = ((base + m_offset + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+			if (alignedOffset + size <= m_block->m_size)
+			{
+				m_offset = alignedOffset + size;
+				return reinterpret_cast<char*>(m_block) + alignedOffset;
+			}
+		}
+		if (!NextBlock(size, alignment))
+		{
+			return nullptr;
+		}
+		return Allocate(size, alignment);
+	}
+
+	/** Allocates memory for count objects of type T, without constructing them */
+	template<typename T>
+	T* Allocate(size_t count)
+	{
+		return static_cast<T*>(Allocate(count * sizeof(T), alignof(T)));
+	}
+
+	/** Returns the current top of the stack */
+	Marker GetMarker() const { return { m_block, m_offset }; }
+	/** Frees everything allocated since the marker was taken. Markers must be released in reverse order. */
+	void Release(const Marker& marker)
+	{
+		m_block = marker.m_block;
+		m_offset = marker.m_offset;
+	}
+
+	/** Returns the number of bytes of blocks this stack holds */
+	size_t GetReservedBytes() const { return m_reservedBytes; }
+
+private:
+	/** Moves up to a block that can fit size bytes at the given alignment, allocating one if needed */
+	bool NextBlock(size_t size, size_t alignment);
+
+private:
+	static thread_local ScratchStack m_threadStack;
+
+	/** Block being allocated from, or nullptr if nothing is allocated */
+	Block* m_block = nullptr;
+	/** Offset of the first free byte in m_block */
+	size_t m_offset = 0;
+	/** First block, so the stack can start again from the bottom */
+	Block* m_firstBlock = nullptr;
+	size_t m_reservedBytes = 0;
+};
+
+/** Frees everything allocated from this thread's ScratchStack during its lifetime */
+class ScratchScope
+{
+public:
+	ScratchScope()
+		: m_marker(ScratchStack::Get().GetMarker())
+	{ }
+	~ScratchScope()
+	{
+		ScratchStack::Get().Release(m_marker);
+	}
+	ScratchScope(const ScratchScope&) = delete;
+	ScratchScope& operator=(const ScratchScope&) = delete;
+
+private:
+	ScratchStack::Marker m_marker;
+};
+
+/**
+ * STL allocator that allocates from this thread's ScratchStack.
+ * Deallocation does nothing, as memory is freed when the scope or job that allocated it ends. A container using this must be
+ * destroyed before then, and only used on the thread that created it.
+ */
+template<typename T>
+struct ScratchAllocator
+{
+	using value_type = T;
+
+	ScratchAllocator() : m_stack(&ScratchStack::Get()) { }
+	template<typename U>
+	ScratchAllocator(const ScratchAllocator<U>& other) : m_stack(other.m_stack) { }
+
+	T* allocate(size_t count)
+	{
+		T* ptr = m_stack->Allocate<T>(count);
+		_ASSERT(ptr != nullptr);
+		return ptr;
+	}
+
+	void deallocate(T*, size_t) { }
+
+	template<typename U>
+	bool operator==(const ScratchAllocator<U>& other) const { return m_stack == other.m_stack; }
+	template<typename U>
+	bool operator!=(const ScratchAllocator<U>& other) const { return m_stack != other.m_stack; }
+
+	ScratchStack* m_stack;
+};
+
+/** A vector of temporaries whose memory comes from this thread's ScratchStack */
+template<typename T>
+using ScratchVector = std::vector<T, ScratchAllocator<T>>;